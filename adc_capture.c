@@ -0,0 +1,208 @@
+/**
+* @file adc_capture.c
+*
+* dma-fed adc capture of sound level and die temperature
+*/
+
+#include <pico/stdlib.h>
+#include <hardware/adc.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adc_capture.h"
+#include "dsp.h"
+
+// the adc runs from the 48 MHz usb pll, one conversion takes 96 cycles
+#define ADC_CAPTURE_CLOCK_HZ 48000000u
+
+static adc_capture_t *adc_capture_owner;
+
+static void adc_capture_dma_irq_handler(void) {
+    adc_capture_t *c=adc_capture_owner;
+    BaseType_t woken=pdFALSE;
+
+    for(uint32_t i=0; i<2; ++i) {
+        if(!dma_channel_get_irq1_status(c->dma[i]))
+            continue;
+        dma_channel_acknowledge_irq1(c->dma[i]);
+        // the other channel is running now, re-arm this one for its turn
+        dma_channel_set_write_addr(c->dma[i], c->buf[i], false);
+        if(c->ready&(1u<<i))
+            ++c->overruns;
+        c->ready|=1u<<i;
+        vTaskNotifyGiveFromISR(c->task, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+static void adc_capture_process(adc_capture_t *c, const uint16_t *buf) {
+    uint32_t half=c->block/2;
+    uint32_t audio_sum=0, temp_sum=0;
+
+    // round robin order: audio on even samples, temperature on odd ones
+    for(uint32_t i=0; i<c->block; i+=2) {
+        audio_sum+=buf[i];
+        temp_sum+=buf[i+1];
+    }
+
+    // microphone bias: block means smoothed over ~8 blocks, a single block
+    // mean would move with every partial period of a low tone
+    int32_t mean_q8=(int32_t) ((((uint64_t) audio_sum<<8)+half/2)/half);
+    if(c->blocks==0)
+        c->audio_dc_q8=mean_q8;
+    else
+        c->audio_dc_q8+=(mean_q8-c->audio_dc_q8)/8;
+    int32_t dc=(c->audio_dc_q8+128)>>8;
+
+    uint64_t energy=0;
+    uint32_t peak=0;
+    for(uint32_t i=0; i<c->block; i+=2) {
+        int32_t d=(int32_t) buf[i]-dc;
+        uint32_t a=d<0?-d:d;
+        energy+=(uint32_t) (d*d);
+        if(a>peak)
+            peak=a;
+    }
+
+    taskENTER_CRITICAL();
+    c->audio_energy+=energy;
+    c->audio_samples+=half;
+    if(energy>c->audio_block_max)
+        c->audio_block_max=energy;
+    if(peak>c->audio_peak)
+        c->audio_peak=peak;
+    c->temp_sum+=temp_sum;
+    c->temp_samples+=half;
+    taskEXIT_CRITICAL();
+}
+
+static void adc_capture_task(void *arg) {
+    adc_capture_t *c=(adc_capture_t *) arg;
+
+    while(1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // buffers complete in turn, so process them in that order
+        while(c->ready&(1u<<c->next)) {
+            uint32_t start=time_us_32();
+            adc_capture_process(c, c->buf[c->next]);
+            uint32_t us=time_us_32()-start;
+            if(us>c->process_us_max)
+                c->process_us_max=us;
+
+            taskENTER_CRITICAL();
+            c->ready&=~(1u<<c->next);
+            taskEXIT_CRITICAL();
+            ++c->blocks;
+            c->next^=1;
+        }
+    }
+}
+
+bool adc_capture_init(adc_capture_t *c, uint audio_input, size_t block, uint32_t rate_hz, UBaseType_t priority) {
+    c->buf[0]=c->buf[1]=NULL;
+    c->dma[0]=c->dma[1]=-1;
+    c->task=NULL;
+    c->block=block;
+    c->rate_hz=rate_hz;
+    c->ready=0;
+    c->next=0;
+    c->blocks=c->overruns=0;
+    c->process_us_max=0;
+    c->audio_dc_q8=0;
+    c->audio_energy=0;
+    c->audio_samples=0;
+    c->audio_block_max=0;
+    c->audio_peak=0;
+    c->temp_sum=0;
+    c->temp_samples=0;
+
+    // an odd block would swap the inputs in every other buffer
+    if(adc_capture_owner!=NULL || audio_input>3 || block<2 || (block&1) || rate_hz==0
+        || rate_hz>ADC_CAPTURE_CLOCK_HZ/96)
+        return false;
+
+    for(uint32_t i=0; i<2; ++i)
+        if((c->buf[i]=malloc(block*sizeof(uint16_t)))==NULL)
+            goto failed;
+
+    c->dma[0]=dma_claim_unused_channel(false);
+    c->dma[1]=dma_claim_unused_channel(false);
+    if(c->dma[0]<0 || c->dma[1]<0)
+        goto failed;
+
+    if(xTaskCreate(adc_capture_task, "ADC", 256, c, priority, &c->task)!=pdPASS)
+        goto failed;
+
+    adc_gpio_init(26+audio_input);
+    adc_set_temp_sensor_enabled(true);
+    adc_run(false);
+    adc_fifo_drain();
+    adc_select_input(audio_input);
+    adc_set_round_robin((1u<<audio_input)|(1u<<ADC_CAPTURE_TEMP_INPUT));
+    // 12-bit samples, a dma request per sample, no error flag in bit 15
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv(ADC_CAPTURE_CLOCK_HZ/rate_hz-1);
+
+    for(uint32_t i=0; i<2; ++i) {
+        dma_channel_config cfg=dma_channel_get_default_config(c->dma[i]);
+        channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+        channel_config_set_read_increment(&cfg, false);
+        channel_config_set_write_increment(&cfg, true);
+        channel_config_set_dreq(&cfg, DREQ_ADC);
+        channel_config_set_chain_to(&cfg, c->dma[i^1]);
+        dma_channel_configure(c->dma[i], &cfg, c->buf[i], &adc_hw->fifo, block, false);
+        dma_channel_set_irq1_enabled(c->dma[i], true);
+    }
+
+    adc_capture_owner=c;
+    irq_add_shared_handler(DMA_IRQ_1, adc_capture_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    dma_channel_start(c->dma[0]);
+    adc_run(true);
+    return true;
+
+failed:
+    // nothing half set up stays behind, reads report no samples
+    for(uint32_t i=0; i<2; ++i) {
+        if(c->dma[i]>=0)
+            dma_channel_unclaim(c->dma[i]);
+        free(c->buf[i]);
+    }
+    memset(c, 0, sizeof(*c));
+    c->dma[0]=c->dma[1]=-1;
+    return false;
+}
+
+bool adc_capture_read(adc_capture_t *c, adc_capture_result_t *r) {
+    taskENTER_CRITICAL();
+    uint64_t energy=c->audio_energy, block_max=c->audio_block_max;
+    uint32_t n=c->audio_samples, peak=c->audio_peak;
+    uint64_t temp_sum=c->temp_sum;
+    uint32_t temp_n=c->temp_samples;
+    c->audio_energy=0;
+    c->audio_samples=0;
+    c->audio_block_max=0;
+    c->audio_peak=0;
+    c->temp_sum=0;
+    c->temp_samples=0;
+    taskEXIT_CRITICAL();
+
+    r->audio_samples=n;
+    r->temp_samples=temp_n;
+    // 20 kHz per input: ~40,000 samples per 2 s report, the Q8 sum needs the 64 bits
+    r->temp_q8=temp_n?(uint32_t) (((temp_sum<<8)+temp_n/2)/temp_n):0;
+    if(n==0) {
+        r->leq_cdb=r->lmax_cdb=r->peak_cdb=DSP_DB_FLOOR;
+        return false;
+    }
+
+    // mean square against a full-scale sine, dividing through the log
+    r->leq_cdb=dsp_db_centi(energy, (uint64_t) n*ADC_CAPTURE_FULL_SCALE_POWER);
+    r->lmax_cdb=dsp_db_centi(block_max, (uint64_t) (c->block/2)*ADC_CAPTURE_FULL_SCALE_POWER);
+    r->peak_cdb=dsp_db_centi((uint64_t) peak*peak, 2048u*2048u);
+    return true;
+}
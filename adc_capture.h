@@ -0,0 +1,93 @@
+/**
+* @file adc_capture.h
+*
+* free-running adc capture: round robin between an audio input and the die
+* temperature sensor, streamed by two chained dma channels into a pair of
+* buffers. The cpu only sees whole buffers, in a task that keeps the sound
+* energy and the temperature sum until the next adc_capture_read
+*/
+
+#ifndef _inc_adc_capture
+#define _inc_adc_capture
+
+#include <pico/stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+*	@brief adc input of the die temperature sensor
+*/
+#define ADC_CAPTURE_TEMP_INPUT 4
+
+/**
+*	@brief power of a full-scale sine on the 12-bit adc (amplitude 2048)
+*/
+#define ADC_CAPTURE_FULL_SCALE_POWER (2048u*2048u/2)
+
+/**
+*	@brief capture state and statistics
+*/
+typedef struct {
+    uint16_t *buf[2];	/**< ping-pong buffers, audio and temperature interleaved */
+    size_t block;		/**< samples per buffer (even) */
+    uint32_t rate_hz;	/**< conversions per second, both inputs together */
+    int dma[2];			/**< claimed dma channel per buffer */
+    TaskHandle_t task;	/**< processing task */
+    volatile uint32_t ready;	/**< bit per buffer filled and not yet processed */
+    uint32_t next;		/**< buffer to process next */
+    uint32_t blocks;	/**< buffers processed */
+    uint32_t overruns;	/**< buffers refilled before they were processed */
+    uint32_t process_us_max;	/**< worst time to process one buffer */
+    int32_t audio_dc_q8;	/**< microphone bias, adc counts in Q8 */
+    // since the last adc_capture_read
+    uint64_t audio_energy;		/**< sum of squares around the bias */
+    uint32_t audio_samples;
+    uint64_t audio_block_max;	/**< loudest block energy */
+    uint16_t audio_peak;		/**< largest excursion from the bias */
+    uint64_t temp_sum;		/**< sum of the temperature samples, ~40,000 per report */
+    uint32_t temp_samples;
+} adc_capture_t;
+
+/**
+*	@brief levels and temperature since the previous read
+*/
+typedef struct {
+    int32_t leq_cdb;	/**< equivalent level, 0.01 dBFS */
+    int32_t lmax_cdb;	/**< loudest block, 0.01 dBFS */
+    int32_t peak_cdb;	/**< peak sample, 0.01 dBFS */
+    uint32_t temp_q8;	/**< mean temperature sensor reading, adc counts in Q8 */
+    uint32_t audio_samples;
+    uint32_t temp_samples;
+} adc_capture_result_t;
+
+/**
+*	@brief start the capture
+*
+*	adc_init must have been called. Sets up the audio pin and the
+*	temperature sensor, claims two dma channels and shares DMA_IRQ_1. On
+*	failure nothing stays claimed and adc_capture_read reports no samples.
+*
+*	@param[in] c : capture state
+*	@param[in] audio_input : adc input (0..3) of the microphone
+*	@param[in] block : samples per buffer, even
+*	@param[in] rate_hz : total conversions per second, each input gets half
+*	@param[in] priority : FreeRTOS priority of the processing task
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool adc_capture_init(adc_capture_t *c, uint audio_input, size_t block, uint32_t rate_hz, UBaseType_t priority);
+
+/**
+*	@brief levels since the previous call, then start over
+*
+*	@param[in] c : capture state
+*	@param[out] r : result, levels at DSP_DB_FLOOR without audio samples
+*
+*	@return bool.
+*	@retval false if no buffer was processed since the previous call
+*/
+bool adc_capture_read(adc_capture_t *c, adc_capture_result_t *r);
+
+#endif
@@ -0,0 +1,101 @@
+/**
+* @file batch.c
+*
+* sample batching with count, size and age limits
+*/
+
+#include <string.h>
+
+#include "batch.h"
+
+void batch_init(batch_t *b, batch_format_t format, uint32_t max_count, size_t max_bytes, uint32_t max_age_ms) {
+    memset(b, 0, sizeof(*b));
+    b->format=format;
+    b->max_count=max_count?max_count:1;
+    b->max_bytes=max_bytes<BATCH_BUF_SIZE?max_bytes:BATCH_BUF_SIZE;
+    b->max_age_ms=max_age_ms;
+    batch_clear(b);
+}
+
+void *batch_reserve(batch_t *b, size_t *room) {
+    size_t at=b->len;
+    size_t tail=0;
+    if(b->format==BATCH_JSON) {
+        // separator before, closing bracket after
+        at+=b->count?1:0;
+        tail=1;
+    }
+    *room=at+tail<b->max_bytes?b->max_bytes-at-tail:0;
+    return b->buf+at;
+}
+
+bool batch_commit(batch_t *b, size_t len, uint32_t now_ms) {
+    size_t room;
+    batch_reserve(b, &room);
+    if(len>room || b->closed)
+        return false;
+    if(b->count==0)
+        b->first_ms=now_ms;
+    else if(b->format==BATCH_JSON)
+        b->buf[b->len++]=',';
+    b->len+=len;
+    b->buf[b->len]='\0';
+    ++b->count;
+    return true;
+}
+
+bool batch_fits(const batch_t *b, size_t len) {
+    size_t room;
+    batch_reserve((batch_t *) b, &room);
+    return len<=room;
+}
+
+bool batch_add(batch_t *b, const void *item, size_t len, uint32_t now_ms) {
+    size_t room;
+    void *at=batch_reserve(b, &room);
+    if(len>room)
+        return false;
+    memcpy(at, item, len);
+    return batch_commit(b, len, now_ms);
+}
+
+batch_reason_t batch_due(const batch_t *b, uint32_t now_ms) {
+    if(b->count==0)
+        return BATCH_WAIT;
+    if(b->count>=b->max_count)
+        return BATCH_COUNT;
+    if(now_ms-b->first_ms>=b->max_age_ms)
+        return BATCH_AGE;
+    return BATCH_WAIT;
+}
+
+uint32_t batch_wait_ms(const batch_t *b, uint32_t now_ms) {
+    if(b->count==0)
+        return UINT32_MAX;
+    uint32_t age=now_ms-b->first_ms;
+    return b->count>=b->max_count || age>=b->max_age_ms?0:b->max_age_ms-age;
+}
+
+const void *batch_close(batch_t *b, batch_reason_t why, size_t *len) {
+    if(!b->closed) {
+        if(b->format==BATCH_JSON) {
+            b->buf[b->len++]=']';
+            b->buf[b->len]='\0';
+        }
+        b->samples+=b->count;
+        b->bytes+=b->len;
+        ++b->flushes[why];
+        b->closed=true;
+    }
+    *len=b->len;
+    return b->buf;
+}
+
+void batch_clear(batch_t *b) {
+    b->len=0;
+    if(b->format==BATCH_JSON)
+        b->buf[b->len++]='[';
+    b->buf[b->len]='\0';
+    b->count=0;
+    b->closed=false;
+}
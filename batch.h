@@ -0,0 +1,140 @@
+/**
+* @file batch.h
+*
+* sample batching for upload: records are appended to a JSON array, or
+* back to back for binary frames, that is flushed as one request when it
+* holds enough samples, enough bytes, or its oldest sample has waited long
+* enough, whichever comes first
+*/
+
+#ifndef _inc_batch
+#define _inc_batch
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+*	@brief batch buffer, including the enclosing brackets
+*/
+#define BATCH_BUF_SIZE 4096
+
+/**
+*	@brief how samples are put together
+*/
+typedef enum {
+    BATCH_JSON,	/**< "[a,b,c]" */
+    BATCH_RAW	/**< samples back to back, self-delimiting */
+} batch_format_t;
+
+/**
+*	@brief why a batch is due
+*/
+typedef enum {
+    BATCH_WAIT,		/**< not due yet */
+    BATCH_COUNT,	/**< holds max_count samples */
+    BATCH_BYTES,	/**< the next sample would not fit in max_bytes */
+    BATCH_AGE,		/**< the oldest sample is max_age_ms old */
+    BATCH_REASONS
+} batch_reason_t;
+
+/**
+*	@brief batch state and statistics
+*/
+typedef struct {
+    batch_format_t format;
+    uint32_t max_count;		/**< samples per batch */
+    size_t max_bytes;		/**< body size, at most BATCH_BUF_SIZE */
+    uint32_t max_age_ms;	/**< longest wait of the oldest sample */
+    char buf[BATCH_BUF_SIZE+1];	/**< samples, NUL terminated */
+    size_t len;
+    uint32_t count;			/**< samples in buf */
+    uint32_t first_ms;		/**< when the oldest sample was added */
+    bool closed;			/**< batch_close ran, no more samples until batch_clear */
+    uint32_t samples;		/**< samples flushed */
+    uint32_t bytes;			/**< body bytes flushed */
+    uint32_t flushes[BATCH_REASONS];	/**< flushes per reason */
+} batch_t;
+
+/**
+*	@brief set up an empty batch
+*
+*	@param[in] b : batch
+*	@param[in] format : JSON array or raw
+*	@param[in] max_count : samples per batch, at least 1
+*	@param[in] max_bytes : body size, clamped to BATCH_BUF_SIZE
+*	@param[in] max_age_ms : longest wait of the oldest sample
+*/
+void batch_init(batch_t *b, batch_format_t format, uint32_t max_count, size_t max_bytes, uint32_t max_age_ms);
+
+/**
+*	@brief where the next sample goes, for encoding it in place
+*
+*	@param[in] b : batch
+*	@param[out] room : bytes that may be written there
+*
+*	@return position in the batch buffer
+*/
+void *batch_reserve(batch_t *b, size_t *room);
+
+/**
+*	@brief take len bytes written at batch_reserve as the next sample
+*
+*	@return bool.
+*	@retval false if len exceeds the room or the batch is closed
+*/
+bool batch_commit(batch_t *b, size_t len, uint32_t now_ms);
+
+/**
+*	@brief append one sample, copied
+*
+*	@param[in] b : batch
+*	@param[in] item : JSON value or frame
+*	@param[in] len : length of item
+*	@param[in] now_ms : current time
+*
+*	@return bool.
+*	@retval false if it does not fit, the batch must be flushed first; an
+*	item that does not fit an empty batch never will
+*/
+bool batch_add(batch_t *b, const void *item, size_t len, uint32_t now_ms);
+
+/**
+*	@brief check whether an item of len bytes would fit
+*/
+bool batch_fits(const batch_t *b, size_t len);
+
+/**
+*	@brief check whether the batch should be flushed now
+*
+*	@return BATCH_COUNT or BATCH_AGE when due, else BATCH_WAIT
+*/
+batch_reason_t batch_due(const batch_t *b, uint32_t now_ms);
+
+/**
+*	@brief time left until the batch is due by age
+*
+*	@return ms, 0 if due, UINT32_MAX if the batch is empty
+*/
+uint32_t batch_wait_ms(const batch_t *b, uint32_t now_ms);
+
+/**
+*	@brief finish the body for sending and count the flush
+*
+*	The body stays valid until batch_clear; closing again returns the same
+*	body without counting another flush.
+*
+*	@param[in] b : batch, not empty
+*	@param[in] why : reason counted in flushes
+*	@param[out] len : body length
+*
+*	@return body
+*/
+const void *batch_close(batch_t *b, batch_reason_t why, size_t *len);
+
+/**
+*	@brief drop the contents, after the body was sent
+*/
+void batch_clear(batch_t *b);
+
+#endif
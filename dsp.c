@@ -0,0 +1,165 @@
+/**
+* @file dsp.c
+*
+* fixed-point signal processing
+*/
+
+#include <string.h>
+
+#include "dsp.h"
+
+bool dsp_fir_init(dsp_fir_t *f, const int16_t *taps, uint32_t ntaps, uint32_t decim) {
+    if(ntaps<1 || ntaps>DSP_FIR_MAX_TAPS || decim<1)
+        return false;
+
+    uint32_t gain=0;
+    for(uint32_t i=0; i<ntaps; ++i)
+        gain+=taps[i]<0?-taps[i]:taps[i];
+    if(gain>=65536)
+        return false;
+
+    f->taps=taps;
+    f->ntaps=ntaps;
+    f->decim=decim;
+    dsp_fir_reset(f);
+    return true;
+}
+
+void dsp_fir_reset(dsp_fir_t *f) {
+    f->phase=0;
+    f->pos=0;
+    memset(f->hist, 0, sizeof(f->hist));
+}
+
+inline static int16_t dsp_sat16(int32_t x) {
+    if(x>INT16_MAX)
+        return INT16_MAX;
+    if(x<INT16_MIN)
+        return INT16_MIN;
+    return (int16_t) x;
+}
+
+size_t dsp_fir_decimate(dsp_fir_t *f, const int16_t *in, size_t n, size_t stride, int16_t *out) {
+    const uint32_t ntaps=f->ntaps;
+    size_t produced=0;
+
+    for(size_t i=0; i<n; ++i, in+=stride) {
+        f->hist[f->pos]=f->hist[f->pos+ntaps]=*in;
+        if(++f->pos==ntaps)
+            f->pos=0;
+        if(++f->phase<f->decim)
+            continue;
+        f->phase=0;
+
+        // hist[pos..pos+ntaps-1] runs oldest to newest, taps[0] weighs the newest
+        const int16_t *x=&f->hist[f->pos+ntaps-1];
+        const int16_t *h=f->taps;
+        int32_t acc=1<<14;
+        for(uint32_t k=0; k<ntaps; ++k)
+            acc+=(int32_t) h[k]*x[-(int32_t) k];
+        out[produced++]=dsp_sat16(acc>>15);
+    }
+    return produced;
+}
+
+void dsp_window_reset(dsp_window_t *w) {
+    w->sum=0;
+    w->sumsq=0;
+    w->min=INT16_MAX;
+    w->max=INT16_MIN;
+    w->n=0;
+}
+
+void dsp_window_add(dsp_window_t *w, const int16_t *x, size_t n) {
+    for(size_t i=0; i<n; ++i) {
+        int32_t v=x[i];
+        w->sum+=v;
+        w->sumsq+=(uint32_t) (v*v);
+        if(v<w->min)
+            w->min=v;
+        if(v>w->max)
+            w->max=v;
+    }
+    w->n+=n;
+}
+
+uint32_t dsp_isqrt64(uint64_t x) {
+    uint64_t root=0, bit=1ull<<62;
+
+    while(bit>x)
+        bit>>=2;
+    while(bit) {
+        if(x>=root+bit) {
+            x-=root+bit;
+            root=(root>>1)+bit;
+        } else {
+            root>>=1;
+        }
+        bit>>=2;
+    }
+    return (uint32_t) root;
+}
+
+// round to nearest, ties away from zero
+inline static int64_t dsp_div_round(int64_t a, int64_t b) {
+    return a>=0?(a+b/2)/b:-((-a+b/2)/b);
+}
+
+int32_t dsp_log2_q16(uint64_t x) {
+    if(x==0)
+        return 0;
+
+    int32_t e=63;
+    while(!(x>>e))
+        --e;
+
+    // mantissa in [1, 2) as Q30, then one fractional bit per squaring
+    uint32_t m=e>=30?(uint32_t) (x>>(e-30)):(uint32_t) (x<<(30-e));
+    int32_t frac=0;
+    for(int32_t bit=1<<15; bit; bit>>=1) {
+        m=(uint32_t) (((uint64_t) m*m)>>30);
+        if(m>=1u<<31) {
+            m>>=1;
+            frac|=bit;
+        }
+    }
+    return (e<<16)|frac;
+}
+
+int32_t dsp_db_centi(uint64_t num, uint64_t den) {
+    if(num==0 || den==0)
+        return DSP_DB_FLOOR;
+
+    // 1000*log10(2) = 301.03 hundredths of a dB per factor of 2
+    int64_t l=(int64_t) dsp_log2_q16(num)-dsp_log2_q16(den);
+    return (int32_t) dsp_div_round(l*30103, 100*65536);
+}
+
+bool dsp_window_features(const dsp_window_t *w, dsp_features_t *f) {
+    if(w->n==0 || w->n>DSP_WINDOW_MAX)
+        return false;
+
+    int64_t n=w->n;
+    int64_t mean=dsp_div_round(w->sum, n);
+
+    // n*var = sumsq - sum^2/n; sum^2 stays below 2^62 for n <= DSP_WINDOW_MAX
+    int64_t nvar=(int64_t) w->sumsq-dsp_div_round(w->sum*w->sum, n);
+    if(nvar<0)
+        nvar=0;
+    uint32_t rms=dsp_isqrt64((uint64_t) dsp_div_round(nvar, n));
+
+    int32_t hi=w->max-(int32_t) mean, lo=(int32_t) mean-w->min;
+    uint32_t peak=hi>lo?hi:lo;
+
+    f->mean=(int16_t) mean;
+    f->rms=rms>UINT16_MAX?UINT16_MAX:rms;
+    f->peak=peak>UINT16_MAX?UINT16_MAX:peak;
+    if(rms==0) {
+        f->crest_q8=0;
+    } else {
+        uint32_t crest=(peak<<8)/rms;
+        f->crest_q8=crest>UINT16_MAX?UINT16_MAX:crest;
+    }
+    f->n=w->n;
+    return true;
+}
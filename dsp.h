@@ -0,0 +1,162 @@
+/**
+* @file dsp.h
+*
+* fixed-point signal processing for the sensor task: Q15 FIR decimation and
+* per-window features (mean, rms, peak, crest factor), no floating point
+*/
+
+#ifndef _inc_dsp
+#define _inc_dsp
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+*	@brief longest filter dsp_fir_init accepts
+*/
+#define DSP_FIR_MAX_TAPS 64
+
+/**
+*	@brief longest window dsp_window_features handles without overflow
+*/
+#define DSP_WINDOW_MAX 65535
+
+/**
+*	@brief stride argument for samples stored inside an array of structs,
+*	e.g. dsp_fir_decimate(f, &s[0].ax, n, DSP_STRIDE(s[0]), out)
+*/
+#define DSP_STRIDE(item) (sizeof(item)/sizeof(int16_t))
+
+/**
+*	@brief decimating FIR filter state
+*
+*	The delay line is stored twice so the newest ntaps samples are always
+*	contiguous and the inner loop has no wrap-around.
+*/
+typedef struct {
+    const int16_t *taps;	/**< Q15 coefficients, see tools/firgen.py */
+    uint32_t ntaps;
+    uint32_t decim;		/**< one output every decim inputs */
+    uint32_t phase;		/**< inputs since the last output */
+    uint32_t pos;		/**< oldest sample in hist */
+    int16_t hist[2*DSP_FIR_MAX_TAPS];
+} dsp_fir_t;
+
+/**
+*	@brief running sums of one window
+*/
+typedef struct {
+    int64_t sum;
+    uint64_t sumsq;
+    int16_t min, max;
+    uint32_t n;
+} dsp_window_t;
+
+/**
+*	@brief features of a window, in input units
+*/
+typedef struct {
+    int16_t mean;
+    uint16_t rms;		/**< rms around the mean */
+    uint16_t peak;		/**< largest distance from the mean */
+    uint16_t crest_q8;	/**< peak/rms in Q8.8, 0 for a constant window */
+    uint32_t n;			/**< samples in the window */
+} dsp_features_t;
+
+/**
+*	@brief set up a filter
+*
+*	The sum of the absolute taps must stay below 2.0 (65536 in Q15) so the
+*	32 bit accumulator cannot overflow.
+*
+*	@param[in] f : filter state
+*	@param[in] taps : Q15 coefficients, must stay valid
+*	@param[in] ntaps : number of taps, 1 to DSP_FIR_MAX_TAPS
+*	@param[in] decim : decimation factor, 1 for plain filtering
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool dsp_fir_init(dsp_fir_t *f, const int16_t *taps, uint32_t ntaps, uint32_t decim);
+
+/**
+*	@brief clear the delay line
+*
+*	@param[in] f : filter state
+*/
+void dsp_fir_reset(dsp_fir_t *f);
+
+/**
+*	@brief filter and decimate a block
+*
+*	Only every decim-th output is computed. Blocks may have any length, the
+*	decimation phase carries over.
+*
+*	@param[in] f : filter state
+*	@param[in] in : first input sample
+*	@param[in] n : number of input samples
+*	@param[in] stride : distance between input samples in int16_t units
+*	@param[out] out : room for n/decim+1 outputs
+*
+*	@return number of outputs written
+*/
+size_t dsp_fir_decimate(dsp_fir_t *f, const int16_t *in, size_t n, size_t stride, int16_t *out);
+
+/**
+*	@brief start a new window
+*
+*	@param[in] w : window
+*/
+void dsp_window_reset(dsp_window_t *w);
+
+/**
+*	@brief add samples to a window
+*
+*	@param[in] w : window
+*	@param[in] x : samples
+*	@param[in] n : number of samples
+*/
+void dsp_window_add(dsp_window_t *w, const int16_t *x, size_t n);
+
+/**
+*	@brief compute the features of a window
+*
+*	@param[in] w : window, left unchanged
+*	@param[out] f : features
+*
+*	@return bool.
+*	@retval false if the window is empty or longer than DSP_WINDOW_MAX
+*/
+bool dsp_window_features(const dsp_window_t *w, dsp_features_t *f);
+
+/**
+*	@brief integer square root, rounded down
+*/
+uint32_t dsp_isqrt64(uint64_t x);
+
+/**
+*	@brief base 2 logarithm in Q16 (16 fractional bits)
+*
+*	@param[in] x : argument, > 0
+*
+*	@return log2(x)*65536, rounded down; 0 for x==0
+*/
+int32_t dsp_log2_q16(uint64_t x);
+
+/**
+*	@brief power ratio in hundredths of a dB: 10*log10(num/den)
+*
+*	@param[in] num : power, > 0
+*	@param[in] den : reference power, > 0
+*
+*	@return level in 0.01 dB, DSP_DB_FLOOR if num is 0
+*/
+int32_t dsp_db_centi(uint64_t num, uint64_t den);
+
+/**
+*	@brief level reported for zero power (-200 dB)
+*/
+#define DSP_DB_FLOOR (-20000)
+
+#endif
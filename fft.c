@@ -0,0 +1,220 @@
+/**
+* @file fft.c
+*
+* fixed-point real fft and vibration spectrum
+*/
+
+#include <string.h>
+
+#include "fft.h"
+#include "dsp.h"
+#include "fft_tables.h"
+
+#if FFT_TABLE_N!=FFT_MAX_N
+#error fft_tables.h was generated for another FFT_MAX_N
+#endif
+
+// largest input magnitude after block scaling, one bit of butterfly headroom
+#define FFT_INPUT_MAX 16383
+
+inline static uint32_t fft_log2(uint32_t n) {
+    uint32_t bits=0;
+    while((1u<<bits)<n)
+        ++bits;
+    return bits;
+}
+
+static void fft_bit_reverse(fft_cpx_t *x, uint32_t m, uint32_t bits) {
+    for(uint32_t i=0; i<m; ++i) {
+        uint32_t r=0;
+        for(uint32_t b=0, v=i; b<bits; ++b, v>>=1)
+            r=(r<<1)|(v&1);
+        if(r>i) {
+            fft_cpx_t t=x[i];
+            x[i]=x[r];
+            x[r]=t;
+        }
+    }
+}
+
+// in-place complex radix-2 DIT, each stage scaled by 1/2
+static void fft_complex_q15(fft_cpx_t *x, uint32_t m) {
+    fft_bit_reverse(x, m, fft_log2(m));
+
+    for(uint32_t len=2; len<=m; len<<=1) {
+        uint32_t half=len>>1;
+        uint32_t step=FFT_MAX_N/len;
+
+        for(uint32_t j=0; j<half; ++j) {
+            int32_t wr=fft_cos[j*step], wi=fft_sin[j*step];
+
+            for(uint32_t i=j; i<m; i+=len) {
+                fft_cpx_t *a=&x[i], *b=&x[i+half];
+                // t = b * exp(-i*2*pi*j/len)
+                int32_t tr=(wr*b->re+wi*b->im+(1<<14))>>15;
+                int32_t ti=(wr*b->im-wi*b->re+(1<<14))>>15;
+                int32_t ar=a->re, ai=a->im;
+                a->re=(int16_t) ((ar+tr)>>1);
+                a->im=(int16_t) ((ai+ti)>>1);
+                b->re=(int16_t) ((ar-tr)>>1);
+                b->im=(int16_t) ((ai-ti)>>1);
+            }
+        }
+    }
+}
+
+bool fft_real_q15(fft_cpx_t *x, uint32_t n, fft_cpx_t *out) {
+    if(n<4 || n>FFT_MAX_N || (n&(n-1)))
+        return false;
+
+    uint32_t m=n/2;
+    uint32_t step=FFT_MAX_N/n;
+    fft_complex_q15(x, m);
+
+    // split the packed transform Z (scaled 1/m) into X (scaled 1/n):
+    // X[k] = (Z[k]+Z*[m-k])/4 - i/4 W^k (Z[k]-Z*[m-k]), W = exp(-i*2*pi/n)
+    int32_t r0=x[0].re, i0=x[0].im;
+    out[0].re=(int16_t) ((r0+i0)>>1);
+    out[0].im=0;
+    out[m].re=(int16_t) ((r0-i0)>>1);
+    out[m].im=0;
+
+    for(uint32_t k=1; k<m; ++k) {
+        int32_t ar=x[k].re, ai=x[k].im;
+        int32_t br=x[m-k].re, bi=-x[m-k].im;
+        int32_t sr=(ar+br)>>1, si=(ai+bi)>>1;
+        // -i*(A-B)/2
+        int32_t pr=(ai-bi)>>1, pi=-((ar-br)>>1);
+        int32_t c=fft_cos[k*step], s=fft_sin[k*step];
+        int32_t tr=(c*pr+s*pi+(1<<14))>>15;
+        int32_t ti=(c*pi-s*pr+(1<<14))>>15;
+        out[k].re=(int16_t) ((sr+tr)>>1);
+        out[k].im=(int16_t) ((si+ti)>>1);
+    }
+    return true;
+}
+
+bool fft_spectrum_init(fft_spectrum_t *s, uint32_t n, uint32_t fs_hz) {
+    if(n<4 || n>FFT_MAX_N || (n&(n-1)) || fs_hz==0)
+        return false;
+
+    s->n=n;
+    s->fs_hz=fs_hz;
+    fft_spectrum_reset(s);
+    return true;
+}
+
+void fft_spectrum_reset(fft_spectrum_t *s) {
+    s->windows=0;
+    memset(s->power, 0, sizeof(s->power));
+}
+
+void fft_spectrum_add(fft_spectrum_t *s, const int16_t *in, size_t stride) {
+    const uint32_t n=s->n, step=FFT_MAX_N/n;
+    int16_t *w=(int16_t *) s->work;
+
+    int32_t sum=0;
+    for(uint32_t i=0; i<n; ++i)
+        sum+=in[i*stride];
+    int32_t mean=sum/(int32_t) n;
+
+    int32_t dev=0;
+    for(uint32_t i=0; i<n; ++i) {
+        int32_t d=in[i*stride]-mean;
+        if(d<0)
+            d=-d;
+        if(d>dev)
+            dev=d;
+    }
+
+    // block floating point: shift right until the largest value fits, or
+    // left while it still fits
+    int32_t shift=0;
+    if(dev>FFT_INPUT_MAX) {
+        while((dev>>-shift)>FFT_INPUT_MAX)
+            --shift;
+    } else if(dev>0) {
+        while((dev<<(shift+1))<=FFT_INPUT_MAX && shift<14)
+            ++shift;
+    }
+
+    for(uint32_t i=0; i<n; ++i) {
+        int32_t d=in[i*stride]-mean;
+        d=shift>=0?d*(1<<shift):d>>-shift;
+        int32_t h=fft_hann[(i<=n/2?i:n-i)*step];
+        w[i]=(int16_t) ((d*h+(1<<14))>>15);
+    }
+
+    fft_real_q15(s->work, n, s->bins);
+
+    // back to input units: power / 4^shift, kept with FFT_POWER_FRAC bits
+    int32_t up=FFT_POWER_FRAC-2*shift;
+    for(uint32_t k=0; k<=n/2; ++k) {
+        int32_t re=s->bins[k].re, im=s->bins[k].im;
+        uint64_t p=(uint32_t) (re*re)+(uint32_t) (im*im);
+        s->power[k]+=up>=0?p<<up:p>>-up;
+    }
+}
+
+void fft_spectrum_next_window(fft_spectrum_t *s) {
+    ++s->windows;
+}
+
+// mean power of bin k over the windows, FFT_POWER_FRAC fraction bits
+inline static uint64_t fft_bin_power(const fft_spectrum_t *s, uint32_t k) {
+    return s->windows?s->power[k]/s->windows:0;
+}
+
+void fft_spectrum_bands(const fft_spectrum_t *s, const uint16_t *edges_hz, size_t nbands, uint32_t *rms) {
+    const uint32_t n=s->n;
+
+    for(size_t b=0; b<nbands; ++b) {
+        uint64_t sum=0;
+        for(uint32_t k=1; k<=n/2; ++k) {
+            uint32_t f=(k*s->fs_hz+n/2)/n;
+            if(f>=edges_hz[b] && f<edges_hz[b+1])
+                sum+=fft_bin_power(s, k);
+        }
+        // one-sided bins hold half the power, the Hann window keeps 3/8
+        // of it: rms^2 = 2*sum/0.375
+        rms[b]=dsp_isqrt64(sum/3*16)>>(FFT_POWER_FRAC/2);
+    }
+}
+
+size_t fft_spectrum_peaks(const fft_spectrum_t *s, fft_peak_t *peaks, size_t max) {
+    const uint32_t n=s->n;
+    uint64_t top[FFT_PEAKS_MAX];
+    size_t found=0;
+
+    if(max>FFT_PEAKS_MAX)
+        max=FFT_PEAKS_MAX;
+
+    for(uint32_t k=2; k<n/2; ++k) {
+        uint64_t p=fft_bin_power(s, k), left=fft_bin_power(s, k-1), right=fft_bin_power(s, k+1);
+        if(p==0 || p<=left || p<right)
+            continue;
+
+        // insert sorted, largest first
+        size_t pos=found<max?found:max;
+        while(pos>0 && top[pos-1]<p)
+            --pos;
+        if(pos>=max)
+            continue;
+        size_t last=found<max?found:max-1;
+        for(size_t i=last; i>pos; --i) {
+            top[i]=top[i-1];
+            peaks[i]=peaks[i-1];
+        }
+        if(found<max)
+            ++found;
+
+        // parabolic interpolation of the vertex, in hundredths of a bin
+        int64_t den=2*(2*(int64_t) p-(int64_t) left-(int64_t) right);
+        int64_t delta=den?((int64_t) right-(int64_t) left)*100/den:0;
+        top[pos]=p;
+        peaks[pos].freq_chz=(uint32_t) (((int64_t) k*100+delta)*s->fs_hz/n);
+        // Hann coherent gain 1/2 and |X|=A/2: A = 4*|X|
+        peaks[pos].amp=dsp_isqrt64(p)>>(FFT_POWER_FRAC/2-2);
+    }
+    return found;
+}
@@ -0,0 +1,136 @@
+/**
+* @file fft.h
+*
+* fixed-point real fft (radix-2, Q15, 1/N scaled) and a vibration spectrum
+* built on it: averaged power per bin, band levels and the strongest peaks
+*/
+
+#ifndef _inc_fft
+#define _inc_fft
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+*	@brief longest transform, must match the generated fft_tables.h
+*/
+#define FFT_MAX_N 512
+
+/**
+*	@brief fractional bits of fft_spectrum_t.power
+*/
+#define FFT_POWER_FRAC 16
+
+/**
+*	@brief most peaks fft_spectrum_peaks returns
+*/
+#define FFT_PEAKS_MAX 8
+
+typedef struct {
+    int16_t re, im;
+} fft_cpx_t;
+
+/**
+*	@brief real input transform
+*
+*	x holds the n real samples packed in pairs (x[i].re=s[2i], x[i].im=
+*	s[2i+1]) and is used as the work buffer. Every stage halves the values,
+*	out[k] is the DFT divided by n, so |out[k]| of a sine of amplitude A is
+*	A/2. Keep the input within +-16383 to leave room for the butterflies.
+*
+*	@param[in] x : n/2 packed samples, overwritten
+*	@param[in] n : power of two, 4 to FFT_MAX_N
+*	@param[out] out : n/2+1 bins, DC to Nyquist
+*
+*	@return bool.
+*	@retval false if n is not supported
+*/
+bool fft_real_q15(fft_cpx_t *x, uint32_t n, fft_cpx_t *out);
+
+/**
+*	@brief power spectrum averaged over windows (and summed over axes when
+*	several are added per window)
+*/
+typedef struct {
+    uint32_t n;			/**< transform length */
+    uint32_t fs_hz;		/**< sample rate */
+    uint32_t windows;	/**< windows accumulated */
+    uint64_t power[FFT_MAX_N/2+1];	/**< sum of |X[k]|^2, FFT_POWER_FRAC fraction bits */
+    fft_cpx_t work[FFT_MAX_N/2];
+    fft_cpx_t bins[FFT_MAX_N/2+1];
+} fft_spectrum_t;
+
+/**
+*	@brief one spectral peak
+*/
+typedef struct {
+    uint32_t freq_chz;	/**< frequency in hundredths of Hz (interpolated) */
+    uint32_t amp;		/**< amplitude of the sine, input units */
+} fft_peak_t;
+
+/**
+*	@brief set up an empty spectrum
+*
+*	@param[in] s : spectrum
+*	@param[in] n : transform length, power of two up to FFT_MAX_N
+*	@param[in] fs_hz : sample rate of the input
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool fft_spectrum_init(fft_spectrum_t *s, uint32_t n, uint32_t fs_hz);
+
+/**
+*	@brief clear the accumulated power
+*
+*	@param[in] s : spectrum
+*/
+void fft_spectrum_reset(fft_spectrum_t *s);
+
+/**
+*	@brief transform one window of one signal and add its power
+*
+*	The mean is removed, a Hann window applied and the block scaled to use
+*	the full Q15 range before the transform, so small vibrations keep their
+*	resolution. Adding several axes for the same window sums their power
+*	(vector magnitude); call fft_spectrum_next_window after the last one.
+*
+*	@param[in] s : spectrum
+*	@param[in] in : first of n samples
+*	@param[in] stride : distance between samples in int16_t units
+*/
+void fft_spectrum_add(fft_spectrum_t *s, const int16_t *in, size_t stride);
+
+/**
+*	@brief count one window for the average
+*
+*	@param[in] s : spectrum
+*/
+void fft_spectrum_next_window(fft_spectrum_t *s);
+
+/**
+*	@brief rms level per frequency band
+*
+*	Band i covers edges_hz[i] <= f < edges_hz[i+1]. The levels add up (as
+*	squares) to the rms of the signal without its mean.
+*
+*	@param[in] s : spectrum, at least one window
+*	@param[in] edges_hz : nbands+1 increasing band edges
+*	@param[in] nbands : number of bands
+*	@param[out] rms : rms per band, input units
+*/
+void fft_spectrum_bands(const fft_spectrum_t *s, const uint16_t *edges_hz, size_t nbands, uint32_t *rms);
+
+/**
+*	@brief strongest local maxima, largest first
+*
+*	@param[in] s : spectrum, at least one window
+*	@param[out] peaks : destination
+*	@param[in] max : entries in peaks, up to FFT_PEAKS_MAX
+*
+*	@return number of peaks found
+*/
+size_t fft_spectrum_peaks(const fft_spectrum_t *s, fft_peak_t *peaks, size_t max);
+
+#endif
@@ -0,0 +1,58 @@
+/**
+* @file frame.c
+*
+* packed little-endian telemetry frame writer
+*/
+
+#include "frame.h"
+
+void frame_begin(frame_t *f, void *buf, size_t size, frame_type_t type) {
+    f->buf=buf;
+    f->size=size;
+    f->len=0;
+    f->overflow=false;
+    frame_u8(f, FRAME_VERSION);
+    frame_u8(f, type);
+    frame_u16(f, 0);	// payload length, set by frame_end
+}
+
+void frame_u8(frame_t *f, uint8_t v) {
+    if(f->len+1>f->size) {
+        f->overflow=true;
+        return;
+    }
+    f->buf[f->len++]=v;
+}
+
+void frame_u16(frame_t *f, uint16_t v) {
+    if(f->len+2>f->size) {
+        f->overflow=true;
+        return;
+    }
+    f->buf[f->len++]=v;
+    f->buf[f->len++]=v>>8;
+}
+
+void frame_u32(frame_t *f, uint32_t v) {
+    if(f->len+4>f->size) {
+        f->overflow=true;
+        return;
+    }
+    f->buf[f->len++]=v;
+    f->buf[f->len++]=v>>8;
+    f->buf[f->len++]=v>>16;
+    f->buf[f->len++]=v>>24;
+}
+
+void frame_i16_sat(frame_t *f, int32_t v) {
+    frame_i16(f, v>INT16_MAX?INT16_MAX:v<INT16_MIN?INT16_MIN:v);
+}
+
+size_t frame_end(frame_t *f) {
+    size_t payload=f->len-FRAME_HEADER_SIZE;
+    if(f->overflow || payload>UINT16_MAX)
+        return 0;
+    f->buf[2]=payload;
+    f->buf[3]=payload>>8;
+    return f->len;
+}
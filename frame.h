@@ -0,0 +1,95 @@
+/**
+* @file frame.h
+*
+* packed little-endian telemetry frames: a 4 byte header (version, type,
+* payload length) followed by fixed-width fields in an order set by the
+* version. Fields are only ever appended within a version, so a reader can
+* skip what it does not know using the length
+*/
+
+#ifndef _inc_frame
+#define _inc_frame
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+*	@brief layout version written in every header
+*/
+#define FRAME_VERSION 1
+
+/**
+*	@brief header bytes before the payload
+*/
+#define FRAME_HEADER_SIZE 4
+
+/**
+*	@brief HTTP Content-Type of a body made of frames back to back
+*/
+#define FRAME_CONTENT_TYPE "application/x-bitdog-frame"
+
+/**
+*	@brief what a frame carries
+*/
+typedef enum {
+    FRAME_SENSOR=1	/**< one sensor_data_t sample */
+} frame_type_t;
+
+/**
+*	@brief frame being written
+*/
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;		/**< bytes written, header included */
+    bool overflow;	/**< a field did not fit, the frame is invalid */
+} frame_t;
+
+/**
+*	@brief start a frame in buf
+*
+*	@param[in] f : frame
+*	@param[in] buf : destination, written directly
+*	@param[in] size : room in buf
+*	@param[in] type : frame type
+*/
+void frame_begin(frame_t *f, void *buf, size_t size, frame_type_t type);
+
+/**
+*	@brief append one little-endian field
+*/
+void frame_u8(frame_t *f, uint8_t v);
+void frame_u16(frame_t *f, uint16_t v);
+void frame_u32(frame_t *f, uint32_t v);
+
+/**
+*	@brief signed fields, two's complement
+*/
+static inline void frame_i8(frame_t *f, int8_t v) {
+    frame_u8(f, (uint8_t) v);
+}
+
+static inline void frame_i16(frame_t *f, int16_t v) {
+    frame_u16(f, (uint16_t) v);
+}
+
+static inline void frame_i32(frame_t *f, int32_t v) {
+    frame_u32(f, (uint32_t) v);
+}
+
+/**
+*	@brief append a value saturated to int16
+*/
+void frame_i16_sat(frame_t *f, int32_t v);
+
+/**
+*	@brief fill in the payload length
+*
+*	@param[in] f : frame
+*
+*	@return frame size in bytes, 0 if it overflowed
+*/
+size_t frame_end(frame_t *f);
+
+#endif
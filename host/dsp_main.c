@@ -0,0 +1,420 @@
+/**
+* @file dsp_main.c
+*
+* host harness for dsp.c and fft.c: checks the fixed-point kernels against
+* double precision golden vectors computed from the same inputs, and times
+* them
+*
+* usage: dsp_bench [iterations]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dsp.h"
+#include "fft.h"
+#include "fir_taps.h"
+
+#define DECIM 10
+#define BLOCK 1000
+
+static uint32_t iterations=2000;
+static int failures=0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ull+ts.tv_nsec;
+}
+
+// keeps the optimizer from dropping the loops
+static volatile int32_t sink;
+
+// deterministic test signal: gravity offset, 12 Hz and 180 Hz tones and noise
+// at 1 kHz, in accelerometer LSB
+static void make_signal(int16_t *x, size_t n) {
+    uint32_t seed=12345;
+    for(size_t i=0; i<n; ++i) {
+        seed=seed*1664525u+1013904223u;
+        double noise=((int32_t) (seed>>16)-32768)/32768.0*300.0;
+        double v=16384.0+6000.0*sin(2*M_PI*12*i/1000.0)+3000.0*sin(2*M_PI*180*i/1000.0)+noise;
+        x[i]=(int16_t) lrint(v);
+    }
+}
+
+static void ref_fir(const int16_t *taps, uint32_t ntaps, const int16_t *x, size_t n, uint32_t decim, double *out) {
+    for(size_t i=decim-1, o=0; i<n; i+=decim, ++o) {
+        double acc=0;
+        for(uint32_t k=0; k<ntaps && k<=i; ++k)
+            acc+=taps[k]/32768.0*x[i-k];
+        out[o]=acc;
+    }
+}
+
+static void check_isqrt(void) {
+    static const struct { uint64_t x; uint32_t root; } golden[]= {
+        {0, 0}, {1, 1}, {2, 1}, {3, 1}, {4, 2}, {15, 3}, {16, 4}, {17, 4},
+        {999999, 999}, {1000000, 1000}, {0xFFFFFFFFull, 65535},
+        {1ull<<62, 1u<<31}, {0xFFFFFFFFFFFFFFFFull, 0xFFFFFFFFu},
+    };
+    for(size_t i=0; i<sizeof(golden)/sizeof(golden[0]); ++i)
+        if(dsp_isqrt64(golden[i].x)!=golden[i].root) {
+            printf("isqrt(%llu)=%u, want %u\n", (unsigned long long) golden[i].x,
+                   dsp_isqrt64(golden[i].x), golden[i].root);
+            ++failures;
+        }
+}
+
+static void check_log(void) {
+    static const uint64_t x[]= {
+        1, 2, 3, 5, 10, 1000, 4095, 65535, 123456789, 1ull<<40, 0xFFFFFFFFFFFFFFFFull,
+    };
+    double worst=0;
+
+    for(size_t i=0; i<sizeof(x)/sizeof(x[0]); ++i) {
+        double err=fabs(dsp_log2_q16(x[i])-log2((double) x[i])*65536);
+        if(err>worst)
+            worst=err;
+    }
+    // full-scale sine (amplitude 2048, power 2048^2/2) down to 1 LSB rms
+    int32_t db_worst=0;
+    for(uint64_t p=1; p<(1ull<<40); p=p*7+3) {
+        int32_t got=dsp_db_centi(p, 2048*2048/2);
+        int32_t want=(int32_t) lround(1000*log10((double) p/(2048*2048/2)));
+        if(abs(got-want)>db_worst)
+            db_worst=abs(got-want);
+    }
+    printf("log2 Q16 max err %.2f, dB max err %d/100\n", worst, db_worst);
+    if(worst>2 || db_worst>1 || dsp_db_centi(0, 1)!=DSP_DB_FLOOR) {
+        printf("log check failed\n");
+        ++failures;
+    }
+}
+
+static void check_fir(void) {
+    dsp_fir_t f;
+    int16_t x[BLOCK], y[BLOCK];
+    double ref[BLOCK];
+
+    if(dsp_fir_init(&f, fir_imu_lowpass, DSP_FIR_MAX_TAPS+1, 1)) {
+        printf("dsp_fir_init accepted too many taps\n");
+        ++failures;
+    }
+
+    // impulse response: the taps themselves, rounded once
+    dsp_fir_init(&f, fir_imu_lowpass, FIR_IMU_LOWPASS_TAPS, 1);
+    memset(x, 0, sizeof(x));
+    x[0]=32767;
+    dsp_fir_decimate(&f, x, FIR_IMU_LOWPASS_TAPS, 1, y);
+    for(uint32_t k=0; k<FIR_IMU_LOWPASS_TAPS; ++k)
+        if(y[k]!=(int16_t) ((fir_imu_lowpass[k]*32767+(1<<14))>>15)) {
+            printf("fir impulse response differs at tap %u\n", k);
+            ++failures;
+            break;
+        }
+
+    // unity DC gain: a constant comes out exact once the delay line is full
+    dsp_fir_init(&f, fir_imu_lowpass, FIR_IMU_LOWPASS_TAPS, DECIM);
+    for(size_t i=0; i<BLOCK; ++i)
+        x[i]=-12345;
+    size_t n=dsp_fir_decimate(&f, x, BLOCK, 1, y);
+    for(size_t i=FIR_IMU_LOWPASS_TAPS/DECIM+1; i<n; ++i)
+        if(y[i]!=-12345) {
+            printf("fir DC gain is not 1: %d\n", y[i]);
+            ++failures;
+            break;
+        }
+
+    // golden vectors: within one LSB of double precision, block size must
+    // not matter, strided input must match contiguous input
+    make_signal(x, BLOCK);
+    ref_fir(fir_imu_lowpass, FIR_IMU_LOWPASS_TAPS, x, BLOCK, DECIM, ref);
+    static const size_t chunks[]= {BLOCK, 1, 7, 32, 333};
+    for(size_t c=0; c<sizeof(chunks)/sizeof(chunks[0]); ++c) {
+        dsp_fir_init(&f, fir_imu_lowpass, FIR_IMU_LOWPASS_TAPS, DECIM);
+        n=0;
+        for(size_t i=0; i<BLOCK; i+=chunks[c]) {
+            size_t len=BLOCK-i<chunks[c]?BLOCK-i:chunks[c];
+            n+=dsp_fir_decimate(&f, x+i, len, 1, y+n);
+        }
+        if(n!=BLOCK/DECIM) {
+            printf("fir in blocks of %zu: %zu outputs, want %d\n", chunks[c], n, BLOCK/DECIM);
+            ++failures;
+            continue;
+        }
+        for(size_t i=0; i<n; ++i)
+            if(fabs(y[i]-ref[i])>1.0) {
+                printf("fir in blocks of %zu: output %zu is %d, golden %.2f\n", chunks[c], i, y[i], ref[i]);
+                ++failures;
+                break;
+            }
+    }
+
+    struct { int16_t a, b, c; uint32_t t; } strided[BLOCK];
+    for(size_t i=0; i<BLOCK; ++i)
+        strided[i].b=x[i];
+    int16_t ys[BLOCK];
+    dsp_fir_init(&f, fir_imu_lowpass, FIR_IMU_LOWPASS_TAPS, DECIM);
+    dsp_fir_decimate(&f, &strided[0].b, BLOCK, DSP_STRIDE(strided[0]), ys);
+    if(memcmp(ys, y, BLOCK/DECIM*sizeof(int16_t))) {
+        printf("fir with stride differs from contiguous input\n");
+        ++failures;
+    }
+
+    // the 180 Hz tone is above the 50 Hz output Nyquist and must be gone
+    double peak=0;
+    for(size_t i=FIR_IMU_LOWPASS_TAPS/DECIM+1; i<BLOCK/DECIM; ++i) {
+        double e=fabs(y[i]-(16384.0+6000.0*sin(2*M_PI*12*(i*DECIM+DECIM-1-FIR_IMU_LOWPASS_TAPS/2)/1000.0)));
+        if(e>peak)
+            peak=e;
+    }
+    printf("fir_imu_lowpass: %d taps, decimation %d, worst error vs 12 Hz tone %.0f LSB (180 Hz tone was 3000)\n",
+           FIR_IMU_LOWPASS_TAPS, DECIM, peak);
+    if(peak>600) {
+        printf("fir does not suppress the 180 Hz tone\n");
+        ++failures;
+    }
+}
+
+static void ref_features(const int16_t *x, size_t n, double *mean, double *rms, double *peak) {
+    double s=0, ss=0;
+    for(size_t i=0; i<n; ++i)
+        s+=x[i];
+    *mean=s/n;
+    *peak=0;
+    for(size_t i=0; i<n; ++i) {
+        double d=x[i]-*mean;
+        ss+=d*d;
+        if(fabs(d)>*peak)
+            *peak=fabs(d);
+    }
+    *rms=sqrt(ss/n);
+}
+
+static void check_window(void) {
+    dsp_window_t w;
+    dsp_features_t f;
+    int16_t x[BLOCK];
+
+    dsp_window_reset(&w);
+    if(dsp_window_features(&w, &f)) {
+        printf("features of an empty window\n");
+        ++failures;
+    }
+
+    // square wave (whole periods): crest factor exactly 1
+    for(size_t i=0; i<BLOCK; ++i)
+        x[i]=(i&8)?1500:-500;
+    dsp_window_add(&w, x, BLOCK&~15);
+    dsp_window_features(&w, &f);
+    if(f.mean!=500 || f.rms!=1000 || f.peak!=1000 || f.crest_q8!=256) {
+        printf("square wave: mean %d rms %u peak %u crest %u, want 500 1000 1000 256\n",
+               f.mean, f.rms, f.peak, f.crest_q8);
+        ++failures;
+    }
+
+    // constant: no crest factor
+    for(size_t i=0; i<BLOCK; ++i)
+        x[i]=-32768;
+    dsp_window_reset(&w);
+    dsp_window_add(&w, x, BLOCK);
+    dsp_window_features(&w, &f);
+    if(f.mean!=-32768 || f.rms!=0 || f.peak!=0 || f.crest_q8!=0) {
+        printf("constant window: mean %d rms %u peak %u crest %u\n", f.mean, f.rms, f.peak, f.crest_q8);
+        ++failures;
+    }
+
+    // golden vectors, added in uneven pieces
+    make_signal(x, BLOCK);
+    dsp_window_reset(&w);
+    for(size_t i=0; i<BLOCK; i+=37)
+        dsp_window_add(&w, x+i, BLOCK-i<37?BLOCK-i:37);
+    dsp_window_features(&w, &f);
+    double mean, rms, peak;
+    ref_features(x, BLOCK, &mean, &rms, &peak);
+    if(fabs(f.mean-mean)>0.5 || fabs(f.rms-rms)>1.0 || fabs(f.peak-peak)>1.0
+            || fabs(f.crest_q8/256.0-peak/rms)>2.0/256) {
+        printf("window: mean %d rms %u peak %u crest %.3f, golden %.1f %.1f %.1f %.3f\n",
+               f.mean, f.rms, f.peak, f.crest_q8/256.0, mean, rms, peak, peak/rms);
+        ++failures;
+    }
+}
+
+// double precision DFT scaled 1/n, bins 0..n/2
+static void ref_dft(const int16_t *x, uint32_t n, double *re, double *im) {
+    for(uint32_t k=0; k<=n/2; ++k) {
+        re[k]=im[k]=0;
+        for(uint32_t i=0; i<n; ++i) {
+            re[k]+=x[i]*cos(2*M_PI*k*i/n)/n;
+            im[k]-=x[i]*sin(2*M_PI*k*i/n)/n;
+        }
+    }
+}
+
+static void sine(int16_t *x, size_t n, size_t stride, double offset, double amp, double hz, double fs) {
+    for(size_t i=0; i<n; ++i)
+        x[i*stride]=(int16_t) lrint(offset+amp*sin(2*M_PI*hz*i/fs));
+}
+
+static void check_fft(void) {
+    static const uint32_t sizes[]= {8, 64, 256, 512};
+    static fft_cpx_t work[FFT_MAX_N/2], out[FFT_MAX_N/2+1];
+    static double re[FFT_MAX_N/2+1], im[FFT_MAX_N/2+1];
+    int16_t x[FFT_MAX_N];
+
+    if(fft_real_q15(work, 384, out) || fft_real_q15(work, 2*FFT_MAX_N, out)) {
+        printf("fft accepted an unsupported length\n");
+        ++failures;
+    }
+
+    // golden vectors: random input within the +-16383 the transform expects;
+    // the per-stage rounding grows with log2(n)
+    for(size_t t=0; t<sizeof(sizes)/sizeof(sizes[0]); ++t) {
+        uint32_t n=sizes[t], seed=777+n;
+        for(uint32_t i=0; i<n; ++i) {
+            seed=seed*1664525u+1013904223u;
+            x[i]=(int16_t) ((int32_t) (seed>>17)-16384);
+        }
+        memcpy(work, x, n*sizeof(int16_t));
+        fft_real_q15(work, n, out);
+        ref_dft(x, n, re, im);
+        double worst=0;
+        for(uint32_t k=0; k<=n/2; ++k) {
+            double e=fmax(fabs(out[k].re-re[k]), fabs(out[k].im-im[k]));
+            if(e>worst)
+                worst=e;
+        }
+        if(worst>0.5+0.3*log2(n)) {
+            printf("fft %u: worst bin error %.2f LSB against the double DFT\n", n, worst);
+            ++failures;
+        }
+    }
+
+    // spectrum of a tone sitting between bins: interpolated frequency and
+    // amplitude, on top of gravity, summed over two identical axes
+    static fft_spectrum_t s;
+    int16_t xy[FFT_MAX_N][2];
+    fft_spectrum_init(&s, 512, 1000);
+    sine(&xy[0][0], 512, 2, 16384, 800, 123.4, 1000);
+    sine(&xy[0][1], 512, 2, -200, 800, 123.4, 1000);
+    fft_spectrum_add(&s, &xy[0][0], 2);
+    fft_spectrum_add(&s, &xy[0][1], 2);
+    fft_spectrum_next_window(&s);
+    fft_peak_t peaks[3];
+    size_t np=fft_spectrum_peaks(&s, peaks, 3);
+    // two axes of amplitude 800 add up to a vector of 1131
+    if(np<1 || abs((int) peaks[0].freq_chz-12340)>50 || fabs(peaks[0].amp-800*M_SQRT2)>0.2*800*M_SQRT2) {
+        printf("fft peak: %zu found, %.2f Hz amplitude %u, want 123.40 Hz 1131\n",
+               np, np?peaks[0].freq_chz/100.0:0, np?peaks[0].amp:0);
+        ++failures;
+    }
+
+    // band levels add up to the time domain rms, down to small signals: the
+    // largest amplitude is shifted right before the fft, the small ones left
+    static const uint16_t edges[]= {0, 10, 25, 50, 100, 200, 501};
+    static const double amps[]= {15000, 3000, 40, 16};
+    for(size_t a=0; a<sizeof(amps)/sizeof(amps[0]); ++a) {
+        fft_spectrum_init(&s, 256, 1000);
+        double ss=0;
+        for(int w=0; w<4; ++w) {
+            for(uint32_t i=0; i<256; ++i) {
+                double t=(w*256+i)/1000.0;
+                double v=amps[a]*(sin(2*M_PI*17*t)+0.5*sin(2*M_PI*160*t));
+                x[i]=(int16_t) lrint(8000+v);
+                ss+=v*v;
+            }
+            fft_spectrum_add(&s, x, 1);
+            fft_spectrum_next_window(&s);
+        }
+        uint32_t rms[6];
+        fft_spectrum_bands(&s, edges, 6, rms);
+        double total=0;
+        for(int b=0; b<6; ++b)
+            total+=(double) rms[b]*rms[b];
+        double want=sqrt(ss/1024);
+        if(fabs(sqrt(total)-want)>0.05*want || rms[1]<rms[4] || rms[4]<rms[0]) {
+            printf("fft bands at amplitude %.0f: %u %u %u %u %u %u, total %.1f want %.1f\n", amps[a],
+                   rms[0], rms[1], rms[2], rms[3], rms[4], rms[5], sqrt(total), want);
+            ++failures;
+        }
+    }
+}
+
+static void bench_fft(void) {
+    static fft_cpx_t work[FFT_MAX_N/2], out[FFT_MAX_N/2+1];
+    static fft_spectrum_t s;
+    int16_t x[FFT_MAX_N];
+
+    make_signal(x, FFT_MAX_N);
+    for(uint32_t n=256; n<=FFT_MAX_N; n*=2) {
+        uint64_t t0=now_ns();
+        for(uint32_t i=0; i<iterations; ++i) {
+            memcpy(work, x, n*sizeof(int16_t));
+            fft_real_q15(work, n, out);
+            sink+=out[3].re;
+        }
+        double fft_ns=(double) (now_ns()-t0)/iterations;
+
+        fft_spectrum_init(&s, n, 1000);
+        t0=now_ns();
+        for(uint32_t i=0; i<iterations; ++i)
+            fft_spectrum_add(&s, x, 1);
+        double add_ns=(double) (now_ns()-t0)/iterations;
+
+        char name[48];
+        snprintf(name, sizeof(name), "fft_real_q15 %u", n);
+        printf("%-34s %10.1f ns/transform\n", name, fft_ns);
+        snprintf(name, sizeof(name), "fft_spectrum_add %u", n);
+        printf("%-34s %10.1f ns/window\n", name, add_ns);
+    }
+}
+
+static void bench_kernels(void) {
+    static int16_t x[BLOCK], y[BLOCK];
+    dsp_fir_t f;
+    dsp_window_t w;
+    dsp_features_t feat;
+    uint64_t t0;
+
+    make_signal(x, BLOCK);
+    dsp_fir_init(&f, fir_imu_lowpass, FIR_IMU_LOWPASS_TAPS, DECIM);
+
+    t0=now_ns();
+    for(uint32_t i=0; i<iterations; ++i)
+        sink+=dsp_fir_decimate(&f, x, BLOCK, 1, y);
+    double fir_ns=(double) (now_ns()-t0)/iterations/BLOCK;
+
+    t0=now_ns();
+    for(uint32_t i=0; i<iterations; ++i) {
+        dsp_window_reset(&w);
+        dsp_window_add(&w, y, BLOCK/DECIM);
+        dsp_window_features(&w, &feat);
+        sink+=feat.rms;
+    }
+    double win_ns=(double) (now_ns()-t0)/iterations;
+
+    printf("%-34s %10.1f ns/input sample\n", "dsp_fir_decimate 47 taps /10", fir_ns);
+    printf("%-34s %10.1f ns/window\n", "window of 100 + features", win_ns);
+    // six channels at 1 kHz, one window per 2 s report
+    printf("IMU pipeline (6 axes at 1 kHz): %.1f us of host time per second of data\n",
+           (6*1000*fir_ns+6*win_ns/2)/1000.0);
+}
+
+int main(int argc, char **argv) {
+    if(argc>1)
+        iterations=strtoul(argv[1], NULL, 0);
+
+    check_isqrt();
+    check_log();
+    check_fir();
+    check_window();
+    check_fft();
+    bench_kernels();
+    bench_fft();
+
+    printf("\n%s\n", failures?"FAILED":"OK");
+    return failures?1:0;
+}
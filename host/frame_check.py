@@ -0,0 +1,73 @@
+"""Round trip of the binary telemetry frames: decodes the file written by
+frame_test with decode_frames() from pico-server/server.py and compares it
+with the samples frame_test encoded.
+
+usage: python3 host/frame_check.py <frame_test output file>
+(needs the server requirements: flask, python-dotenv)
+"""
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "pico-server"))
+from server import decode_frames  # noqa: E402
+
+# the two samples in host/frame_main.c
+EXPECTED = [
+    {
+        "lux": -0.01,
+        "temp": 27.45,
+        "rssi": -67,
+        "uptime": 123456,
+        "accel": {"x": -16384, "y": -16383, "z": -16382},
+        "gyro": {"x": 300, "y": 600, "z": 900},
+        "temp_mpu": -5.12,
+        "vib": {"rms": [100, 101, 102], "peak": [65535, 65534, 65533], "crest": [2.25, 3.25, 4.25]},
+        "sound": {"leq": -42.1, "lmax": -15.0, "peak": -327.68},
+        "tx": {"sent": 77, "suppressed": 4000000000},
+        "sched": {"mpu": [20.0, 0], "bh1750": [10.0, 1], "sound": [6.66, 2], "rssi": [5.0, 3], "report": [4.0, 4]},
+        "net": {"rpc": 13.33, "lat_ms": 12.34, "lat_max_ms": 98.76, "conn": 3},
+    },
+    {
+        "lux": 0.0,
+        "temp": 0.0,
+        "rssi": 0,
+        "uptime": 0,
+        "accel": {"x": 0, "y": 0, "z": 0},
+        "gyro": {"x": 0, "y": 0, "z": 0},
+        "temp_mpu": 0.0,
+        "vib": {"rms": [0, 0, 0], "peak": [0, 0, 0], "crest": [0.0, 0.0, 0.0]},
+        "sound": {"leq": 327.67, "lmax": 0.0, "peak": 0.0},
+        "tx": {"sent": 0, "suppressed": 0},
+        "sched": {"mpu": [0.0, 0], "bh1750": [0.0, 0], "sound": [0.0, 0], "rssi": [0.0, 0], "report": [0.0, 0]},
+        "net": {"rpc": 0.0, "lat_ms": 0.0, "lat_max_ms": 0.0, "conn": 0},
+    },
+]
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 2
+    with open(sys.argv[1], "rb") as f:
+        samples = decode_frames(f.read())
+
+    failures = 0
+    if len(samples) != len(EXPECTED):
+        print(f"FAIL: {len(samples)} samples decoded, {len(EXPECTED)} expected")
+        failures += 1
+    for n, (got, want) in enumerate(zip(samples, EXPECTED)):
+        for key in want:
+            if got.get(key) != want[key]:
+                print(f"FAIL: sample {n} {key}: {got.get(key)} != {want[key]}")
+                failures += 1
+        for key in got.keys() - want.keys():
+            print(f"FAIL: sample {n} unexpected {key}")
+            failures += 1
+
+    print("FAILED" if failures else "OK")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,101 @@
+/**
+* @file frame_main.c
+*
+* host harness for sensor_frame.c: encodes two known samples, checks the
+* header and length, and writes the frames back to back to a file that
+* frame_check.py decodes with the server's decode_frames()
+*
+* usage: frame_test <output file>
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "frame.h"
+#include "sensor_frame.h"
+
+// payload of a version 1 sensor frame: fixed fields, rate and misses per
+// scheduler channel, four connection counters
+#define SENSOR_V1_FIXED 62
+#define SENSOR_V1_PAYLOAD (SENSOR_V1_FIXED+SCHED_CHANNELS*6+16)
+
+static int failures;
+
+static void check(bool ok, const char *what) {
+    if(!ok) {
+        printf("FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+int main(int argc, char **argv) {
+    static uint8_t buf[2*(FRAME_HEADER_SIZE+SENSOR_V1_PAYLOAD)];
+    sensor_data_t d;
+    http_conn_t net;
+    size_t len=0, n;
+
+    if(argc<2) {
+        printf("usage: %s <output file>\n", argv[0]);
+        return 2;
+    }
+
+    // every field distinct, negative where the type allows it; values must
+    // match frame_check.py
+    memset(&d, 0, sizeof(d));
+    d.uptime_sec=123456;
+    d.lux=-1;
+    d.temp_chip=2745;
+    d.temp_mpu=-512;
+    for(int i=0; i<3; ++i) {
+        d.accel[i]=(int16_t) (-16384+i);
+        d.gyro[i]=(int16_t) (300*(i+1));
+        d.vib_rms[i]=(uint16_t) (100+i);
+        d.vib_peak[i]=(uint16_t) (65535-i);
+        d.vib_crest[i]=(uint16_t) (256*(i+2)+64);
+    }
+    d.sound_leq=-4210;
+    d.sound_lmax=-1500;
+    d.sound_peak=-70000;	// saturates to -32768
+    d.rssi=-67;
+    d.tx_sent=77;
+    d.tx_suppressed=4000000000u;
+    for(int i=0; i<SCHED_CHANNELS; ++i) {
+        d.sched_rate[i]=(uint16_t) (2000/(i+1));
+        d.sched_misses[i]=(uint32_t) i;
+    }
+
+    memset(&net, 0, sizeof(net));
+    net.requests=40;
+    net.connections=3;
+    net.latency_sum_us=40*12340;
+    net.latency_max_us=98760;
+
+    n=sensor_frame_encode(&d, &net, buf, sizeof(buf));
+    check(n==FRAME_HEADER_SIZE+SENSOR_V1_PAYLOAD, "first frame length");
+    check(buf[0]==FRAME_VERSION && buf[1]==FRAME_SENSOR, "header version and type");
+    check(buf[2]+(buf[3]<<8)==SENSOR_V1_PAYLOAD, "header payload length");
+    len+=n;
+
+    // second sample: no request answered yet, the latency must stay 0
+    memset(&d, 0, sizeof(d));
+    d.sound_leq=40000;	// saturates to 32767
+    memset(&net, 0, sizeof(net));
+    n=sensor_frame_encode(&d, &net, buf+len, sizeof(buf)-len);
+    check(n==FRAME_HEADER_SIZE+SENSOR_V1_PAYLOAD, "second frame length");
+    len+=n;
+
+    uint8_t small[SENSOR_V1_PAYLOAD];
+    check(sensor_frame_encode(&d, &net, small, sizeof(small))==0, "frame too big for the buffer");
+
+    FILE *out=fopen(argv[1], "wb");
+    if(out==NULL || fwrite(buf, 1, len, out)!=len) {
+        printf("FAIL: write %s\n", argv[1]);
+        ++failures;
+    }
+    if(out)
+        fclose(out);
+
+    printf("%u bytes in 2 frames\n", (unsigned) len);
+    printf("%s\n", failures?"FAILED":"OK");
+    return failures?1:0;
+}
@@ -0,0 +1,244 @@
+/**
+* @file http_main.c
+*
+* host harness for http_conn.c: a small in-process HTTP server with
+* misbehaving modes (close after n requests, idle close, reset before the
+* response, HTTP/1.0 without Content-Length) and checks that every POST is
+* answered, in order, over as few connections as the server allows
+*
+* usage: http_test [requests]
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/sockets.h"
+#include "http_conn.h"
+
+typedef enum {
+    SERVER_KEEP_ALIVE,	/**< HTTP/1.1, keeps every connection */
+    SERVER_CLOSE_EVERY,	/**< Connection: close after every close_every requests */
+    SERVER_IDLE_CLOSE,	/**< drops the connection after each response burst */
+    SERVER_RESET_ONCE,	/**< reads one request and closes without answering */
+    SERVER_HTTP10		/**< HTTP/1.0, body delimited by the close */
+} server_mode_t;
+
+static struct {
+    int listener;
+    uint16_t port;
+    volatile server_mode_t mode;
+    volatile int close_every;
+    volatile int reset_pending;
+    volatile int accepted;
+    volatile int handled;
+} server;
+
+static uint32_t requests=40;
+static int failures=0;
+
+static void check(bool ok, const char *what) {
+    if(!ok) {
+        printf("FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+// one request: headers, then Content-Length bytes of body
+static int server_read_request(int fd, char *buf, size_t size, size_t *have, char *body, size_t body_size) {
+    char *end;
+    buf[*have]='\0';
+    while((end=strstr(buf, "\r\n\r\n"))==NULL) {
+        int got=recv(fd, buf+*have, size-1-*have, 0);
+        if(got<=0)
+            return -1;
+        *have+=got;
+        buf[*have]='\0';
+    }
+    char *cl=strcasestr(buf, "Content-Length:");
+    size_t len=cl && cl<end?strtoul(cl+15, NULL, 10):0;
+    size_t head=end+4-buf;
+    while(*have<head+len) {
+        int got=recv(fd, buf+*have, size-1-*have, 0);
+        if(got<=0)
+            return -1;
+        *have+=got;
+    }
+    size_t n=len<body_size-1?len:body_size-1;
+    memcpy(body, buf+head, n);
+    body[n]='\0';
+    memmove(buf, buf+head+len, *have-head-len);
+    *have-=head+len;
+    return (int) len;
+}
+
+static void *server_connection(void *arg) {
+    int fd=(int) (intptr_t) arg;
+    char buf[4096], body[1024], resp[1200];
+    size_t have=0;
+    int count=0, len;
+
+    while((len=server_read_request(fd, buf, sizeof(buf), &have, body, sizeof(body)))>=0) {
+        ++count;
+        if(server.mode==SERVER_RESET_ONCE && server.reset_pending) {
+            server.reset_pending=0;
+            break;
+        }
+        ++server.handled;
+        // echo the body so the client can match replies to requests
+        char reply[1100];
+        int rlen=len<(int) sizeof(body)?snprintf(reply, sizeof(reply), "{\"echo\":%s}", body)
+            :snprintf(reply, sizeof(reply), "{\"len\":%d}", len);
+        bool last=server.mode==SERVER_CLOSE_EVERY && count%server.close_every==0;
+        int n;
+        if(server.mode==SERVER_HTTP10) {
+            n=snprintf(resp, sizeof(resp), "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n\r\n%s", reply);
+            send(fd, resp, n, 0);
+            break;
+        }
+        n=snprintf(resp, sizeof(resp), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                   "Content-Length: %d\r\n%s\r\n%s", rlen, last?"Connection: close\r\n":"", reply);
+        send(fd, resp, n, 0);
+        if(last)
+            break;
+        if(server.mode==SERVER_IDLE_CLOSE && have==0) {
+            // nothing pipelined behind it: the keep-alive timer runs out
+            usleep(20000);
+            if(recv(fd, buf, sizeof(buf)-1, MSG_PEEK|MSG_DONTWAIT)<=0)
+                break;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *server_main(void *arg) {
+    (void) arg;
+    while(1) {
+        int fd=accept(server.listener, NULL, NULL);
+        if(fd<0)
+            return NULL;
+        ++server.accepted;
+        pthread_t t;
+        pthread_create(&t, NULL, server_connection, (void *) (intptr_t) fd);
+        pthread_detach(t);
+    }
+}
+
+static void server_start(void) {
+    struct sockaddr_in addr= {.sin_family=AF_INET, .sin_addr.s_addr=htonl(INADDR_LOOPBACK)};
+    socklen_t len=sizeof(addr);
+    int one=1;
+
+    server.listener=socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(server.listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    bind(server.listener, (struct sockaddr *) &addr, sizeof(addr));
+    listen(server.listener, 8);
+    getsockname(server.listener, (struct sockaddr *) &addr, &len);
+    server.port=ntohs(addr.sin_port);
+
+    pthread_t t;
+    pthread_create(&t, NULL, server_main, NULL);
+    pthread_detach(t);
+}
+
+// n posts one after the other, each reply must echo its own body
+static void run_posts(http_conn_t *c, const char *name, uint32_t n) {
+    char body[64], reply[256], want[96];
+    uint32_t ok=0;
+
+    for(uint32_t i=0; i<n; ++i) {
+        int len=snprintf(body, sizeof(body), "{\"seq\":%u}", i);
+        snprintf(want, sizeof(want), "{\"echo\":%s}", body);
+        if(http_conn_post(c, "/submit_data", "application/json", body, len, reply, sizeof(reply))==200
+            && !strcmp(reply, want))
+            ++ok;
+        if(server.mode==SERVER_IDLE_CLOSE)
+            usleep(40000);
+    }
+    printf("%-12s %3u/%u ok, %2u connections, %5.2f req/conn, %u server closes, %u errors, %u retries, "
+           "latency avg %llu us\n", name, ok, n, c->connections, http_conn_rpc_centi(c)/100.0,
+           c->server_closes, c->errors, c->retries,
+           (unsigned long long) (c->requests?c->latency_sum_us/c->requests:0));
+    check(ok==n, name);
+}
+
+static http_conn_t *fresh(http_conn_t *c) {
+    http_conn_close(c);
+    http_conn_init(c, "127.0.0.1", server.port, 1000);
+    return c;
+}
+
+int main(int argc, char **argv) {
+    static http_conn_t conn;
+    http_conn_t *c;
+
+    if(argc>1)
+        requests=strtoul(argv[1], NULL, 0);
+    server_start();
+    http_conn_init(&conn, "127.0.0.1", server.port, 1000);
+
+    server.mode=SERVER_KEEP_ALIVE;
+    run_posts(c=fresh(&conn), "keep-alive", requests);
+    check(c->connections==1, "keep-alive uses one connection");
+
+    // pipelined: HTTP_CONN_PIPELINE requests out before any response
+    char body[HTTP_CONN_PIPELINE][32], reply[128], want[160];
+    uint32_t in_order=0;
+    for(uint32_t round=0; round<requests/HTTP_CONN_PIPELINE; ++round) {
+        for(int i=0; i<HTTP_CONN_PIPELINE; ++i) {
+            int len=snprintf(body[i], sizeof(body[i]), "{\"seq\":%u}", round*HTTP_CONN_PIPELINE+i);
+            check(http_conn_send(c, "/submit_data", "application/json", body[i], len), "pipelined send");
+        }
+        check(!http_conn_send(c, "/x", "text/plain", "x", 1), "pipeline limit");
+        for(int i=0; i<HTTP_CONN_PIPELINE; ++i) {
+            snprintf(want, sizeof(want), "{\"echo\":%s}", body[i]);
+            if(http_conn_recv(c, reply, sizeof(reply))==200 && !strcmp(reply, want))
+                ++in_order;
+        }
+    }
+    printf("pipelined    %3u/%u in order over %u connection(s)\n", in_order,
+           requests/HTTP_CONN_PIPELINE*HTTP_CONN_PIPELINE, c->connections);
+    check(in_order==requests/HTTP_CONN_PIPELINE*HTTP_CONN_PIPELINE && c->connections==1, "pipelined");
+
+    server.mode=SERVER_CLOSE_EVERY;
+    server.close_every=5;
+    run_posts(c=fresh(&conn), "close/5", requests);
+    check(c->connections==(requests+4)/5, "Connection: close honoured");
+    check(c->errors==0, "Connection: close is not an error");
+
+    server.mode=SERVER_IDLE_CLOSE;
+    run_posts(c=fresh(&conn), "idle close", requests/4);
+    check(c->errors==0 && c->retries==0, "idle close found before sending");
+
+    server.mode=SERVER_RESET_ONCE;
+    run_posts(c=fresh(&conn), "warm-up", 2);
+    server.reset_pending=1;
+    run_posts(c, "reset", 3);
+    check(c->retries==1, "reset retried once");
+
+    server.mode=SERVER_HTTP10;
+    run_posts(c=fresh(&conn), "HTTP/1.0", 5);
+    check(c->connections==5, "HTTP/1.0 one request per connection");
+
+    // a short reply buffer truncates, the connection stays in sync
+    server.mode=SERVER_KEEP_ALIVE;
+    c=fresh(&conn);
+    char small[8];
+    check(http_conn_post(c, "/", "application/json", "{\"seq\":1}", 9, small, sizeof(small))==200
+          && !strcmp(small, "{\"echo\""), "truncated reply");
+    run_posts(c, "after trunc", 3);
+    check(c->connections==1, "truncated reply keeps the connection");
+
+    // a body larger than the request buffer goes out after the headers
+    static char big[3000];
+    memset(big, 'x', sizeof(big));
+    check(http_conn_post(c, "/", "text/plain", big, sizeof(big), small, sizeof(small))==200
+          && !strncmp(small, "{\"len\":", 7), "large body");
+    run_posts(c, "after large", 3);
+    check(c->connections==1, "large body keeps the connection");
+
+    printf("\n%s\n", failures?"FAILED":"OK");
+    return failures?1:0;
+}
@@ -0,0 +1,22 @@
+/**
+* @file flash.h
+*
+* host stand-in: flash is an array the harness owns, mapped at XIP_BASE
+*/
+
+#ifndef _inc_host_hardware_flash
+#define _inc_host_hardware_flash
+
+#include <pico/stdlib.h>
+
+#define FLASH_PAGE_SIZE 256u
+#define FLASH_SECTOR_SIZE 4096u
+#define PICO_FLASH_SIZE_BYTES (16u*FLASH_SECTOR_SIZE)
+
+extern uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t) host_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+#endif
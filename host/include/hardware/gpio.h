@@ -0,0 +1,29 @@
+/**
+* @file gpio.h
+*
+* host stand-in for the pin setup calls. gpio_set_function is left to the
+* harness that needs to know which pins a bus was attached to
+*/
+
+#ifndef _inc_host_hardware_gpio
+#define _inc_host_hardware_gpio
+
+#include <pico/stdlib.h>
+
+#define GPIO_FUNC_I2C 3
+
+void gpio_set_function(uint gpio, uint fn);
+
+static inline void gpio_pull_up(uint gpio) {
+    (void) gpio;
+}
+
+static inline void gpio_init(uint gpio) {
+    (void) gpio;
+}
+
+static inline void gpio_disable_pulls(uint gpio) {
+    (void) gpio;
+}
+
+#endif
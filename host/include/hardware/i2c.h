@@ -0,0 +1,25 @@
+/**
+* @file i2c.h
+*
+* host stand-in: there is no i2c block, displays run on the simulator
+* transport. The calls below are only declared; a harness that needs them
+* (topology_test) provides a simulated bus
+*/
+
+#ifndef _inc_host_hardware_i2c
+#define _inc_host_hardware_i2c
+
+#include <pico/stdlib.h>
+
+typedef struct i2c_inst i2c_inst_t;
+
+extern i2c_inst_t *const host_i2c0, *const host_i2c1;
+#define i2c0 host_i2c0
+#define i2c1 host_i2c1
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us);
+
+#endif
@@ -0,0 +1,20 @@
+/**
+* @file sync.h
+*
+* host stand-in: no interrupts to mask
+*/
+
+#ifndef _inc_host_hardware_sync
+#define _inc_host_hardware_sync
+
+#include <pico/stdlib.h>
+
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void) status;
+}
+
+#endif
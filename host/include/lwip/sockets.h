@@ -0,0 +1,20 @@
+/**
+* @file sockets.h
+*
+* host stand-in for lwip/sockets.h: the BSD socket calls lwip mirrors
+*/
+
+#ifndef _inc_host_lwip_sockets
+#define _inc_host_lwip_sockets
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define lwip_close close
+
+#endif
@@ -0,0 +1,9 @@
+/**
+* @file binary_info.h
+*
+* host stand-in, binary info is a firmware-only feature
+*/
+
+#ifndef _inc_host_pico_binary_info
+#define _inc_host_pico_binary_info
+#endif
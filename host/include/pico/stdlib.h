@@ -0,0 +1,25 @@
+/**
+* @file stdlib.h
+*
+* host stand-in for the parts of pico/stdlib.h the display driver uses
+*/
+
+#ifndef _inc_host_pico_stdlib
+#define _inc_host_pico_stdlib
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef unsigned int uint;
+
+static inline uint32_t time_us_32(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) (ts.tv_sec*1000000ull+ts.tv_nsec/1000);
+}
+
+static inline void tight_loop_contents(void) {}
+
+#endif
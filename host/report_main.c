@@ -0,0 +1,77 @@
+/**
+* @file report_main.c
+*
+* host harness for report_filter.c: feeds value sequences through a filter
+* and checks which records go out and why
+*
+* usage: report_test
+*/
+
+#include <stdio.h>
+
+#include "report_filter.h"
+
+static int failures;
+
+static void check(bool ok, const char *what) {
+    if(!ok) {
+        printf("FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+// one record per step, channel 0 gets v0, channel 1 stays at 0
+static report_reason_t step(report_filter_t *f, int32_t v0, uint32_t now_ms) {
+    int32_t values[2]= {v0, 0};
+    return report_filter_check(f, values, now_ms);
+}
+
+int main(void) {
+    report_filter_t f;
+
+    // deadband 10, hysteresis 5 on channel 0, no heartbeat
+    check(report_filter_init(&f, 2, 0), "init");
+    report_filter_set(&f, 0, 10, 5);
+
+    check(step(&f, 100, 0)==REPORT_FIRST, "first record goes out");
+    check(step(&f, 109, 1)==REPORT_SUPPRESSED, "inside the deadband");
+    check(step(&f, 91, 2)==REPORT_SUPPRESSED, "inside the deadband, below");
+    check(step(&f, 110, 3)==REPORT_CHANGE, "deadband reached");
+    check(f.dir[0]==1, "rising change recorded");
+    check(step(&f, 120, 4)==REPORT_CHANGE, "same direction needs the deadband only");
+
+    // reversing needs deadband + hysteresis
+    check(step(&f, 106, 5)==REPORT_SUPPRESSED, "reversal below deadband + hysteresis");
+    check(step(&f, 105, 6)==REPORT_CHANGE, "reversal at deadband + hysteresis");
+    check(f.dir[0]==-1, "falling change recorded");
+    check(step(&f, 95, 7)==REPORT_CHANGE, "falling again needs the deadband only");
+
+    // a report caused by another channel moves the reference of channel 0 by
+    // a sub-deadband amount: that noise must not arm the hysteresis
+    report_filter_set(&f, 1, 1, 0);
+    int32_t noisy[2]= {98, 1};
+    check(report_filter_check(&f, noisy, 8)==REPORT_CHANGE, "other channel reports");
+    check(f.dir[0]==-1, "sub-deadband noise keeps the direction");
+    check(f.dir[1]==1, "crossing channel records its direction");
+    int32_t down[2]= {88, 1};
+    check(report_filter_check(&f, down, 9)==REPORT_CHANGE, "falling on after the noise needs the deadband only");
+    check(f.crossings[0]==5 && f.crossings[1]==1, "crossings per channel");
+
+    // heartbeat
+    check(report_filter_init(&f, 2, 1000), "init with heartbeat");
+    report_filter_set(&f, 0, 10, 5);
+    check(step(&f, 0, 5000)==REPORT_FIRST, "first record with heartbeat");
+    check(step(&f, 3, 5999)==REPORT_SUPPRESSED, "silence shorter than the heartbeat");
+    check(step(&f, 3, 6000)==REPORT_HEARTBEAT, "heartbeat after the silence");
+    check(f.dir[0]==0, "heartbeat does not set a direction");
+    check(step(&f, -7, 6001)==REPORT_CHANGE, "no hysteresis after a heartbeat");
+    check(step(&f, 0, 6002)==REPORT_SUPPRESSED, "reversal after the heartbeat needs the hysteresis");
+    report_filter_force(&f);
+    check(step(&f, 0, 6003)==REPORT_FIRST, "forced record");
+    check(f.dir[0]==0, "first record resets the direction");
+    check(f.sent==4 && f.heartbeats==1 && f.suppressed==2, "statistics");
+
+    printf("sent %u, suppressed %u, heartbeats %u\n", f.sent, f.suppressed, f.heartbeats);
+    printf("%s\n", failures?"FAILED":"OK");
+    return failures?1:0;
+}
@@ -0,0 +1,148 @@
+/**
+* @file sched_main.c
+*
+* host harness for sensor_sched.c: runs the firmware's channel table on a
+* simulated clock, with reads that take time and an interrupt-driven channel,
+* and checks rates, conversion lead times, bus turns and miss accounting
+*
+* usage: sched_sim [seconds]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sensor_sched.h"
+
+static uint32_t seconds=60;
+static int failures=0;
+
+// simulated time, advanced by the work the channels do
+static uint32_t now;
+
+typedef struct {
+    uint32_t cost_ms;		/**< time a read takes */
+    uint32_t started_ms;	/**< last start */
+    uint32_t lead_min_ms;	/**< shortest start to read */
+    uint32_t last_read_ms;
+    uint32_t stall_at_ms, stall_ms;	/**< one read that takes much longer */
+} sim_source_t;
+
+static bool sim_start(void *arg) {
+    sim_source_t *src=arg;
+    src->started_ms=now;
+    now+=1;
+    return true;
+}
+
+static bool sim_read(void *arg) {
+    sim_source_t *src=arg;
+    if(src->started_ms) {
+        uint32_t lead=now-src->started_ms;
+        if(lead<src->lead_min_ms)
+            src->lead_min_ms=lead;
+    }
+    src->last_read_ms=now;
+    now+=src->cost_ms;
+    if(src->stall_ms && now>=src->stall_at_ms) {
+        now+=src->stall_ms;
+        src->stall_ms=0;
+    }
+    return true;
+}
+
+enum { CH_MPU, CH_LIGHT, CH_SOUND, CH_RSSI, CH_REPORT, CH_COUNT };
+
+static sim_source_t src[CH_COUNT]= {
+    [CH_MPU]={.cost_ms=3, .lead_min_ms=UINT32_MAX},
+    [CH_LIGHT]={.cost_ms=1, .lead_min_ms=UINT32_MAX},
+    [CH_SOUND]={.cost_ms=0, .lead_min_ms=UINT32_MAX},
+    [CH_RSSI]={.cost_ms=2, .lead_min_ms=UINT32_MAX},
+    [CH_REPORT]={.cost_ms=12, .lead_min_ms=UINT32_MAX},
+};
+
+// same shape as the firmware table in main.c
+static const sensor_sched_channel_t table[CH_COUNT]= {
+    [CH_MPU]={"mpu", 50, 0, 0, 0, true, NULL, sim_read, &src[CH_MPU]},
+    [CH_LIGHT]={"bh1750", 500, 180, 0, 0, false, sim_start, sim_read, &src[CH_LIGHT]},
+    [CH_SOUND]={"sound", 2000, 0, 2000, SENSOR_SCHED_NO_BUS, false, NULL, sim_read, &src[CH_SOUND]},
+    [CH_RSSI]={"rssi", 10000, 0, 0, 1, false, NULL, sim_read, &src[CH_RSSI]},
+    [CH_REPORT]={"report", 2000, 0, 2000, SENSOR_SCHED_NO_BUS, false, NULL, sim_read, &src[CH_REPORT]},
+};
+
+static void check(bool ok, const char *what) {
+    if(!ok) {
+        printf("FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+// the simulated task loop: wait for the next action or the 50 ms data-ready
+// interrupt, whichever comes first
+static void simulate(sensor_sched_t *s, uint32_t until_ms, bool irq) {
+    uint32_t next_irq=now+50;
+
+    while(now<until_ms) {
+        uint32_t wait=sensor_sched_run(s, now);
+        if(irq && now+wait>=next_irq) {
+            now=now>next_irq?now:next_irq;
+            next_irq+=50;
+            sensor_sched_release(s, CH_MPU, now);
+        } else {
+            now+=wait;
+        }
+    }
+}
+
+static void print_stats(const sensor_sched_t *s) {
+    printf("%-8s %8s %8s %6s %6s %8s\n", "channel", "reads", "rate Hz", "misses", "errors", "late max");
+    for(size_t i=0; i<s->count; ++i)
+        printf("%-8s %8u %8.2f %6u %6u %6u ms\n", table[i].name, s->st[i].reads,
+               sensor_sched_rate_chz(s, i, now)/100.0, s->st[i].misses, s->st[i].errors,
+               s->st[i].late_max_ms);
+}
+
+int main(int argc, char **argv) {
+    sensor_sched_t s;
+
+    if(argc>1)
+        seconds=strtoul(argv[1], NULL, 0);
+
+    now=1000;
+    check(sensor_sched_init(&s, table, CH_COUNT, now), "init");
+    simulate(&s, now+seconds*1000, true);
+    printf("steady state, %u s:\n", seconds);
+    print_stats(&s);
+
+    // count the periods from each channel's first due time, not from init: the
+    // offset channels would otherwise look slow on short runs
+    for(size_t i=0; i<CH_COUNT; ++i) {
+        uint32_t run=seconds*1000, span=run>table[i].offset_ms?run-table[i].offset_ms:0;
+        uint32_t expect=span/table[i].period_ms, reads=s.st[i].window_reads;
+        check(reads+expect/20>=expect && reads<=expect+1, table[i].name);
+        check(s.st[i].misses==0, "no misses in steady state");
+    }
+    check(src[CH_LIGHT].lead_min_ms>=180, "bh1750 read before its conversion time");
+
+    // a report that blocks for 700 ms: the mpu falls back, light periods go by
+    sensor_sched_stats_reset(&s, now);
+    src[CH_REPORT].stall_at_ms=now+3000;
+    src[CH_REPORT].stall_ms=700;
+    simulate(&s, now+10000, true);
+    printf("\nwith one 700 ms stall:\n");
+    print_stats(&s);
+    check(s.st[CH_LIGHT].misses>0, "stall counted as light misses");
+    check(s.st[CH_LIGHT].late_max_ms>=250, "stall shows as lateness");
+
+    // data-ready interrupt lost: mpu runs from its fallback every 100 ms
+    uint32_t before=s.st[CH_MPU].misses;
+    sensor_sched_stats_reset(&s, now);
+    simulate(&s, now+5000, false);
+    printf("\nwithout the mpu interrupt:\n");
+    print_stats(&s);
+    check(s.st[CH_MPU].misses-before>=45, "mpu fallback counted as misses");
+    uint32_t mpu_rate=sensor_sched_rate_chz(&s, CH_MPU, now);
+    check(mpu_rate>=950 && mpu_rate<=1050, "mpu fallback at half rate");
+
+    printf("\n%s\n", failures?"FAILED":"OK");
+    return failures?1:0;
+}
@@ -0,0 +1,478 @@
+/**
+* @file sim_main.c
+*
+* host harness for the ssd1306 driver: renders the firmware screens through
+* the panel simulator, writes snapshots and times every drawing primitive
+*
+* usage: ssd1306_sim [output dir] [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ssd1306.h"
+#include "ssd1306_sim.h"
+#include "oled_ui.h"
+#include "img_wifi.h"
+#include "fonts.h"
+
+extern const uint8_t font_8x5[];
+
+static const char *out_dir=".";
+static uint32_t iterations=2000;
+static int failures=0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ull+ts.tv_nsec;
+}
+
+// keeps the optimizer from dropping the reference loops
+static volatile uint8_t sink;
+
+static void snapshot(ssd1306_sim_t *sim, const char *name) {
+    char path[512];
+
+    snprintf(path, sizeof(path), "%s/%s.png", out_dir, name);
+    if(!ssd1306_sim_write_png(sim, path, 4)) {
+        printf("cannot write %s\n", path);
+        ++failures;
+    }
+    snprintf(path, sizeof(path), "%s/%s.pgm", out_dir, name);
+    if(!ssd1306_sim_write_pgm(sim, path, 1)) {
+        printf("cannot write %s\n", path);
+        ++failures;
+    }
+}
+
+// the panel must show exactly what is in the framebuffer after a show
+static void check_panel(ssd1306_t *p, ssd1306_sim_t *sim, const char *name) {
+    for(uint32_t y=0; y<p->height; ++y)
+        for(uint32_t x=0; x<p->width; ++x) {
+            bool want=(p->buffer[(y>>3)*p->width+x]>>(y&7))&1;
+            if(ssd1306_sim_pixel(sim, x, y)!=want) {
+                printf("%s: panel differs from framebuffer at %u,%u\n", name, x, y);
+                ++failures;
+                return;
+            }
+        }
+}
+
+static void show(ssd1306_t *p, ssd1306_sim_t *sim, const char *name) {
+    uint32_t tr=p->transport->transactions, by=p->transport->bytes;
+
+    ssd1306_show(p);
+    check_panel(p, sim, name);
+    snapshot(sim, name);
+    printf("%-16s %4u transactions %6u bytes %5u skipped\n", name,
+           p->transport->transactions-tr, p->transport->bytes-by, p->skipped_bytes);
+}
+
+static void scenarios(ssd1306_t *p, ssd1306_sim_t *sim) {
+    printf("\n-- frames --\n");
+    show(p, sim, "blank");
+
+    ssd1306_clear(p);
+    ssd1306_draw_string(p, 0, 0, 1, "FreeRTOS Mode");
+    ssd1306_draw_string(p, 0, 16, 1, "Init WiFi...");
+    show(p, sim, "boot");
+
+    ssd1306_clear(p);
+    ssd1306_draw_string(p, 0, 0, 1, "WiFi: BitDogLab");
+    ssd1306_draw_string(p, 0, 16, 1, "IP:192.168.0.42");
+    ssd1306_draw_string(p, 0, 32, 1, "Lux:312 T:27.4C");
+    ssd1306_draw_string(p, 0, 48, 1, "RSSI:-61 Up:120s");
+    ssd1306_blit_native(p, 112, 0, &img_wifi);
+    show(p, sim, "status");
+
+    // a typical update: only the sensor line changes
+    ssd1306_clear_square(p, 0, 32, 128, 8);
+    ssd1306_draw_string(p, 0, 32, 1, "Lux:315 T:27.5C");
+    show(p, sim, "status_update");
+
+    // identical frame, everything should be skipped
+    show(p, sim, "status_same");
+
+    ssd1306_clear(p);
+    ssd1306_draw_empty_square(p, 0, 0, 127, 63);
+    ssd1306_draw_line(p, 0, 0, 127, 63);
+    ssd1306_draw_line(p, 0, 63, 127, 0);
+    ssd1306_draw_square(p, 40, 20, 48, 24);
+    ssd1306_clear_square(p, 50, 27, 28, 10);
+    ssd1306_draw_string(p, 4, 4, 2, "42");
+    ssd1306_draw_string(p, 70, 44, 3, "C");
+    show(p, sim, "shapes");
+
+    ssd1306_invert(p, 1);
+    snapshot(sim, "shapes_inverted");
+    ssd1306_invert(p, 0);
+}
+
+// status screen refresh as main.c does it: clear and redraw vs retained widgets
+static void ui_status(uint32_t i, char *s3, char *s4) {
+    snprintf(s3, 32, "Lux:%u T:%u.%uC", 300+i%17, 27, i%10);
+    snprintf(s4, 32, "RSSI:-%u Up:%us", 55+i%7, 120+2*i);
+}
+
+static void ui_scenario(ssd1306_t *p, ssd1306_sim_t *sim) {
+    char s3[32], s4[32];
+    uint32_t frames=50;
+
+    printf("\n-- status refresh, %u frames --\n", frames);
+
+    ssd1306_clear(p);
+    ssd1306_show(p);
+    uint32_t by=p->transport->bytes;
+    uint64_t t0=now_ns(), draw_ns=0;
+    for(uint32_t i=0; i<frames; ++i) {
+        ui_status(i, s3, s4);
+        uint64_t d0=now_ns();
+        ssd1306_clear(p);
+        ssd1306_draw_string(p, 0, 0, 1, "WiFi: @idarlan");
+        ssd1306_draw_string(p, 0, 16, 1, "IP:192.168.1.42");
+        ssd1306_draw_string(p, 0, 32, 1, s3);
+        ssd1306_draw_string(p, 0, 48, 1, s4);
+        ssd1306_blit_native(p, 112, 0, &img_wifi);
+        draw_ns+=now_ns()-d0;
+        ssd1306_show(p);
+    }
+    printf("clear and redraw  %8.1f ns draw %8.1f ns total %6.1f bytes/frame\n",
+           (double) draw_ns/frames, (double) (now_ns()-t0)/frames, (double) (p->transport->bytes-by)/frames);
+    snapshot(sim, "ui_redraw");
+
+    oled_ui_t ui;
+    oled_widget_t widgets[5];
+    oled_ui_init(&ui, p, widgets, 5);
+    oled_widget_t *l0=oled_ui_add_text(&ui, OLED_UI_LABEL, 0, 0, 1, NULL);
+    oled_widget_t *l1=oled_ui_add_text(&ui, OLED_UI_LABEL, 0, 16, 1, NULL);
+    oled_widget_t *l2=oled_ui_add_text(&ui, OLED_UI_VALUE, 0, 32, 1, NULL);
+    oled_widget_t *l3=oled_ui_add_text(&ui, OLED_UI_VALUE, 0, 48, 1, NULL);
+    oled_ui_add_icon(&ui, 112, 0, &img_wifi);
+
+    ssd1306_clear(p);
+    ssd1306_show(p);
+    by=p->transport->bytes;
+    t0=now_ns();
+    draw_ns=0;
+    for(uint32_t i=0; i<frames; ++i) {
+        ui_status(i, s3, s4);
+        uint64_t d0=now_ns();
+        oled_ui_set_text(l0, "WiFi: @idarlan");
+        oled_ui_set_text(l1, "IP:192.168.1.42");
+        oled_ui_set_text(l2, s3);
+        oled_ui_set_text(l3, s4);
+        oled_ui_render(&ui);
+        draw_ns+=now_ns()-d0;
+        ssd1306_show(p);
+    }
+    printf("retained widgets  %8.1f ns draw %8.1f ns total %6.1f bytes/frame, %.2f widgets/frame\n",
+           (double) draw_ns/frames, (double) (now_ns()-t0)/frames, (double) (p->transport->bytes-by)/frames,
+           (double) ui.redrawn_total/ui.frames);
+    check_panel(p, sim, "ui_widgets");
+    snapshot(sim, "ui_widgets");
+
+    // both paths must end on the same picture
+    uint8_t *widget_fb=malloc(p->bufsize);
+    memcpy(widget_fb, p->buffer, p->bufsize);
+    ssd1306_clear(p);
+    ssd1306_draw_string(p, 0, 0, 1, "WiFi: @idarlan");
+    ssd1306_draw_string(p, 0, 16, 1, "IP:192.168.1.42");
+    ssd1306_draw_string(p, 0, 32, 1, s3);
+    ssd1306_draw_string(p, 0, 48, 1, s4);
+    ssd1306_blit_native(p, 112, 0, &img_wifi);
+    if(memcmp(widget_fb, p->buffer, p->bufsize)) {
+        printf("retained widgets differ from clear and redraw\n");
+        ++failures;
+    }
+    free(widget_fb);
+    ssd1306_clear(p);
+}
+
+// console mode: each append must cost one page, the glass must show the
+// last lines in order
+static void console_scenario(ssd1306_t *p, ssd1306_sim_t *sim) {
+    char lines[20][24];
+    ssd1306_t ref={0};
+    ssd1306_mock_transport_t mock;
+
+    printf("\n-- console --\n");
+    ssd1306_mock_transport_init(&mock, NULL, 0);
+    ssd1306_init_with_transport(&ref, p->width, p->height, 0x3C, &mock.base);
+
+    ssd1306_console(p, true);
+    ssd1306_show(p);
+    uint32_t by=p->transport->bytes, tr=p->transport->transactions;
+    for(uint32_t n=0; n<20; ++n) {
+        snprintf(lines[n], sizeof(lines[n]), "[%2u] Try %u/3...", n, n%3+1);
+        ssd1306_console_print(p, lines[n]);
+        ssd1306_show(p);
+
+        ssd1306_clear(&ref);
+        uint32_t first=n+1>ref.pages?n+1-ref.pages:0;
+        for(uint32_t i=first; i<=n; ++i)
+            ssd1306_draw_string(&ref, 0, (i-first)*8, 1, lines[i]);
+        check_panel(&ref, sim, lines[n]);
+    }
+    printf("%-16s %6.1f transactions %6.1f bytes per line\n", "console",
+           (p->transport->transactions-tr)/20.0, (p->transport->bytes-by)/20.0);
+    snapshot(sim, "console");
+
+    ssd1306_console(p, false);
+    ssd1306_show(p);
+    check_panel(p, sim, "console off");
+    ssd1306_deinit(&ref);
+}
+
+// reference implementations the driver used before the page-byte fast paths
+
+static void ref_fill(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    for(uint32_t i=0; i<w; ++i)
+        for(uint32_t j=0; j<h; ++j)
+            ssd1306_draw_pixel(p, x+i, y+j);
+}
+
+static void ref_draw_char(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, char c) {
+    if(c<font[3] || c>font[4])
+        return;
+
+    uint32_t parts_per_line=(font[0]>>3)+((font[0]&7)>0);
+    for(uint8_t w=0; w<font[1]; ++w) {
+        uint32_t pp=(c-font[3])*font[1]*parts_per_line+w*parts_per_line+5;
+        for(uint32_t lp=0; lp<parts_per_line; ++lp) {
+            uint8_t line=font[pp];
+            for(int8_t j=0; j<8; ++j, line>>=1)
+                if(line&1)
+                    ref_fill(p, x+w*scale, y+((lp<<3)+j)*scale, scale, scale);
+            ++pp;
+        }
+    }
+}
+
+static void ref_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const char *s) {
+    for(int32_t x_n=x; *s; x_n+=(font_8x5[1]+font_8x5[2])*scale)
+        ref_draw_char(p, x_n, y, scale, font_8x5, *(s++));
+}
+
+static void ref_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    if(x1>x2) {
+        int32_t t=x1; x1=x2; x2=t;
+        t=y1; y1=y2; y2=t;
+    }
+
+    if(x1==x2) {
+        if(y1>y2) {
+            int32_t t=y1; y1=y2; y2=t;
+        }
+        for(int32_t i=y1; i<=y2; ++i)
+            ssd1306_draw_pixel(p, x1, i);
+        return;
+    }
+
+    float m=(float) (y2-y1)/(float) (x2-x1);
+    for(int32_t i=x1; i<=x2; ++i) {
+        float y=m*(float) (i-x1)+(float) y1;
+        ssd1306_draw_pixel(p, i, (uint32_t) y);
+    }
+}
+
+typedef void (*bench_fn)(ssd1306_t *p, uint32_t i);
+
+static double bench(ssd1306_t *p, const char *name, bench_fn fn) {
+    // warm caches (glyph cache included) before timing
+    fn(p, 0);
+
+    uint64_t t0=now_ns();
+    for(uint32_t i=0; i<iterations; ++i)
+        fn(p, i);
+    double ns=(double) (now_ns()-t0)/iterations;
+
+    sink=p->buffer[0];
+    printf("%-34s %10.1f ns/call\n", name, ns);
+    return ns;
+}
+
+static void b_clear(ssd1306_t *p, uint32_t i) { (void) i; ssd1306_clear(p); }
+static void b_pixel(ssd1306_t *p, uint32_t i) { ssd1306_draw_pixel(p, i&127, (i>>7)&63); }
+static void b_clear_pixel(ssd1306_t *p, uint32_t i) { ssd1306_clear_pixel(p, i&127, (i>>7)&63); }
+static void b_line_h(ssd1306_t *p, uint32_t i) { ssd1306_draw_line(p, 0, i&63, 127, i&63); }
+static void b_line_v(ssd1306_t *p, uint32_t i) { ssd1306_draw_line(p, i&127, 0, i&127, 63); }
+static void b_line_d(ssd1306_t *p, uint32_t i) { ssd1306_draw_line(p, 0, 0, 127, i&63); }
+static void b_ref_line_d(ssd1306_t *p, uint32_t i) { ref_draw_line(p, 0, 0, 127, i&63); }
+static void b_square(ssd1306_t *p, uint32_t i) { ssd1306_draw_square(p, i&31, i&7, 64, 40); }
+static void b_ref_square(ssd1306_t *p, uint32_t i) { ref_fill(p, i&31, i&7, 64, 40); }
+static void b_clear_square(ssd1306_t *p, uint32_t i) { ssd1306_clear_square(p, i&31, i&7, 64, 40); }
+static void b_empty_square(ssd1306_t *p, uint32_t i) { ssd1306_draw_empty_square(p, i&31, i&7, 64, 40); }
+static void b_char(ssd1306_t *p, uint32_t i) { ssd1306_draw_char(p, 0, 0, 1, 'A'+(i%26)); }
+static void b_string1(ssd1306_t *p, uint32_t i) { (void) i; ssd1306_draw_string(p, 0, 3, 1, "Lux:312 T:27.4C"); }
+static void b_ref_string1(ssd1306_t *p, uint32_t i) { (void) i; ref_draw_string(p, 0, 3, 1, "Lux:312 T:27.4C"); }
+static void b_string2(ssd1306_t *p, uint32_t i) { (void) i; ssd1306_draw_string(p, 0, 8, 2, "27.4C"); }
+static void b_ref_string2(ssd1306_t *p, uint32_t i) { (void) i; ref_draw_string(p, 0, 8, 2, "27.4C"); }
+static void b_blit(ssd1306_t *p, uint32_t i) { ssd1306_blit_native(p, 112-(i&7), 0, &img_wifi); }
+static void b_show_same(ssd1306_t *p, uint32_t i) { (void) i; ssd1306_show(p); }
+static void b_show_line(ssd1306_t *p, uint32_t i) {
+    ssd1306_clear_square(p, 0, 32, 128, 8);
+    ssd1306_draw_char(p, (i&15)*6, 32, 1, '0'+(i%10));
+    ssd1306_show(p);
+}
+static void b_show_full(ssd1306_t *p, uint32_t i) {
+    // every byte changes from one frame to the next
+    if(i&1)
+        ssd1306_clear(p);
+    else
+        ssd1306_draw_square(p, 0, 0, 128, 64);
+    ssd1306_show(p);
+}
+
+static void b_font_8x5(ssd1306_t *p, uint32_t i) { (void) i; ssd1306_draw_string(p, 0, 3, 1, "Lux:312 T:27.4C"); }
+static void b_font_8x5_x2(ssd1306_t *p, uint32_t i) { (void) i; ssd1306_draw_string(p, 0, 3, 2, "27.4"); }
+static void b_font_6x8(ssd1306_t *p, uint32_t i) { (void) i; ssd1306_draw_string_font(p, 0, 3, &font_6x8, "Lux:312 T:27.4C"); }
+static void b_font_10x16(ssd1306_t *p, uint32_t i) { (void) i; ssd1306_draw_string_font(p, 0, 3, &font_10x16_digits, "27.4"); }
+
+static size_t font_flash(const ssd1306_font_t *f) {
+    size_t glyphs=f->last-f->first+1;
+    return f->offset[glyphs]+(glyphs+1)*sizeof(uint16_t)+glyphs;
+}
+
+static void fonts(ssd1306_t *p, ssd1306_sim_t *sim) {
+    printf("\n-- fonts --\n");
+    printf("%-34s %6zu bytes flash\n", "font_8x5 (fixed, scaled)", (size_t) 5+font_8x5[1]*(font_8x5[4]-font_8x5[3]+1));
+    printf("%-34s %6zu bytes flash\n", "font_6x8 (proportional)", font_flash(&font_6x8));
+    printf("%-34s %6zu bytes flash\n", "font_10x16_digits", font_flash(&font_10x16_digits));
+    bench(p, "font_8x5 \"Lux:312 T:27.4C\"", b_font_8x5);
+    bench(p, "font_6x8 \"Lux:312 T:27.4C\"", b_font_6x8);
+    bench(p, "font_8x5 x2 \"27.4\"", b_font_8x5_x2);
+    bench(p, "font_10x16_digits \"27.4\"", b_font_10x16);
+
+    ssd1306_clear(p);
+    ssd1306_draw_string(p, 0, 0, 1, "Lux:312 T:27.4C");
+    ssd1306_draw_string_font(p, 0, 10, &font_6x8, "Lux:312 T:27.4C");
+    ssd1306_draw_string(p, 0, 24, 2, "-12.5%");
+    ssd1306_draw_string_font(p, 0, 44, &font_10x16_digits, "-12.5%");
+    show(p, sim, "fonts");
+
+    uint32_t w=ssd1306_string_width(&font_10x16_digits, "-12.5%");
+    if(ssd1306_draw_string_font(p, 0, 44, &font_10x16_digits, "-12.5%")!=w+font_10x16_digits.spacing) {
+        printf("ssd1306_string_width disagrees with ssd1306_draw_string_font\n");
+        ++failures;
+    }
+    ssd1306_clear(p);
+}
+
+static void benchmarks(ssd1306_t *p) {
+    printf("\n-- primitives (%u iterations) --\n", iterations);
+    bench(p, "ssd1306_clear", b_clear);
+    bench(p, "ssd1306_draw_pixel", b_pixel);
+    bench(p, "ssd1306_clear_pixel", b_clear_pixel);
+    bench(p, "ssd1306_draw_line horizontal", b_line_h);
+    bench(p, "ssd1306_draw_line vertical", b_line_v);
+    double line=bench(p, "ssd1306_draw_line diagonal", b_line_d);
+    double ref_line=bench(p, "  reference float line", b_ref_line_d);
+    double sq=bench(p, "ssd1306_draw_square 64x40", b_square);
+    double ref_sq=bench(p, "  reference per-pixel fill", b_ref_square);
+    bench(p, "ssd1306_clear_square 64x40", b_clear_square);
+    bench(p, "ssd1306_draw_empty_square 64x40", b_empty_square);
+    bench(p, "ssd1306_draw_char", b_char);
+    double s1=bench(p, "ssd1306_draw_string 15 chars", b_string1);
+    double ref_s1=bench(p, "  reference per-pixel string", b_ref_string1);
+    double s2=bench(p, "ssd1306_draw_string x2 5 chars", b_string2);
+    double ref_s2=bench(p, "  reference per-pixel string x2", b_ref_string2);
+    bench(p, "ssd1306_blit_native 16x16", b_blit);
+    bench(p, "ssd1306_show unchanged", b_show_same);
+    bench(p, "ssd1306_show one glyph changed", b_show_line);
+    bench(p, "ssd1306_show full frame", b_show_full);
+
+    printf("\nspeedup vs reference: line %.1fx, fill %.1fx, string %.1fx, string x2 %.1fx\n",
+           ref_line/line, ref_sq/sq, ref_s1/s1, ref_s2/s2);
+}
+
+// the fast paths must produce the same pixels as the reference code
+static void check_reference(ssd1306_t *p) {
+    static const struct { int32_t x1, y1, x2, y2; } lines[]= {
+        {0, 0, 127, 63}, {0, 63, 127, 0}, {5, 10, 90, 12}, {100, 2, 20, 60},
+    };
+    uint8_t *ref=malloc(p->bufsize);
+
+    ssd1306_clear(p);
+    ref_draw_string(p, 3, 5, 1, "Lux:312 T:27.4C");
+    ref_draw_string(p, 1, 20, 2, "-61dBm");
+    ref_draw_string(p, 7, 38, 3, "27C");
+    memcpy(ref, p->buffer, p->bufsize);
+
+    ssd1306_clear(p);
+    ssd1306_draw_string(p, 3, 5, 1, "Lux:312 T:27.4C");
+    ssd1306_draw_string(p, 1, 20, 2, "-61dBm");
+    ssd1306_draw_string(p, 7, 38, 3, "27C");
+    if(memcmp(ref, p->buffer, p->bufsize)) {
+        printf("draw_string differs from the per-pixel reference\n");
+        ++failures;
+    }
+
+    ssd1306_clear(p);
+    ref_fill(p, 3, 5, 70, 37);
+    memcpy(ref, p->buffer, p->bufsize);
+    ssd1306_clear(p);
+    ssd1306_draw_square(p, 3, 5, 70, 37);
+    if(memcmp(ref, p->buffer, p->bufsize)) {
+        printf("draw_square differs from the per-pixel reference\n");
+        ++failures;
+    }
+
+    // bresenham may pick the other pixel where the float version truncated,
+    // but both must touch every column once for shallow lines
+    for(size_t i=0; i<sizeof(lines)/sizeof(lines[0]); ++i) {
+        ssd1306_clear(p);
+        ssd1306_draw_line(p, lines[i].x1, lines[i].y1, lines[i].x2, lines[i].y2);
+        int32_t x0=lines[i].x1<lines[i].x2?lines[i].x1:lines[i].x2;
+        int32_t x1=lines[i].x1<lines[i].x2?lines[i].x2:lines[i].x1;
+        for(int32_t x=x0; x<=x1; ++x) {
+            bool any=false;
+            for(uint32_t pg=0; pg<p->pages; ++pg)
+                any|=p->buffer[pg*p->width+x]!=0;
+            if(!any) {
+                printf("draw_line %zu has a gap at column %d\n", i, x);
+                ++failures;
+                break;
+            }
+        }
+    }
+
+    free(ref);
+    ssd1306_clear(p);
+}
+
+int main(int argc, char **argv) {
+    if(argc>1)
+        out_dir=argv[1];
+    if(argc>2)
+        iterations=strtoul(argv[2], NULL, 0);
+
+    static ssd1306_sim_t sim;
+    ssd1306_t disp;
+
+    ssd1306_sim_init(&sim);
+    if(!ssd1306_init_with_transport(&disp, 128, 64, 0x3C, &sim.base)) {
+        printf("ssd1306_init_with_transport failed\n");
+        return 1;
+    }
+    printf("init: %u transactions, %u bytes, %u commands decoded\n",
+           disp.transport->transactions, disp.transport->bytes, sim.commands);
+
+    scenarios(&disp, &sim);
+    ui_scenario(&disp, &sim);
+    console_scenario(&disp, &sim);
+    check_reference(&disp);
+    benchmarks(&disp);
+    fonts(&disp, &sim);
+
+    if(sim.unknown) {
+        printf("%u unknown command bytes on the bus\n", sim.unknown);
+        ++failures;
+    }
+
+    ssd1306_deinit(&disp);
+    printf("\n%s\n", failures?"FAILED":"OK");
+    return failures?1:0;
+}
@@ -0,0 +1,292 @@
+/**
+* @file ssd1306_sim.c
+*
+* host-side ssd1306 panel simulator
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ssd1306_sim.h"
+
+// number of argument bytes following a command byte
+static uint8_t ssd1306_sim_args(uint8_t c) {
+    switch(c) {
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+    case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        return 1;
+    case 0x21: case 0x22: case 0xA3:
+        return 2;
+    case 0x29: case 0x2A:
+        return 5;
+    case 0x26: case 0x27:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+static void ssd1306_sim_exec(ssd1306_sim_t *sim) {
+    const uint8_t *c=sim->cmd;
+
+    ++sim->commands;
+    if(c[0]>=0x40 && c[0]<=0x7F) {
+        sim->start_line=c[0]&0x3F;
+        return;
+    }
+    if(c[0]>=0xB0 && c[0]<=0xB7) {
+        sim->page=c[0]&0x07;
+        return;
+    }
+    if(c[0]<=0x0F) {
+        sim->col=(sim->col&0xF0)|c[0];
+        return;
+    }
+    if(c[0]>=0x10 && c[0]<=0x1F) {
+        sim->col=(sim->col&0x0F)|((c[0]&0x0F)<<4);
+        return;
+    }
+
+    switch(c[0]) {
+    case 0x20:
+        sim->mem_mode=c[1]&3;
+        break;
+    case 0x21:
+        sim->col_start=sim->col=c[1]&0x7F;
+        sim->col_end=c[2]&0x7F;
+        break;
+    case 0x22:
+        sim->page_start=sim->page=c[1]&0x07;
+        sim->page_end=c[2]&0x07;
+        break;
+    case 0x81:
+        sim->contrast=c[1];
+        break;
+    case 0xA0: case 0xA1:
+        sim->seg_remap=c[0]&1;
+        break;
+    case 0xA4: case 0xA5:
+        sim->entire_on=c[0]&1;
+        break;
+    case 0xA6: case 0xA7:
+        sim->inverted=c[0]&1;
+        break;
+    case 0xAE: case 0xAF:
+        sim->display_on=c[0]&1;
+        break;
+    case 0xC0: case 0xC8:
+        sim->com_remap=(c[0]&0x08)!=0;
+        break;
+    case 0x26: case 0x27: case 0x29: case 0x2A: case 0x2E: case 0x2F: case 0xA3:
+    case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        // analog / timing / scrolling setup, nothing visible to model here
+        break;
+    default:
+        ++sim->unknown;
+        break;
+    }
+}
+
+static void ssd1306_sim_command(ssd1306_sim_t *sim, uint8_t b) {
+    if(sim->cmd_len==0)
+        sim->cmd_need=1+ssd1306_sim_args(b);
+
+    sim->cmd[sim->cmd_len++]=b;
+    if(sim->cmd_len==sim->cmd_need) {
+        ssd1306_sim_exec(sim);
+        sim->cmd_len=0;
+    }
+}
+
+static void ssd1306_sim_data(ssd1306_sim_t *sim, uint8_t b) {
+    sim->ram[sim->page][sim->col]=b;
+    ++sim->data_bytes;
+
+    switch(sim->mem_mode) {
+    case 0: // horizontal
+        if(sim->col++>=sim->col_end) {
+            sim->col=sim->col_start;
+            if(sim->page++>=sim->page_end)
+                sim->page=sim->page_start;
+        }
+        break;
+    case 1: // vertical
+        if(sim->page++>=sim->page_end) {
+            sim->page=sim->page_start;
+            if(sim->col++>=sim->col_end)
+                sim->col=sim->col_start;
+        }
+        break;
+    default: // page mode, column pointer wraps inside the page
+        sim->col=(sim->col+1)&0x7F;
+        break;
+    }
+}
+
+static void ssd1306_sim_write(ssd1306_transport_t *base, uint8_t addr, const uint8_t *src, size_t len) {
+    ssd1306_sim_t *sim=(ssd1306_sim_t *) base;
+
+    (void) addr;
+    for(size_t i=0; i<len;) {
+        uint8_t control=src[i++];
+        bool data=control&0x40;
+
+        // Co set: exactly one byte follows before the next control byte
+        size_t n=(control&0x80)?1:len-i;
+        for(; n && i<len; --n, ++i) {
+            if(data)
+                ssd1306_sim_data(sim, src[i]);
+            else
+                ssd1306_sim_command(sim, src[i]);
+        }
+    }
+}
+
+static bool ssd1306_sim_commit(ssd1306_transport_t *base, uint8_t addr, void (*done)(void *arg), void *arg) {
+    (void) base;
+    (void) addr;
+    if(done)
+        done(arg);
+    return false;
+}
+
+static void ssd1306_sim_wait(ssd1306_transport_t *base) {
+    (void) base;
+}
+
+void ssd1306_sim_init(ssd1306_sim_t *sim) {
+    memset(sim, 0, sizeof(*sim));
+    sim->base.write=ssd1306_sim_write;
+    sim->base.commit=ssd1306_sim_commit;
+    sim->base.wait=ssd1306_sim_wait;
+    sim->base.ok=true;
+    sim->mem_mode=2;
+    sim->col_end=SSD1306_SIM_WIDTH-1;
+    sim->page_end=SSD1306_SIM_PAGES-1;
+    sim->contrast=0x7F;
+}
+
+bool ssd1306_sim_pixel(const ssd1306_sim_t *sim, uint32_t x, uint32_t y) {
+    if(!sim->display_on)
+        return false;
+    if(sim->entire_on)
+        return true;
+
+    // the driver sets up A1/C8 so that RAM appears unmirrored on the glass
+    uint32_t col=sim->seg_remap?x:SSD1306_SIM_WIDTH-1-x;
+    uint32_t row=sim->com_remap?y:SSD1306_SIM_PAGES*8-1-y;
+    row=(row+sim->start_line)&0x3F;
+
+    bool on=(sim->ram[row>>3][col]>>(row&7))&1;
+    return on!=sim->inverted;
+}
+
+bool ssd1306_sim_write_pgm(const ssd1306_sim_t *sim, const char *path, uint32_t scale) {
+    FILE *f=fopen(path, "wb");
+    if(f==NULL)
+        return false;
+
+    uint32_t w=SSD1306_SIM_WIDTH*scale, h=SSD1306_SIM_PAGES*8*scale;
+    fprintf(f, "P5\n%u %u\n255\n", w, h);
+    for(uint32_t y=0; y<h; ++y)
+        for(uint32_t x=0; x<w; ++x)
+            fputc(ssd1306_sim_pixel(sim, x/scale, y/scale)?0xFF:0x00, f);
+
+    return fclose(f)==0;
+}
+
+static uint32_t ssd1306_sim_crc(uint32_t crc, const uint8_t *data, size_t len) {
+    crc=~crc;
+    for(size_t i=0; i<len; ++i) {
+        crc^=data[i];
+        for(int k=0; k<8; ++k)
+            crc=(crc>>1)^(0xEDB88320u&-(crc&1));
+    }
+    return ~crc;
+}
+
+static void ssd1306_sim_be32(uint8_t *dst, uint32_t v) {
+    dst[0]=v>>24;
+    dst[1]=v>>16;
+    dst[2]=v>>8;
+    dst[3]=v;
+}
+
+static void ssd1306_sim_chunk(FILE *f, const char *type, const uint8_t *data, size_t len) {
+    uint8_t hdr[8];
+    ssd1306_sim_be32(hdr, len);
+    memcpy(hdr+4, type, 4);
+    fwrite(hdr, 1, 8, f);
+    if(len)
+        fwrite(data, 1, len, f);
+
+    uint32_t crc=ssd1306_sim_crc(0, hdr+4, 4);
+    crc=ssd1306_sim_crc(crc, data, len);
+    ssd1306_sim_be32(hdr, crc);
+    fwrite(hdr, 1, 4, f);
+}
+
+bool ssd1306_sim_write_png(const ssd1306_sim_t *sim, const char *path, uint32_t scale) {
+    uint32_t w=SSD1306_SIM_WIDTH*scale, h=SSD1306_SIM_PAGES*8*scale;
+    size_t raw_len=(size_t) (w+1)*h;
+    uint8_t *raw=malloc(raw_len);
+    // zlib header + stored blocks of at most 65535 bytes + adler32
+    size_t blocks=(raw_len+65534)/65535;
+    uint8_t *z=malloc(2+blocks*5+raw_len+4);
+    if(raw==NULL || z==NULL) {
+        free(raw);
+        free(z);
+        return false;
+    }
+
+    for(uint32_t y=0; y<h; ++y) {
+        uint8_t *line=raw+(size_t) y*(w+1);
+        line[0]=0; // filter: none
+        for(uint32_t x=0; x<w; ++x)
+            line[1+x]=ssd1306_sim_pixel(sim, x/scale, y/scale)?0xFF:0x00;
+    }
+
+    size_t zlen=0;
+    z[zlen++]=0x78;
+    z[zlen++]=0x01;
+    uint32_t a=1, b=0;
+    for(size_t off=0; off<raw_len; off+=65535) {
+        size_t n=raw_len-off>65535?65535:raw_len-off;
+        z[zlen++]=off+n==raw_len;
+        z[zlen++]=n&0xFF;
+        z[zlen++]=n>>8;
+        z[zlen++]=~n&0xFF;
+        z[zlen++]=(~n>>8)&0xFF;
+        memcpy(z+zlen, raw+off, n);
+        zlen+=n;
+        for(size_t i=0; i<n; ++i) {
+            a=(a+raw[off+i])%65521;
+            b=(b+a)%65521;
+        }
+    }
+    ssd1306_sim_be32(z+zlen, (b<<16)|a);
+    zlen+=4;
+
+    FILE *f=fopen(path, "wb");
+    bool ok=f!=NULL;
+    if(ok) {
+        static const uint8_t sig[8]= {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        uint8_t ihdr[13];
+        ssd1306_sim_be32(ihdr, w);
+        ssd1306_sim_be32(ihdr+4, h);
+        ihdr[8]=8;  // bit depth
+        ihdr[9]=0;  // grayscale
+        ihdr[10]=ihdr[11]=ihdr[12]=0;
+
+        fwrite(sig, 1, sizeof(sig), f);
+        ssd1306_sim_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+        ssd1306_sim_chunk(f, "IDAT", z, zlen);
+        ssd1306_sim_chunk(f, "IEND", NULL, 0);
+        ok=fclose(f)==0;
+    }
+
+    free(raw);
+    free(z);
+    return ok;
+}
@@ -0,0 +1,75 @@
+/**
+* @file ssd1306_sim.h
+*
+* host-side ssd1306 panel: a transport that decodes the command/data stream
+* into display RAM and renders what the panel would show
+*/
+
+#ifndef _inc_ssd1306_sim
+#define _inc_ssd1306_sim
+
+#include "ssd1306.h"
+
+#define SSD1306_SIM_WIDTH 128
+#define SSD1306_SIM_PAGES 8
+
+/**
+*	@brief state of the simulated controller
+*/
+typedef struct {
+    ssd1306_transport_t base;
+    uint8_t ram[SSD1306_SIM_PAGES][SSD1306_SIM_WIDTH];	/**< display RAM */
+    uint8_t mem_mode;	/**< 0 horizontal, 1 vertical, 2 page addressing */
+    uint8_t col_start, col_end, page_start, page_end;	/**< address window */
+    uint8_t col, page;	/**< RAM pointer */
+    uint8_t start_line;	/**< display start line */
+    uint8_t contrast;
+    bool display_on, inverted, entire_on, seg_remap, com_remap;
+    uint8_t cmd[8];		/**< command being assembled across bytes */
+    uint8_t cmd_len, cmd_need;
+    uint32_t commands;	/**< commands decoded */
+    uint32_t data_bytes;	/**< RAM bytes written */
+    uint32_t unknown;	/**< bytes that were not understood */
+} ssd1306_sim_t;
+
+/**
+*	@brief reset the simulated controller to its power-on state
+*
+*	@param[in] sim : simulator
+*/
+void ssd1306_sim_init(ssd1306_sim_t *sim);
+
+/**
+*	@brief read the pixel the viewer sees (start line, remap and inversion applied)
+*
+*	@param[in] sim : simulator
+*	@param[in] x : column on the glass
+*	@param[in] y : row on the glass
+*/
+bool ssd1306_sim_pixel(const ssd1306_sim_t *sim, uint32_t x, uint32_t y);
+
+/**
+*	@brief write the visible panel as binary PGM
+*
+*	@param[in] sim : simulator
+*	@param[in] path : output file
+*	@param[in] scale : pixel size in the image
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool ssd1306_sim_write_pgm(const ssd1306_sim_t *sim, const char *path, uint32_t scale);
+
+/**
+*	@brief write the visible panel as grayscale PNG (uncompressed deflate)
+*
+*	@param[in] sim : simulator
+*	@param[in] path : output file
+*	@param[in] scale : pixel size in the image
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool ssd1306_sim_write_png(const ssd1306_sim_t *sim, const char *path, uint32_t scale);
+
+#endif
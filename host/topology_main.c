@@ -0,0 +1,176 @@
+/**
+* @file topology_main.c
+*
+* host harness for i2c_topology.c: simulated flash and i2c buses with a
+* configurable set of devices, checking when the cache is trusted, when it
+* is rescanned, and that a trusted cache costs no probe scan
+*
+* usage: topology_test
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <hardware/flash.h>
+#include <hardware/gpio.h>
+
+#include "i2c_topology.h"
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+// i2c instances are only compared, any distinct addresses do
+static int host_i2c_inst[2];
+i2c_inst_t *const host_i2c0=(i2c_inst_t *) &host_i2c_inst[0];
+i2c_inst_t *const host_i2c1=(i2c_inst_t *) &host_i2c_inst[1];
+
+typedef struct {
+    uint8_t bus, sda, scl, addr;
+    uint8_t id_reg, id;		/**< id register and its value, id_reg 0 for none */
+    bool present;
+} sim_dev_t;
+
+static sim_dev_t devs[]= {
+    {0, 0, 1, 0x68, 0x75, 0x68, true},	// MPU6050
+    {0, 0, 1, 0x23, 0, 0, true},		// BH1750
+    {1, 2, 3, 0x50, 0, 0, true},		// EEPROM, unknown type
+    {1, 26, 27, 0x76, 0xD0, 0x58, true},	// BMP280
+};
+#define SIM_DEVS (sizeof(devs)/sizeof(devs[0]))
+
+static uint8_t last_pins[2];	// last two pins switched to i2c
+static uint8_t bus_sda[2], bus_scl[2];
+static bool bus_up[2];
+static uint8_t pending_reg=0xFF;
+static uint32_t reads, erases, programs;
+static int failures=0;
+
+static void check(bool ok, const char *what) {
+    if(!ok) {
+        printf("FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+void gpio_set_function(uint gpio, uint fn) {
+    if(fn==GPIO_FUNC_I2C) {
+        last_pins[0]=last_pins[1];
+        last_pins[1]=gpio;
+    }
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    int bus=i2c==i2c1;
+    bus_sda[bus]=last_pins[0];
+    bus_scl[bus]=last_pins[1];
+    bus_up[bus]=true;
+    return baudrate;
+}
+
+void i2c_deinit(i2c_inst_t *i2c) {
+    bus_up[i2c==i2c1]=false;
+}
+
+static sim_dev_t *sim_find(i2c_inst_t *i2c, uint8_t addr) {
+    int bus=i2c==i2c1;
+    if(!bus_up[bus])
+        return NULL;
+    for(size_t i=0; i<SIM_DEVS; ++i) {
+        sim_dev_t *d=&devs[i];
+        if(d->present && d->bus==bus && d->sda==bus_sda[bus] && d->scl==bus_scl[bus] && d->addr==addr)
+            return d;
+    }
+    return NULL;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us) {
+    (void) nostop;
+    (void) timeout_us;
+    if(!sim_find(i2c, addr))
+        return -1;
+    pending_reg=len?src[0]:0xFF;
+    return (int) len;
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us) {
+    (void) nostop;
+    (void) timeout_us;
+    ++reads;
+    sim_dev_t *d=sim_find(i2c, addr);
+    if(!d)
+        return -1;
+    memset(dst, 0, len);
+    if(d->id_reg && pending_reg==d->id_reg)
+        dst[0]=d->id;
+    pending_reg=0xFF;
+    return (int) len;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    ++erases;
+    memset(host_flash+flash_offs, 0xFF, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    ++programs;
+    for(size_t i=0; i<count; ++i)
+        host_flash[flash_offs+i]&=data[i];
+}
+
+static i2c_topology_source_t boot(i2c_topology_t *t, const char *name) {
+    static const char *const source[]= {"cached", "rescanned", "failed"};
+    reads=erases=programs=0;
+    i2c_topology_source_t s=i2c_topology_boot(t, 0, 0);
+    printf("%-14s %-9s %2u devices, %4u reads, %u erases\n", name, source[s], t->count, reads, erases);
+    return s;
+}
+
+int main(void) {
+    static i2c_topology_t t;
+
+    memset(host_flash, 0xFF, sizeof(host_flash));
+
+    check(boot(&t, "blank flash")==I2C_TOPOLOGY_RESCANNED && t.count==4 && erases==1, "blank flash scans and saves");
+    const i2c_dev_t *mpu=i2c_topology_find(&t, I2C_DEV_MPU6050);
+    check(mpu && mpu->bus==0 && mpu->sda==0 && mpu->addr==0x68, "MPU6050 found");
+    check(i2c_topology_find(&t, I2C_DEV_BH1750)!=NULL, "BH1750 found");
+    check(i2c_topology_find(&t, I2C_DEV_BMP280)!=NULL, "BMP280 identified");
+    check(i2c_topology_find(&t, I2C_DEV_BME280)==NULL, "no BME280");
+    uint32_t scan_reads=reads;
+
+    check(boot(&t, "same devices")==I2C_TOPOLOGY_CACHED && t.count==4, "unchanged bus uses the cache");
+    check(erases==0 && reads<=t.count, "cache hit costs one read per device, no erase");
+
+    devs[1].present=false;
+    check(boot(&t, "BH1750 gone")==I2C_TOPOLOGY_RESCANNED && t.count==3, "missing device rescans");
+    check(i2c_topology_find(&t, I2C_DEV_BH1750)==NULL, "BH1750 dropped");
+    devs[1].present=true;
+
+    devs[0].id=0x70;	// something else answering at 0x68
+    check(boot(&t, "wrong id")==I2C_TOPOLOGY_RESCANNED && i2c_topology_find(&t, I2C_DEV_MPU6050)==NULL,
+          "changed id rescans");
+    devs[0].id=0x68;
+    boot(&t, "restored");
+
+    host_flash[PICO_FLASH_SIZE_BYTES-FLASH_SECTOR_SIZE+8]^=0x01;
+    check(boot(&t, "corrupt copy")==I2C_TOPOLOGY_RESCANNED && t.count==4, "bad CRC rescans");
+
+    // a board with nothing attached keeps its empty map
+    for(size_t i=0; i<SIM_DEVS; ++i)
+        devs[i].present=false;
+    check(boot(&t, "no devices")==I2C_TOPOLOGY_RESCANNED && t.count==0, "empty bus saved");
+    check(boot(&t, "still none")==I2C_TOPOLOGY_CACHED && reads==0 && erases==0, "empty cache is a hit");
+    for(size_t i=0; i<SIM_DEVS; ++i)
+        devs[i].present=true;
+
+    // skipped pins and address are never probed
+    reads=0;
+    i2c_topology_scan(&t, (1u<<26)|(1u<<27), 0x50);
+    check(t.count==2 && i2c_topology_find(&t, I2C_DEV_BMP280)==NULL, "skip pins and address");
+    check(reads<scan_reads, "skipped pins cost no reads");
+
+    check(!strcmp(i2c_topology_type_name(I2C_DEV_BH1750), "BH1750")
+          && !strcmp(i2c_topology_type_name(I2C_DEV_TYPES), "?"), "type names");
+
+    printf("\n%s\n", failures?"FAILED":"OK");
+    return failures?1:0;
+}
@@ -0,0 +1,236 @@
+/**
+* @file http_conn.c
+*
+* persistent HTTP/1.1 client connection over lwip sockets
+*/
+
+#include <pico/stdlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "lwip/sockets.h"
+
+#include "http_conn.h"
+
+static bool http_conn_connect(http_conn_t *c) {
+    struct sockaddr_in addr;
+    struct timeval tv= {.tv_sec=c->timeout_ms/1000, .tv_usec=(c->timeout_ms%1000)*1000};
+    int one=1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family=AF_INET;
+    addr.sin_port=htons(c->port);
+    inet_aton(c->host, &addr.sin_addr);
+
+    if((c->sock=socket(AF_INET, SOCK_STREAM, 0))<0) {
+        ++c->errors;
+        return false;
+    }
+    setsockopt(c->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(c->sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    // requests go out whole, waiting for acks only adds latency
+    setsockopt(c->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if(connect(c->sock, (struct sockaddr *) &addr, sizeof(addr))<0) {
+        ++c->errors;
+        http_conn_close(c);
+        return false;
+    }
+    ++c->connections;
+    c->conn_requests=0;
+    c->rx_len=0;
+    c->inflight=0;
+    return true;
+}
+
+// an idle keep-alive connection the server has given up on reads as EOF
+static bool http_conn_alive(http_conn_t *c) {
+    char b;
+    int got=recv(c->sock, &b, 1, MSG_PEEK|MSG_DONTWAIT);
+
+    if(got==0 || (got<0 && errno!=EAGAIN && errno!=EWOULDBLOCK)) {
+        if(got==0)
+            ++c->server_closes;
+        http_conn_close(c);
+        return false;
+    }
+    return true;
+}
+
+static bool http_conn_send_all(int sock, const char *p, size_t len) {
+    while(len) {
+        int n=send(sock, p, len, 0);
+        if(n<=0)
+            return false;
+        p+=n;
+        len-=n;
+    }
+    return true;
+}
+
+// more bytes into rx; false on timeout, error or EOF
+static bool http_conn_fill(http_conn_t *c, bool *eof) {
+    if(c->rx_len>=HTTP_CONN_RX_SIZE)
+        return false;
+    int got=recv(c->sock, c->rx+c->rx_len, HTTP_CONN_RX_SIZE-c->rx_len, 0);
+    if(got<=0) {
+        *eof=got==0;
+        return false;
+    }
+    c->rx_len+=got;
+    c->rx[c->rx_len]='\0';
+    return true;
+}
+
+static void http_conn_consume(http_conn_t *c, size_t n) {
+    memmove(c->rx, c->rx+n, c->rx_len-n);
+    c->rx_len-=n;
+    c->rx[c->rx_len]='\0';
+}
+
+void http_conn_init(http_conn_t *c, const char *host, uint16_t port, uint32_t timeout_ms) {
+    memset(c, 0, sizeof(*c));
+    c->host=host;
+    c->port=port;
+    c->timeout_ms=timeout_ms;
+    c->sock=-1;
+}
+
+void http_conn_close(http_conn_t *c) {
+    if(c->sock>=0)
+        lwip_close(c->sock);
+    c->sock=-1;
+    c->inflight=0;
+    c->rx_len=0;
+}
+
+bool http_conn_send(http_conn_t *c, const char *path, const char *content_type, const void *body, size_t len) {
+    if(c->inflight>=HTTP_CONN_PIPELINE)
+        return false;
+
+    int head=snprintf(c->tx, sizeof(c->tx),
+        "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+        "Connection: keep-alive\r\n\r\n", path, c->host, content_type, (unsigned) len);
+    if(head<0 || (size_t) head>=sizeof(c->tx))
+        return false;
+    // small requests leave in one piece, larger bodies straight from the caller
+    bool whole=head+len<=sizeof(c->tx);
+    if(whole)
+        memcpy(c->tx+head, body, len);
+
+    if(c->sock>=0 && c->inflight==0)
+        http_conn_alive(c);
+    if(c->sock<0 && !http_conn_connect(c))
+        return false;
+
+    c->sent_us[c->inflight]=time_us_32();
+    if(!http_conn_send_all(c->sock, c->tx, whole?head+len:(size_t) head)
+        || (!whole && !http_conn_send_all(c->sock, body, len))) {
+        ++c->errors;
+        http_conn_close(c);
+        return false;
+    }
+    ++c->inflight;
+    return true;
+}
+
+int http_conn_recv(http_conn_t *c, char *reply, size_t reply_size) {
+    bool eof=false;
+    char *end;
+
+    if(reply_size)
+        reply[0]='\0';
+    if(c->sock<0 || c->inflight==0)
+        return -1;
+
+    // status line and headers
+    while((end=strstr(c->rx, "\r\n\r\n"))==NULL)
+        if(!http_conn_fill(c, &eof))
+            goto failed;
+
+    int minor=0, status=0;
+    if(sscanf(c->rx, "HTTP/1.%d %d", &minor, &status)!=2)
+        goto failed;
+
+    // HTTP/1.1 stays open unless told otherwise, 1.0 only when asked to
+    bool keep=minor>=1;
+    long length=-1;
+    for(char *line=strstr(c->rx, "\r\n")+2; line<end; line=strstr(line, "\r\n")+2) {
+        if(!strncasecmp(line, "Content-Length:", 15))
+            length=strtol(line+15, NULL, 10);
+        else if(!strncasecmp(line, "Connection:", 11)) {
+            const char *v=line+11;
+            while(*v==' ')
+                ++v;
+            if(!strncasecmp(v, "close", 5))
+                keep=false;
+            else if(!strncasecmp(v, "keep-alive", 10))
+                keep=true;
+        }
+    }
+    http_conn_consume(c, end+4-c->rx);
+
+    // body: up to Content-Length, or to the end of the connection
+    size_t copied=0;
+    while(length!=0) {
+        if(c->rx_len==0 && !http_conn_fill(c, &eof)) {
+            if(length<0 && eof)
+                break;
+            goto failed;
+        }
+        size_t n=length<0 || (size_t) length>c->rx_len?c->rx_len:(size_t) length;
+        size_t room=reply_size?reply_size-1-copied:0;
+        memcpy(reply+copied, c->rx, n<room?n:room);
+        copied+=n<room?n:room;
+        http_conn_consume(c, n);
+        if(length>0)
+            length-=n;
+    }
+    if(reply_size)
+        reply[copied]='\0';
+
+    uint32_t latency=time_us_32()-c->sent_us[0];
+    memmove(c->sent_us, c->sent_us+1, (c->inflight-1)*sizeof(c->sent_us[0]));
+    --c->inflight;
+    c->latency_sum_us+=latency;
+    if(latency>c->latency_max_us)
+        c->latency_max_us=latency;
+    ++c->requests;
+    if(++c->conn_requests>c->conn_requests_max)
+        c->conn_requests_max=c->conn_requests;
+
+    if(!keep || eof) {
+        ++c->server_closes;
+        http_conn_close(c);
+    }
+    return status;
+
+failed:
+    if(eof)
+        ++c->server_closes;
+    else
+        ++c->errors;
+    http_conn_close(c);
+    return -1;
+}
+
+int http_conn_post(http_conn_t *c, const char *path, const char *content_type, const void *body, size_t len,
+    char *reply, size_t reply_size) {
+    for(int attempt=0; attempt<2; ++attempt) {
+        // only a reused connection can have died under us
+        bool reused=c->sock>=0;
+        int status=-1;
+        if(http_conn_send(c, path, content_type, body, len))
+            status=http_conn_recv(c, reply, reply_size);
+        if(status>0 || !reused)
+            return status;
+        ++c->retries;
+    }
+    return -1;
+}
+
+uint32_t http_conn_rpc_centi(const http_conn_t *c) {
+    return c->connections?(uint32_t) ((uint64_t) c->requests*100/c->connections):0;
+}
@@ -0,0 +1,115 @@
+/**
+* @file http_conn.h
+*
+* persistent HTTP/1.1 client connection: one keep-alive socket to a server,
+* reused for every request, with requests pipelined ahead of their
+* responses. A server close or a reset is noticed and the next request opens
+* a new connection
+*/
+
+#ifndef _inc_http_conn
+#define _inc_http_conn
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+*	@brief most requests sent ahead of their responses
+*/
+#define HTTP_CONN_PIPELINE 4
+
+/**
+*	@brief request buffer: headers, and the body when it fits
+*/
+#define HTTP_CONN_TX_SIZE 1024
+
+/**
+*	@brief response buffer: headers and the start of a body
+*/
+#define HTTP_CONN_RX_SIZE 1024
+
+/**
+*	@brief connection state and statistics
+*/
+typedef struct {
+    const char *host;	/**< dotted ipv4 address */
+    uint16_t port;
+    uint32_t timeout_ms;	/**< send and receive timeout */
+    int sock;			/**< -1 when not connected */
+    uint32_t sent_us[HTTP_CONN_PIPELINE];	/**< send time of each request in flight */
+    size_t inflight;	/**< requests waiting for their response */
+    char tx[HTTP_CONN_TX_SIZE];
+    char rx[HTTP_CONN_RX_SIZE+1];	/**< received and not yet parsed, NUL terminated */
+    size_t rx_len;
+    uint32_t connections;	/**< connects that succeeded */
+    uint32_t requests;		/**< responses received */
+    uint32_t conn_requests;	/**< responses on the current connection */
+    uint32_t conn_requests_max;	/**< most responses on one connection */
+    uint32_t server_closes;	/**< connections the server ended (Connection: close, FIN) */
+    uint32_t errors;		/**< connects, sends or receives that failed */
+    uint32_t retries;		/**< requests sent again on a new connection */
+    uint64_t latency_sum_us;	/**< send to full response, over all requests */
+    uint32_t latency_max_us;
+} http_conn_t;
+
+/**
+*	@brief set up a connection, nothing is opened until the first request
+*
+*	@param[in] c : connection
+*	@param[in] host : server ipv4 address, must outlive the connection
+*	@param[in] port : server port
+*	@param[in] timeout_ms : send and receive timeout
+*/
+void http_conn_init(http_conn_t *c, const char *host, uint16_t port, uint32_t timeout_ms);
+
+/**
+*	@brief send a POST, connecting first if needed; the response is read
+*	later with http_conn_recv, in order
+*
+*	@param[in] c : connection
+*	@param[in] path : request path
+*	@param[in] content_type : Content-Type of body
+*	@param[in] body : request body
+*	@param[in] len : body length
+*
+*	@return bool.
+*	@retval false if the pipeline is full, the headers too long, or the
+*	connection failed
+*/
+bool http_conn_send(http_conn_t *c, const char *path, const char *content_type, const void *body, size_t len);
+
+/**
+*	@brief read the response to the oldest request in flight
+*
+*	Closes the connection when the server asks for it or it fails; requests
+*	still in flight are then lost and must be sent again.
+*
+*	@param[in] c : connection
+*	@param[out] reply : body, NUL terminated and truncated to reply_size-1
+*	@param[in] reply_size : size of reply
+*
+*	@return HTTP status, or -1 if no response arrived
+*/
+int http_conn_recv(http_conn_t *c, char *reply, size_t reply_size);
+
+/**
+*	@brief http_conn_send and http_conn_recv in one, sent once more on a new
+*	connection if a reused one turns out to be dead
+*
+*	@return HTTP status, or -1
+*/
+int http_conn_post(http_conn_t *c, const char *path, const char *content_type, const void *body, size_t len,
+    char *reply, size_t reply_size);
+
+/**
+*	@brief close the socket, dropping requests in flight
+*/
+void http_conn_close(http_conn_t *c);
+
+/**
+*	@brief average requests per connection in hundredths
+*/
+uint32_t http_conn_rpc_centi(const http_conn_t *c);
+
+#endif
@@ -0,0 +1,259 @@
+/**
+* @file i2c_bus.c
+*
+* i2c bus manager task with dma transfers
+*/
+
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <stdlib.h>
+
+#include "i2c_bus.h"
+
+// worst case per byte at 100 kHz is 90 us, leave room for clock stretching
+#define I2C_BUS_TIMEOUT_MS(words) (10+(words)/8)
+
+static i2c_bus_t *i2c_bus_owner[2];
+
+static void i2c_bus_irq(i2c_bus_t *b) {
+    i2c_hw_t *hw=i2c_get_hw(b->i2c_i);
+    uint32_t stat=hw->intr_stat;
+
+    if(stat&I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // TX_ABRT is cleared by the task once the dma is stopped, otherwise
+        // the controller would pick up the rest of the command words
+        b->abort_source=hw->tx_abrt_source;
+        b->aborted=true;
+    } else if(stat&I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void) hw->clr_stop_det;
+    } else {
+        return;
+    }
+
+    hw->intr_mask=0;
+    BaseType_t woken=pdFALSE;
+    vTaskNotifyGiveIndexedFromISR(b->task, I2C_BUS_NOTIFY_INDEX, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void i2c_bus0_irq_handler(void) {
+    i2c_bus_irq(i2c_bus_owner[0]);
+}
+
+static void i2c_bus1_irq_handler(void) {
+    i2c_bus_irq(i2c_bus_owner[1]);
+}
+
+static int i2c_bus_run(i2c_bus_t *b, i2c_xfer_t *x) {
+    i2c_hw_t *hw=i2c_get_hw(b->i2c_i);
+    size_t n=0;
+
+    for(size_t i=0; i<x->tx_len; ++i)
+        b->cmd[n++]=x->tx[i];
+    for(size_t i=0; i<x->rx_len; ++i)
+        b->cmd[n++]=I2C_IC_DATA_CMD_CMD_BITS|(i==0 && x->tx_len?I2C_IC_DATA_CMD_RESTART_BITS:0);
+    b->cmd[n-1]|=I2C_IC_DATA_CMD_STOP_BITS;
+
+    hw->enable=0;
+    hw->tar=x->addr;
+    hw->enable=1;
+
+    b->aborted=false;
+    (void) hw->clr_stop_det;
+    ulTaskNotifyTakeIndexed(I2C_BUS_NOTIFY_INDEX, pdTRUE, 0);
+    hw->intr_mask=I2C_IC_INTR_MASK_M_STOP_DET_BITS|I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    if(x->rx_len)
+        dma_channel_transfer_to_buffer_now(b->dma_rx, x->rx, x->rx_len);
+    dma_channel_transfer_from_buffer_now(b->dma_tx, b->cmd, n);
+
+    bool finished=ulTaskNotifyTakeIndexed(I2C_BUS_NOTIFY_INDEX, pdTRUE, pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MS(n)));
+
+    // the last byte is in the rx fifo when STOP is seen, give the dma a moment
+    for(uint32_t spin=0; finished && !b->aborted && dma_channel_is_busy(b->dma_rx) && spin<1000; ++spin)
+        tight_loop_contents();
+
+    if(finished && !b->aborted && !dma_channel_is_busy(b->dma_rx))
+        return x->tx_len+x->rx_len;
+
+    hw->intr_mask=0;
+    dma_channel_abort(b->dma_tx);
+    dma_channel_abort(b->dma_rx);
+    (void) hw->clr_tx_abrt;
+    while(hw->rxflr)
+        (void) hw->data_cmd;
+
+    if(!finished) {
+        // stuck (clock held low or a lost STOP): restart the controller
+        hw->enable=0;
+        hw->enable=1;
+        return PICO_ERROR_TIMEOUT;
+    }
+    return PICO_ERROR_GENERIC;
+}
+
+static bool i2c_bus_next(i2c_bus_t *b, i2c_xfer_t **x) {
+    for(uint32_t prio=0; prio<I2C_BUS_PRIORITIES; ++prio)
+        if(xQueueReceive(b->queue[prio], x, 0)==pdTRUE)
+            return true;
+    return false;
+}
+
+static void i2c_bus_task(void *arg) {
+    i2c_bus_t *b=(i2c_bus_t *) arg;
+    i2c_xfer_t *x;
+
+    while(1) {
+        // one notification per submit on index 0, the queues hold the work
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // re-check the high queue before every transaction
+        while(i2c_bus_next(b, &x)) {
+            uint32_t start=time_us_32();
+            x->result=i2c_bus_run(b, x);
+            uint32_t now=time_us_32();
+
+            b->busy_us+=now-start;
+            x->latency_us=now-x->queued_us;
+            if(x->latency_us>b->latency_max_us)
+                b->latency_max_us=x->latency_us;
+            b->latency_sum_us+=x->latency_us;
+            ++b->xfers;
+            if(x->result<0)
+                ++b->errors;
+
+            TaskHandle_t notify=x->notify;
+            void (*callback)(i2c_xfer_t *)=x->callback;
+            x->done=true;
+            // x may be gone once the requester sees done or is woken
+            if(callback)
+                callback(x);
+            if(notify)
+                xTaskNotifyGiveIndexed(notify, I2C_BUS_NOTIFY_INDEX);
+        }
+    }
+}
+
+bool i2c_bus_init(i2c_bus_t *b, i2c_inst_t *i2c_instance, size_t max_len, size_t depth, UBaseType_t priority) {
+    uint idx=i2c_hw_index(i2c_instance);
+
+    b->i2c_i=i2c_instance;
+    b->aborted=false;
+    b->abort_source=0;
+    b->xfers=b->errors=0;
+    b->latency_max_us=0;
+    b->latency_sum_us=0;
+    b->busy_us=0;
+    for(uint32_t prio=0; prio<I2C_BUS_PRIORITIES; ++prio)
+        b->depth_max[prio]=0;
+
+    b->cmd_size=0;
+    b->cmd=NULL;
+    for(uint32_t prio=0; prio<I2C_BUS_PRIORITIES; ++prio)
+        b->queue[prio]=NULL;
+    b->dma_tx=b->dma_rx=-1;
+    b->task=NULL;
+
+    if(i2c_bus_owner[idx]!=NULL)
+        return false;
+
+    if((b->cmd=malloc(max_len*sizeof(uint16_t)))==NULL)
+        goto failed;
+
+    for(uint32_t prio=0; prio<I2C_BUS_PRIORITIES; ++prio)
+        if((b->queue[prio]=xQueueCreate(depth, sizeof(i2c_xfer_t *)))==NULL)
+            goto failed;
+
+    b->dma_tx=dma_claim_unused_channel(false);
+    b->dma_rx=dma_claim_unused_channel(false);
+    if(b->dma_tx<0 || b->dma_rx<0)
+        goto failed;
+
+    i2c_hw_t *hw=i2c_get_hw(i2c_instance);
+
+    dma_channel_config c=dma_channel_get_default_config(b->dma_tx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c_instance, true));
+    dma_channel_configure(b->dma_tx, &c, &hw->data_cmd, b->cmd, 0, false);
+
+    c=dma_channel_get_default_config(b->dma_rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c_instance, false));
+    dma_channel_configure(b->dma_rx, &c, NULL, &hw->data_cmd, 0, false);
+
+    if(xTaskCreate(i2c_bus_task, idx?"I2C1":"I2C0", 512, b, priority, &b->task)!=pdPASS) {
+        b->task=NULL;
+        goto failed;
+    }
+
+    // submits are accepted from here on
+    b->cmd_size=max_len;
+    hw->intr_mask=0;
+    i2c_bus_owner[idx]=b;
+    irq_set_exclusive_handler(I2C0_IRQ+idx, idx?i2c_bus1_irq_handler:i2c_bus0_irq_handler);
+    irq_set_enabled(I2C0_IRQ+idx, true);
+    return true;
+
+failed:
+    // nothing half set up stays behind, submits keep failing the size check
+    if(b->dma_tx>=0)
+        dma_channel_unclaim(b->dma_tx);
+    if(b->dma_rx>=0)
+        dma_channel_unclaim(b->dma_rx);
+    b->dma_tx=b->dma_rx=-1;
+    for(uint32_t prio=0; prio<I2C_BUS_PRIORITIES; ++prio) {
+        if(b->queue[prio])
+            vQueueDelete(b->queue[prio]);
+        b->queue[prio]=NULL;
+    }
+    free(b->cmd);
+    b->cmd=NULL;
+    return false;
+}
+
+bool i2c_bus_submit(i2c_bus_t *b, i2c_xfer_t *x, i2c_bus_prio_t prio) {
+    if(x->tx_len+x->rx_len==0 || x->tx_len+x->rx_len>b->cmd_size)
+        return false;
+
+    x->done=false;
+    x->queued_us=time_us_32();
+
+    UBaseType_t depth=uxQueueMessagesWaiting(b->queue[prio])+1;
+    if(depth>b->depth_max[prio])
+        b->depth_max[prio]=depth;
+
+    if(xQueueSend(b->queue[prio], &x, 0)!=pdTRUE)
+        return false;
+    xTaskNotifyGive(b->task);
+    return true;
+}
+
+int i2c_bus_transfer(i2c_bus_t *b, uint8_t addr, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len, i2c_bus_prio_t prio) {
+    i2c_xfer_t x= {
+        .addr=addr,
+        .tx=tx,
+        .tx_len=tx_len,
+        .rx=rx,
+        .rx_len=rx_len,
+        .notify=xTaskGetCurrentTaskHandle(),
+    };
+
+    ulTaskNotifyTakeIndexed(I2C_BUS_NOTIFY_INDEX, pdTRUE, 0);
+    if(!i2c_bus_submit(b, &x, prio))
+        return PICO_ERROR_GENERIC;
+
+    // the bus task always completes, with PICO_ERROR_TIMEOUT at worst
+    while(!x.done)
+        ulTaskNotifyTakeIndexed(I2C_BUS_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+    return x.result;
+}
+
+int i2c_bus_xfer(void *bus, uint8_t addr, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    return i2c_bus_transfer((i2c_bus_t *) bus, addr, tx, tx_len, rx, rx_len, I2C_BUS_NORMAL);
+}
@@ -0,0 +1,125 @@
+/**
+* @file i2c_bus.h
+*
+* i2c bus manager: one FreeRTOS task per bus runs queued transactions with
+* dma, high priority requests first, and wakes the requester when done
+*/
+
+#ifndef _inc_i2c_bus
+#define _inc_i2c_bus
+
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+/**
+*	@brief task notification index used to signal completion to requesters
+*	(index 0 stays free for the application)
+*/
+#define I2C_BUS_NOTIFY_INDEX 1
+
+/**
+*	@brief request priority, each has its own queue
+*/
+typedef enum {
+    I2C_BUS_HIGH,
+    I2C_BUS_NORMAL,
+    I2C_BUS_PRIORITIES
+} i2c_bus_prio_t;
+
+/**
+*	@brief one transaction: write tx, then (repeated start) read rx
+*
+*	tx_len==0 is a plain read, rx_len==0 a plain write. Owned by the caller
+*	and must stay valid until done is set.
+*/
+typedef struct i2c_xfer {
+    uint8_t addr;		/**< 7 bit device address */
+    const uint8_t *tx;	/**< bytes to write */
+    size_t tx_len;
+    uint8_t *rx;		/**< destination of read bytes */
+    size_t rx_len;
+    TaskHandle_t notify;	/**< task to notify on I2C_BUS_NOTIFY_INDEX when done, may be NULL */
+    void (*callback)(struct i2c_xfer *x);	/**< called from the bus task when done, may be NULL */
+    void *arg;			/**< for callback */
+    volatile bool done;	/**< set once result is valid */
+    int result;			/**< bytes transferred or PICO_ERROR_* */
+    uint32_t queued_us;	/**< time the request was queued */
+    uint32_t latency_us;	/**< queued to done */
+} i2c_xfer_t;
+
+/**
+*	@brief bus state and statistics
+*/
+typedef struct {
+    i2c_inst_t *i2c_i;
+    QueueHandle_t queue[I2C_BUS_PRIORITIES];	/**< pending i2c_xfer_t pointers */
+    TaskHandle_t task;	/**< bus task */
+    int dma_tx, dma_rx;	/**< claimed dma channels */
+    uint16_t *cmd;		/**< data_cmd words of the running transaction */
+    size_t cmd_size;	/**< capacity of cmd (max tx_len+rx_len) */
+    volatile bool aborted;	/**< set by the irq on TX_ABRT */
+    uint32_t abort_source;	/**< TX_ABRT_SOURCE of the last abort */
+    uint32_t xfers;		/**< transactions completed */
+    uint32_t errors;	/**< transactions that failed (nack, timeout) */
+    uint32_t latency_max_us;	/**< worst queued to done time */
+    uint64_t latency_sum_us;	/**< for the average */
+    uint32_t busy_us;	/**< time spent on the wire */
+    uint32_t depth_max[I2C_BUS_PRIORITIES];	/**< deepest queue seen at submit */
+} i2c_bus_t;
+
+/**
+*	@brief take over an initialized i2c instance and start its bus task
+*
+*	From here on the instance must only be used through the manager. On
+*	failure nothing stays allocated or claimed, every submit fails and the
+*	instance is still free for the blocking SDK calls.
+*
+*	@param[in] b : bus state
+*	@param[in] i2c_instance : bus, already set up with i2c_init
+*	@param[in] max_len : longest transaction (tx_len+rx_len)
+*	@param[in] depth : entries per priority queue
+*	@param[in] priority : FreeRTOS priority of the bus task
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool i2c_bus_init(i2c_bus_t *b, i2c_inst_t *i2c_instance, size_t max_len, size_t depth, UBaseType_t priority);
+
+/**
+*	@brief queue a transaction and return immediately
+*
+*	@param[in] b : bus
+*	@param[in] x : transaction, addr/tx/rx/notify/callback filled in
+*	@param[in] prio : queue to use
+*
+*	@return bool.
+*	@retval false if the queue is full or the transaction too long
+*/
+bool i2c_bus_submit(i2c_bus_t *b, i2c_xfer_t *x, i2c_bus_prio_t prio);
+
+/**
+*	@brief queue a transaction and block the calling task until it is done
+*
+*	@param[in] b : bus
+*	@param[in] addr : device address
+*	@param[in] tx : bytes to write
+*	@param[in] tx_len : number of bytes to write
+*	@param[out] rx : read destination
+*	@param[in] rx_len : number of bytes to read
+*	@param[in] prio : queue to use
+*
+*	@return bytes transferred or PICO_ERROR_*
+*/
+int i2c_bus_transfer(i2c_bus_t *b, uint8_t addr, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len, i2c_bus_prio_t prio);
+
+/**
+*	@brief i2c_bus_transfer at normal priority with a void * bus, for drivers
+*	that take a transfer function (see mpu6050_set_xfer)
+*/
+int i2c_bus_xfer(void *bus, uint8_t addr, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+
+#endif
@@ -0,0 +1,195 @@
+/**
+* @file i2c_topology.c
+*
+* i2c topology cache in flash
+*/
+
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <hardware/gpio.h>
+#include <hardware/flash.h>
+#include <hardware/sync.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "i2c_topology.h"
+
+#define I2C_TOPOLOGY_MAGIC 0x54324349u	// "IC2T"
+// last sector of the flash, far above the program image
+#define I2C_TOPOLOGY_OFFSET (PICO_FLASH_SIZE_BYTES-FLASH_SECTOR_SIZE)
+#define I2C_TOPOLOGY_PROBE_HZ 100000
+#define I2C_TOPOLOGY_TIMEOUT_US 5000
+
+_Static_assert(sizeof(i2c_topology_t)<=FLASH_PAGE_SIZE, "topology must fit one flash page");
+
+typedef struct {
+    uint8_t bus, sda, scl;
+} i2c_topology_pins_t;
+
+// same pin pairs as i2c_scanner.c (14/15 is the OLED and never probed)
+static const i2c_topology_pins_t i2c_topology_pins[]= {
+    {0, 0, 1}, {0, 4, 5}, {0, 8, 9}, {0, 12, 13}, {0, 16, 17}, {0, 20, 21},
+    {1, 2, 3}, {1, 6, 7}, {1, 10, 11}, {1, 18, 19}, {1, 26, 27},
+};
+
+static uint32_t i2c_topology_crc32(const void *data, size_t len) {
+    const uint8_t *p=data;
+    uint32_t crc=0xFFFFFFFFu;
+
+    while(len--) {
+        crc^=*p++;
+        for(uint32_t bit=0; bit<8; ++bit)
+            crc=(crc>>1)^(0xEDB88320u&-(crc&1));
+    }
+    return ~crc;
+}
+
+static void i2c_topology_attach(uint8_t bus, uint8_t sda, uint8_t scl) {
+    gpio_set_function(sda, GPIO_FUNC_I2C);
+    gpio_set_function(scl, GPIO_FUNC_I2C);
+    gpio_pull_up(sda);
+    gpio_pull_up(scl);
+    i2c_init(bus?i2c1:i2c0, I2C_TOPOLOGY_PROBE_HZ);
+}
+
+static void i2c_topology_detach(uint8_t bus, uint8_t sda, uint8_t scl) {
+    i2c_deinit(bus?i2c1:i2c0);
+    // back to high-Z sio inputs, whatever else sits on these pins
+    gpio_init(sda);
+    gpio_init(scl);
+    gpio_disable_pulls(sda);
+    gpio_disable_pulls(scl);
+}
+
+static bool i2c_topology_read_reg(i2c_inst_t *i2c, uint8_t addr, uint8_t reg, uint8_t *val) {
+    return i2c_write_timeout_us(i2c, addr, &reg, 1, true, I2C_TOPOLOGY_TIMEOUT_US)==1
+        && i2c_read_timeout_us(i2c, addr, val, 1, false, I2C_TOPOLOGY_TIMEOUT_US)==1;
+}
+
+// one targeted read per address: the id register where the type has one
+static i2c_dev_type_t i2c_topology_identify(i2c_inst_t *i2c, uint8_t addr) {
+    uint8_t id;
+
+    switch(addr) {
+        case 0x68:
+        case 0x69:
+            if(i2c_topology_read_reg(i2c, addr, 0x75, &id) && id==0x68)
+                return I2C_DEV_MPU6050;
+            break;
+        case 0x76:
+        case 0x77:
+            if(i2c_topology_read_reg(i2c, addr, 0xD0, &id)) {
+                if(id==0x58)
+                    return I2C_DEV_BMP280;
+                if(id==0x60)
+                    return I2C_DEV_BME280;
+            }
+            break;
+        case 0x23:
+        case 0x5C:
+            return I2C_DEV_BH1750;
+    }
+    return I2C_DEV_UNKNOWN;
+}
+
+bool i2c_topology_load(i2c_topology_t *t) {
+    memcpy(t, (const void *) (XIP_BASE+I2C_TOPOLOGY_OFFSET), sizeof(*t));
+
+    return t->magic==I2C_TOPOLOGY_MAGIC
+        && t->version==I2C_TOPOLOGY_VERSION
+        && t->count<=I2C_TOPOLOGY_MAX
+        && t->crc==i2c_topology_crc32(t, offsetof(i2c_topology_t, crc));
+}
+
+bool i2c_topology_save(i2c_topology_t *t) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+
+    t->magic=I2C_TOPOLOGY_MAGIC;
+    t->version=I2C_TOPOLOGY_VERSION;
+    t->crc=i2c_topology_crc32(t, offsetof(i2c_topology_t, crc));
+
+    // no erase cycle if nothing changed
+    if(!memcmp((const void *) (XIP_BASE+I2C_TOPOLOGY_OFFSET), t, sizeof(*t)))
+        return true;
+
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, t, sizeof(*t));
+
+    uint32_t ints=save_and_disable_interrupts();
+    flash_range_erase(I2C_TOPOLOGY_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(I2C_TOPOLOGY_OFFSET, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+
+    return !memcmp((const void *) (XIP_BASE+I2C_TOPOLOGY_OFFSET), t, sizeof(*t));
+}
+
+size_t i2c_topology_scan(i2c_topology_t *t, uint32_t skip_pins, uint8_t skip_addr) {
+    memset(t, 0, sizeof(*t));
+
+    for(size_t i=0; i<sizeof(i2c_topology_pins)/sizeof(i2c_topology_pins[0]); ++i) {
+        const i2c_topology_pins_t *p=&i2c_topology_pins[i];
+        if(skip_pins&((1u<<p->sda)|(1u<<p->scl)))
+            continue;
+
+        i2c_topology_attach(p->bus, p->sda, p->scl);
+        i2c_inst_t *i2c=p->bus?i2c1:i2c0;
+
+        for(uint8_t addr=0x08; addr<0x78 && t->count<I2C_TOPOLOGY_MAX; ++addr) {
+            uint8_t rx;
+            if(addr==skip_addr || i2c_read_timeout_us(i2c, addr, &rx, 1, false, I2C_TOPOLOGY_TIMEOUT_US)<0)
+                continue;
+
+            i2c_dev_t *d=&t->dev[t->count++];
+            d->bus=p->bus;
+            d->sda=p->sda;
+            d->scl=p->scl;
+            d->addr=addr;
+            d->type=i2c_topology_identify(i2c, addr);
+        }
+
+        i2c_topology_detach(p->bus, p->sda, p->scl);
+    }
+    return t->count;
+}
+
+bool i2c_topology_validate(const i2c_topology_t *t) {
+    bool ok=true;
+
+    for(uint16_t i=0; i<t->count && ok; ++i) {
+        const i2c_dev_t *d=&t->dev[i];
+        i2c_topology_attach(d->bus, d->sda, d->scl);
+        i2c_inst_t *i2c=d->bus?i2c1:i2c0;
+
+        if(d->type==I2C_DEV_UNKNOWN || d->type==I2C_DEV_BH1750) {
+            uint8_t rx;
+            ok=i2c_read_timeout_us(i2c, d->addr, &rx, 1, false, I2C_TOPOLOGY_TIMEOUT_US)==1;
+        } else {
+            ok=i2c_topology_identify(i2c, d->addr)==d->type;
+        }
+
+        i2c_topology_detach(d->bus, d->sda, d->scl);
+    }
+    return ok;
+}
+
+i2c_topology_source_t i2c_topology_boot(i2c_topology_t *t, uint32_t skip_pins, uint8_t skip_addr) {
+    // an empty map is valid too: a board without sensors is not rescanned
+    if(i2c_topology_load(t) && i2c_topology_validate(t))
+        return I2C_TOPOLOGY_CACHED;
+
+    i2c_topology_scan(t, skip_pins, skip_addr);
+    return i2c_topology_save(t)?I2C_TOPOLOGY_RESCANNED:I2C_TOPOLOGY_FAILED;
+}
+
+const i2c_dev_t *i2c_topology_find(const i2c_topology_t *t, i2c_dev_type_t type) {
+    for(uint16_t i=0; i<t->count; ++i)
+        if(t->dev[i].type==type)
+            return &t->dev[i];
+    return NULL;
+}
+
+const char *i2c_topology_type_name(i2c_dev_type_t type) {
+    static const char *const names[I2C_DEV_TYPES]= {"unknown", "MPU6050", "BH1750", "BMP280", "BME280"};
+
+    return type<I2C_DEV_TYPES?names[type]:"?";
+}
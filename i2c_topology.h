@@ -0,0 +1,143 @@
+/**
+* @file i2c_topology.h
+*
+* i2c topology cache: which device type sits at which bus, pins and address.
+* A full probe of every pin pair runs once; the result is kept in the last
+* flash sector with a CRC and later boots only confirm each device with one
+* targeted read
+*/
+
+#ifndef _inc_i2c_topology
+#define _inc_i2c_topology
+
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+
+/**
+*	@brief most devices in the cache
+*/
+#define I2C_TOPOLOGY_MAX 16
+
+/**
+*	@brief layout version, bump when i2c_topology_t changes
+*/
+#define I2C_TOPOLOGY_VERSION 1
+
+/**
+*	@brief device types the probe recognizes
+*/
+typedef enum {
+    I2C_DEV_UNKNOWN,	/**< acknowledged, nothing to identify it by */
+    I2C_DEV_MPU6050,	/**< WHO_AM_I (0x75) reads 0x68 */
+    I2C_DEV_BH1750,		/**< 0x23 or 0x5C, no id register */
+    I2C_DEV_BMP280,		/**< chip id (0xD0) reads 0x58 */
+    I2C_DEV_BME280,		/**< chip id (0xD0) reads 0x60 */
+    I2C_DEV_TYPES
+} i2c_dev_type_t;
+
+/**
+*	@brief one device
+*/
+typedef struct {
+    uint8_t bus;	/**< i2c instance, 0 or 1 */
+    uint8_t sda;	/**< gpio */
+    uint8_t scl;	/**< gpio */
+    uint8_t addr;	/**< 7 bit address */
+    uint8_t type;	/**< i2c_dev_type_t */
+} i2c_dev_t;
+
+/**
+*	@brief the cache, as stored in flash
+*/
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;		/**< valid entries in dev */
+    i2c_dev_t dev[I2C_TOPOLOGY_MAX];
+    uint32_t crc;		/**< crc32 of everything before it */
+} i2c_topology_t;
+
+/**
+*	@brief how i2c_topology_boot got its map
+*/
+typedef enum {
+    I2C_TOPOLOGY_CACHED,	/**< flash copy confirmed by targeted reads */
+    I2C_TOPOLOGY_RESCANNED,	/**< no valid copy or a device did not answer: probed and saved */
+    I2C_TOPOLOGY_FAILED		/**< probed, but the flash write failed */
+} i2c_topology_source_t;
+
+/**
+*	@brief read the flash copy
+*
+*	@param[out] t : topology
+*
+*	@return bool.
+*	@retval false if there is no copy or its magic, version or crc is wrong
+*/
+bool i2c_topology_load(i2c_topology_t *t);
+
+/**
+*	@brief write the topology (crc filled in) to the reserved sector
+*
+*	Erasing and programming stop XIP: call it before the scheduler starts,
+*	before cyw43 is up and with core 1 idle. Skips the write if flash already
+*	holds the same map.
+*
+*	@param[in] t : topology
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool i2c_topology_save(i2c_topology_t *t);
+
+/**
+*	@brief probe every pin pair and address
+*
+*	Each pin pair is set up at 100 kHz and reset to high-Z inputs afterwards.
+*
+*	@param[out] t : topology
+*	@param[in] skip_pins : bit mask of gpios in use elsewhere, pairs touching
+*	them are not probed
+*	@param[in] skip_addr : address to leave out (e.g. the display), 0 for none
+*
+*	@return number of devices found
+*/
+size_t i2c_topology_scan(i2c_topology_t *t, uint32_t skip_pins, uint8_t skip_addr);
+
+/**
+*	@brief confirm every cached device with one targeted read
+*
+*	@param[in] t : topology
+*
+*	@return bool.
+*	@retval false if a device did not answer or reported another id
+*/
+bool i2c_topology_validate(const i2c_topology_t *t);
+
+/**
+*	@brief load and validate, or scan and save
+*
+*	@param[out] t : topology
+*	@param[in] skip_pins : see i2c_topology_scan
+*	@param[in] skip_addr : see i2c_topology_scan
+*
+*	@return where the map came from
+*/
+i2c_topology_source_t i2c_topology_boot(i2c_topology_t *t, uint32_t skip_pins, uint8_t skip_addr);
+
+/**
+*	@brief first device of a type
+*
+*	@param[in] t : topology
+*	@param[in] type : device type
+*
+*	@return device or NULL
+*/
+const i2c_dev_t *i2c_topology_find(const i2c_topology_t *t, i2c_dev_type_t type);
+
+/**
+*	@brief printable device type
+*/
+const char *i2c_topology_type_name(i2c_dev_type_t type);
+
+#endif
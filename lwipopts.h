@@ -35,6 +35,9 @@
 #define TCP_MSS 1460
 #define TCP_SND_BUF (8 * TCP_MSS)
 #define TCP_SND_QUEUELEN ((4 * (TCP_SND_BUF) + (TCP_MSS - 1)) / (TCP_MSS))
+// Socket timeouts, so a silent keep-alive peer cannot block the WiFi task
+#define LWIP_SO_RCVTIMEO 1
+#define LWIP_SO_SNDTIMEO 1
 
 // Protocols
 #define LWIP_ARP 1
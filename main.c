@@ -5,14 +5,18 @@
  * FIXED: Wrapper Functions for Logic
  */
 
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "hardware/adc.h"
+#include "hardware/clocks.h"
 #include "hardware/i2c.h"
 #include "hardware/pwm.h"
 #include "pico/cyw43_arch.h"
+#include "pico/rand.h"
 #include "pico/stdlib.h"
 
 #include "FreeRTOS.h"
@@ -23,7 +27,23 @@
 #include "lwip/api.h"
 #include "lwip/sockets.h"
 
+#include "adc_capture.h"
+#include "batch.h"
+#include "dsp.h"
+#include "fft.h"
+#include "fir_taps.h"
+#include "frame.h"
+#include "http_conn.h"
+#include "i2c_bus.h"
+#include "i2c_topology.h"
+#include "img_wifi.h"
+#include "mpu6050.h"
+#include "oled_ui.h"
+#include "report_filter.h"
+#include "sensor_frame.h"
+#include "sensor_sched.h"
 #include "ssd1306.h"
+#include "udp_tx.h"
 #include "ws2812.pio.h"
 
 // --- CONFIGURATION ---
@@ -32,6 +52,32 @@
 #define SERVER_IP "192.168.1.11"
 #define SERVER_PORT 5001
 #define HTTP_PATH "/submit_data"
+#define HTTP_PATH_SPECTRUM "/submit_spectrum"
+#define HTTP_PATH_BATCH "/submit_batch"
+#define HTTP_TIMEOUT_MS 3000 // per send/recv on the kept-alive socket
+#define WIFI_STATS_EVERY 10  // print statistics every n requests/datagrams
+#define WIFI_BODY_SIZE 704   // one JSON message, worst case ~630 bytes
+// Samples as packed frames (frame.h); 0 goes back to JSON bodies
+#define TELEMETRY_BINARY 1
+#define WIFI_BENCH_RUNS 16 // encodes per format in the periodic benchmark
+// A batch is posted at whichever limit comes first; samples arrive every
+// REPORT_MS at most, so BATCH_MAX_AGE_MS bounds how stale the dashboard gets
+#define BATCH_MAX_SAMPLES 10
+#define BATCH_MAX_BYTES BATCH_BUF_SIZE
+#define BATCH_MAX_AGE_MS 10000
+// Samples as sequence-numbered UDP datagrams (udp_tx.h) instead of HTTP
+// batches: no handshake or retries, losses are counted by the server.
+// Needs TELEMETRY_BINARY; spectra stay on HTTP.
+#define TELEMETRY_UDP 0
+#define UDP_PORT 5002
+#define UDP_MAX_SAMPLES 4    // frames per datagram
+#define UDP_MAX_AGE_MS 1000
+#if TELEMETRY_UDP && !TELEMETRY_BINARY
+#error "TELEMETRY_UDP sends frames, it needs TELEMETRY_BINARY"
+#endif
+// Boot diagnostics as a scrolling console on the OLED instead of the
+// four-line status screen
+// #define VERBOSE_BOOT
 
 // --- PINOUT ---
 #define SDA_OLED 14
@@ -41,43 +87,226 @@
 #define MPU6050_ADDR 0x68
 #define BH1750_ADDR 0x23
 #define OLED_ADDR 0x3C
+// Sensor bus when the topology cache finds nothing better
+#define SDA_SENSORS 0
+#define SCL_SENSORS 1
+// Pins the topology probe must not drive: OLED, LED matrix, buzzer, MPU INT
+#define TOPOLOGY_SKIP_PINS                                                     \
+  ((1u << SDA_OLED) | (1u << SCL_OLED) | (1u << LED_PIN) |                     \
+   (1u << BUZZER_PIN) | (1u << MPU_INT_PIN))
+
+// --- ACQUISITION ---
+#define MPU_RATE_HZ 1000
+#define MPU_DLPF 2 // 94 Hz bandwidth
+#define MPU_DRAIN_MS 50 // FIFO holds 73 14-byte samples
+#define MPU_INT_PIN 18 // MPU6050 INT, data ready pulse at MPU_RATE_HZ
+#define REPORT_MS 2000
+// 1 kHz -> 100 Hz through fir_imu_lowpass (35 Hz cutoff), features over the
+// decimated REPORT_MS window
+#define IMU_DECIM 10
+#define IMU_AXES 6
+// Vibration spectrum of the raw 1 kHz accelerometer, power of the three axes
+// summed, averaged over the windows of one report
+#define VIB_FFT_N 512
+#define VIB_BANDS 6
+#define VIB_PEAKS 3
+// BH1750 one-time H-resolution mode: up to 180 ms per conversion, the sensor
+// powers down afterwards
+#define BH1750_ONE_TIME_H 0x20
+#define BH1750_CONVERSION_MS 180
+#define BH1750_PERIOD_MS 500
+#define RSSI_PERIOD_MS 10000
+// Scheduler buses: channels on the same one never run in the same pass
+#define SCHED_BUS_I2C0 0
+#define SCHED_BUS_CYW43 1
+// Microphone on GP28 (ADC2) and the die temperature sensor in ADC round
+// robin: 20 kHz each, 25.6 ms per DMA buffer
+#define MIC_ADC_INPUT 2
+#define ADC_RATE_HZ 40000
+#define ADC_BLOCK 1024
+#define ADC_TASK_PRIORITY 4
+
+// --- REPORTING ---
+// Report by exception: a sensor record (and the spectrum with it) is only
+// sent when a channel moved past its deadband or after heartbeat_s of
+// silence. The server can replace these defaults in its /submit_data reply.
+typedef enum {
+  RPT_LUX,
+  RPT_TEMP,
+  RPT_TEMP_MPU,
+  RPT_AX,
+  RPT_AY,
+  RPT_AZ,
+  RPT_GX,
+  RPT_GY,
+  RPT_GZ,
+  RPT_VIB,
+  RPT_SOUND,
+  RPT_CHANNELS
+} report_channel_t;
+
+typedef struct {
+  int32_t lux, temp, accel, gyro, vib, sound; // deadbands, sensor_data_t units
+  int32_t hyst_pct;                    // hysteresis, % of the deadband
+  uint32_t heartbeat_s;
+} report_config_t;
+
+static report_filter_t report_filter;
+static report_config_t report_cfg = {.lux = 1000, // 10 lux
+                                     .temp = 20,  // 0.2 C
+                                     .accel = 300, // ~0.02 g
+                                     .gyro = 100,  // ~0.8 deg/s
+                                     .vib = 50,
+                                     .sound = 300, // 3 dB
+                                     .hyst_pct = 50,
+                                     .heartbeat_s = 60};
+// written by the WiFi task, picked up by the sensor task at its next report
+static report_config_t report_cfg_new;
+static volatile bool report_cfg_pending;
+
+// Integer conversions (hundredths), the M0+ has no FPU
+#define BH1750_CENTILUX(raw) ((int32_t)(raw) * 250 / 3) // raw / 1.2
+// 27 - (V - 0.706) / 0.001721, V in uV from the oversampled 12-bit ADC
+// reading (Q8) at 3.3 V
+#define RP2040_TEMP_CENTI(adc_q8)                                              \
+  (2700 - (int32_t)((((int64_t)(adc_q8) * 3300000 >> 20) - 706000) * 100 /    \
+                    1721))
+#define CENTI_FMT "%s%ld.%02ld"
+#define CENTI_ARGS(v)                                                          \
+  ((v) < 0 ? "-" : ""), (long)(labs(v) / 100), (long)(labs(v) % 100)
+// i2c0 is shared by the sensors through the bus manager task, which must not
+// be starved by its users
+#define I2C0_BUS_PRIORITY 4
 
 // --- GLOBALS ---
 ssd1306_t disp;
 static PIO led_pio = NULL;
 static int led_sm = -1;
 QueueHandle_t xSensorQueue;
+static i2c_bus_t i2c0_bus;
+static bool i2c0_managed; // bus manager up, else blocking SDK calls
+// Where the sensors are, from the topology cache (defaults if not found)
+static i2c_topology_t i2c_topo;
+static uint8_t mpu_addr = MPU6050_ADDR, bh1750_addr = BH1750_ADDR;
+static mpu6050_t mpu;
+static adc_capture_t adc_cap;
+static bool adc_cap_ok; // else one blocking temperature read per report
+static mpu6050_sample_t mpu_ring[256];
+static TaskHandle_t xSensorTask;
+
+// Data-ready edges are counted in the ISR, the sensor task is notified once
+// per MPU_DRAIN_MS worth of samples so it drains full FIFO batches
+static volatile uint32_t mpu_irq_count, mpu_irq_us;
+
+typedef struct {
+  uint32_t n, lat_min, lat_max, lat_sum, jit_max, last_wake;
+} wake_stats_t;
+static wake_stats_t wake_stats;
+
+// Filter state and window sums of ax, ay, az, gx, gy, gz
+static const uint8_t imu_offset[IMU_AXES] = {
+    offsetof(mpu6050_sample_t, ax), offsetof(mpu6050_sample_t, ay),
+    offsetof(mpu6050_sample_t, az), offsetof(mpu6050_sample_t, gx),
+    offsetof(mpu6050_sample_t, gy), offsetof(mpu6050_sample_t, gz)};
+static dsp_fir_t imu_fir[IMU_AXES];
+static dsp_window_t imu_win[IMU_AXES];
+
+static const uint16_t vib_band_edges[VIB_BANDS + 1] = {0,   10,  25, 50,
+                                                       100, 200, 501};
+static int16_t vib_buf[VIB_FFT_N][3];
+static size_t vib_fill;
+static fft_spectrum_t vib_spec;
+static uint32_t vib_fft_us, vib_fft_max_us;
 
 typedef struct {
-  float lux;
-  float temp_chip;
-  int ax, ay, az;
-  int32_t rssi;
   uint32_t uptime_sec;
-} sensor_data_t;
+  uint16_t fs_hz, n, windows;
+  uint8_t npeaks;
+  uint32_t fft_cycles; // worst window (three transforms) in the report
+  uint32_t bands[VIB_BANDS]; // rms per band, raw LSB
+  fft_peak_t peaks[VIB_PEAKS];
+} spectrum_data_t;
+
+// Everything the sensor task hands to the WiFi task
+typedef enum { MSG_SENSOR, MSG_SPECTRUM } msg_type_t;
+typedef struct {
+  msg_type_t type;
+  union {
+    sensor_data_t sensor;
+    spectrum_data_t spectrum;
+  };
+} telemetry_msg_t;
 
 static const uint8_t BMP_OK[25] = {0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 0, 1,
                                    0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0};
 
 SemaphoreHandle_t xOledMutex;
+static TaskHandle_t xDisplayTask;
+static uint32_t oled_lock_us, oled_lock_max_us;
 
-static void safe_oled_print(const char *line1, const char *line2,
-                            const char *line3, const char *line4) {
+// Retained screen: four text lines and the Wi-Fi icon. Lines only redraw
+// when their text changes, the sensor lines only the characters that did.
+static oled_ui_t ui;
+static oled_widget_t ui_widgets[5];
+static oled_widget_t *ui_line[4], *ui_icon;
+
+// The display is double buffered: producers draw into the back buffer
+// without the lock, xOledMutex only covers the swap (and the transmitter
+// queueing the front buffer for DMA).
+static void oled_lock_release(uint32_t taken_us) {
+  oled_lock_us = time_us_32() - taken_us;
+  if (oled_lock_us > oled_lock_max_us)
+    oled_lock_max_us = oled_lock_us;
+  xSemaphoreGive(xOledMutex);
+}
+
+static void oled_present() {
   if (xOledMutex && xSemaphoreTake(xOledMutex, portMAX_DELAY) == pdTRUE) {
-    ssd1306_clear(&disp);
-    if (line1)
-      ssd1306_draw_string(&disp, 0, 0, 1, line1);
-    if (line2)
-      ssd1306_draw_string(&disp, 0, 16, 1, line2);
-    if (line3)
-      ssd1306_draw_string(&disp, 0, 32, 1, line3);
-    if (line4)
-      ssd1306_draw_string(&disp, 0, 48, 1, line4);
-    ssd1306_show(&disp);
-    xSemaphoreGive(xOledMutex);
+    uint32_t taken = time_us_32();
+    ssd1306_swap(&disp);
+    oled_lock_release(taken);
+    xTaskNotifyGive(xDisplayTask);
   }
 }
 
+static void oled_ui_setup() {
+  oled_ui_init(&ui, &disp, ui_widgets, 5);
+  ui_line[0] = oled_ui_add_text(&ui, OLED_UI_LABEL, 0, 0, 1, NULL);
+  ui_line[1] = oled_ui_add_text(&ui, OLED_UI_LABEL, 0, 16, 1, NULL);
+  ui_line[2] = oled_ui_add_text(&ui, OLED_UI_VALUE, 0, 32, 1, NULL);
+  ui_line[3] = oled_ui_add_text(&ui, OLED_UI_VALUE, 0, 48, 1, NULL);
+  ui_icon = oled_ui_add_icon(&ui, 112, 0, NULL);
+}
+
+static void safe_oled_print(const char *line1, const char *line2,
+                            const char *line3, const char *line4) {
+  oled_ui_set_text(ui_line[0], line1);
+  oled_ui_set_text(ui_line[1], line2);
+  oled_ui_set_text(ui_line[2], line3);
+  oled_ui_set_text(ui_line[3], line4);
+  if (oled_ui_render(&ui))
+    oled_present();
+}
+
+static void safe_oled_icon(const ssd1306_image_t *img) {
+  oled_ui_set_icon(ui_icon, img);
+  if (oled_ui_render(&ui))
+    oled_present();
+}
+
+#ifdef VERBOSE_BOOT
+static void oled_log(const char *format, ...) {
+  char line[24];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  printf("%s\n", line);
+  ssd1306_console_print(&disp, line);
+  oled_present();
+}
+#endif
+
 static void led_draw(const uint8_t *bmp, uint8_t r, uint8_t g, uint8_t b) {
   if (led_pio == NULL)
     return;
@@ -127,112 +356,722 @@ static void buzzer_beep(int freq, int ms) {
   }
 }
 
+static void mpu_int_callback(uint gpio, uint32_t events) {
+  if (gpio != MPU_INT_PIN)
+    return;
+  if (++mpu_irq_count < MPU_RATE_HZ * MPU_DRAIN_MS / 1000)
+    return;
+  mpu_irq_count = 0;
+  mpu_irq_us = time_us_32();
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(xSensorTask, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+// latency: notifying edge to task running; jitter: wake interval vs period
+static void wake_stats_add(wake_stats_t *w, uint32_t irq_us, uint32_t now) {
+  uint32_t lat = now - irq_us;
+  if (w->n == 0 || lat < w->lat_min)
+    w->lat_min = lat;
+  if (lat > w->lat_max)
+    w->lat_max = lat;
+  w->lat_sum += lat;
+  if (w->n > 0) {
+    int32_t jit = (int32_t)(now - w->last_wake) - MPU_DRAIN_MS * 1000;
+    if (jit < 0)
+      jit = -jit;
+    if ((uint32_t)jit > w->jit_max)
+      w->jit_max = jit;
+  }
+  w->last_wake = now;
+  w->n++;
+}
+
+static void report_config_apply(const report_config_t *c) {
+  const int32_t deadband[RPT_CHANNELS] = {
+      c->lux,   c->temp,  c->temp,  c->accel, c->accel,
+      c->accel, c->gyro,  c->gyro,  c->gyro,  c->vib,   c->sound};
+  for (int i = 0; i < RPT_CHANNELS; i++)
+    report_filter_set(&report_filter, i, deadband[i],
+                      deadband[i] * c->hyst_pct / 100);
+  report_filter.heartbeat_ms = c->heartbeat_s * 1000;
+}
+
+// "config":"lux=1000,temp=20,accel=300,gyro=100,vib=50,sound=300,hyst=50,
+// hb=60" in the server reply; keys may be missing, unknown ones are skipped.
+// Limits keep deadband * hyst / 100 and hb * 1000 in range, any value past
+// them rejects the whole reply
+#define RPT_DEADBAND_MAX (INT32_MAX / RPT_HYST_MAX)
+#define RPT_HYST_MAX 100
+#define RPT_HEARTBEAT_MAX_S 86400
+static bool report_config_parse(const char *reply, report_config_t *c) {
+  const char *p = strstr(reply, "\"config\":");
+  if (!p)
+    return false;
+  // Flask pretty-prints in debug mode: "config": "..."
+  for (p += 9; *p == ' ';)
+    p++;
+  if (*p++ != '"')
+    return false;
+  while (*p && *p != '"') {
+    char key[8];
+    long v;
+    int used;
+    if (sscanf(p, "%7[a-z]=%9ld%n", key, &v, &used) != 2 || v < 0)
+      return false;
+    long max = RPT_DEADBAND_MAX;
+    if (!strcmp(key, "hyst"))
+      max = RPT_HYST_MAX;
+    else if (!strcmp(key, "hb"))
+      max = RPT_HEARTBEAT_MAX_S;
+    if (v > max)
+      return false;
+    if (!strcmp(key, "lux"))
+      c->lux = v;
+    else if (!strcmp(key, "temp"))
+      c->temp = v;
+    else if (!strcmp(key, "accel"))
+      c->accel = v;
+    else if (!strcmp(key, "gyro"))
+      c->gyro = v;
+    else if (!strcmp(key, "vib"))
+      c->vib = v;
+    else if (!strcmp(key, "sound"))
+      c->sound = v;
+    else if (!strcmp(key, "hyst"))
+      c->hyst_pct = v;
+    else if (!strcmp(key, "hb"))
+      c->heartbeat_s = v;
+    p += used;
+    if (*p == ',')
+      p++;
+  }
+  return true;
+}
+
+static const char *const report_reason_name[] = {"suppressed", "first",
+                                                 "change", "heartbeat"};
+
+// --- ACQUISITION CHANNELS ---
+// Each runs from the scheduler at its own rate; results collect in
+// sensor_data until the report channel sends them
+static sensor_data_t sensor_data;
+static uint32_t mpu_window; // samples since the last report
+
+static bool sched_mpu_read(void *arg) {
+  static mpu6050_sample_t samples[32];
+  bool ok = mpu6050_fifo_drain(&mpu) >= 0;
+  if (!ok)
+    printf("MPU FIFO drain failed\n");
+  size_t n;
+  while ((n = mpu6050_read_samples(&mpu, samples, 32)) > 0) {
+    for (int i = 0; i < IMU_AXES; i++) {
+      int16_t out[32 / IMU_DECIM + 1];
+      const int16_t *in =
+          (const int16_t *)((const uint8_t *)samples + imu_offset[i]);
+      size_t m =
+          dsp_fir_decimate(&imu_fir[i], in, n, DSP_STRIDE(samples[0]), out);
+      dsp_window_add(&imu_win[i], out, m);
+    }
+    sensor_data.temp_mpu = mpu6050_temp_centi(samples[n - 1].temp);
+    mpu_window += n;
+    for (size_t i = 0; i < n; i++) {
+      vib_buf[vib_fill][0] = samples[i].ax;
+      vib_buf[vib_fill][1] = samples[i].ay;
+      vib_buf[vib_fill][2] = samples[i].az;
+      if (++vib_fill < VIB_FFT_N)
+        continue;
+      vib_fill = 0;
+      uint32_t t0 = time_us_32();
+      for (int axis = 0; axis < 3; axis++)
+        fft_spectrum_add(&vib_spec, &vib_buf[0][axis], 3);
+      fft_spectrum_next_window(&vib_spec);
+      vib_fft_us = time_us_32() - t0;
+      if (vib_fft_us > vib_fft_max_us)
+        vib_fft_max_us = vib_fft_us;
+    }
+  }
+  return ok;
+}
+
+// i2c0 through the bus manager, or the blocking SDK calls if it failed
+static int i2c0_xfer(uint8_t addr, const uint8_t *tx, size_t tx_len,
+                     uint8_t *rx, size_t rx_len) {
+  if (i2c0_managed)
+    return i2c_bus_transfer(&i2c0_bus, addr, tx, tx_len, rx, rx_len,
+                            I2C_BUS_NORMAL);
+  int n = tx_len ? i2c_write_blocking(i2c0, addr, tx, tx_len, rx_len > 0) : 0;
+  if (n < 0 || !rx_len)
+    return n;
+  int r = i2c_read_blocking(i2c0, addr, rx, rx_len, false);
+  return r < 0 ? r : n + r;
+}
+
+// BH1750 one-time H-resolution: the scheduler starts the conversion
+// BH1750_CONVERSION_MS ahead of the read
+static bool sched_bh1750_start(void *arg) {
+  uint8_t bh_cmd = BH1750_ONE_TIME_H;
+  return i2c0_xfer(bh1750_addr, &bh_cmd, 1, NULL, 0) == 1;
+}
+
+static bool sched_bh1750_read(void *arg) {
+  uint8_t lux_raw[2];
+  if (i2c0_xfer(bh1750_addr, NULL, 0, lux_raw, 2) != 2) {
+    sensor_data.lux = 0;
+    return false;
+  }
+  sensor_data.lux = BH1750_CENTILUX((lux_raw[0] << 8) | lux_raw[1]);
+  return true;
+}
+
+// Sound level and oversampled die temperature from the ADC capture, once
+// per report so Leq covers the whole interval
+static bool sched_sound_read(void *arg) {
+  adc_capture_result_t adc;
+  bool ok = adc_capture_read(&adc_cap, &adc);
+  if (!adc_cap_ok) {
+    adc_select_input(ADC_CAPTURE_TEMP_INPUT);
+    adc.temp_q8 = (uint32_t)adc_read() << 8;
+    adc.temp_samples = 1;
+  }
+  sensor_data.temp_chip =
+      adc.temp_samples ? RP2040_TEMP_CENTI(adc.temp_q8) : 0;
+  sensor_data.sound_leq = adc.leq_cdb;
+  sensor_data.sound_lmax = adc.lmax_cdb;
+  sensor_data.sound_peak = adc.peak_cdb;
+  printf("Sound: Leq " CENTI_FMT " Lmax " CENTI_FMT " peak " CENTI_FMT
+         " dBFS over %lu samples, temp over %lu; ADC %lu blocks, %lu "
+         "overruns, %luus max\n",
+         CENTI_ARGS(sensor_data.sound_leq), CENTI_ARGS(sensor_data.sound_lmax),
+         CENTI_ARGS(sensor_data.sound_peak), adc.audio_samples,
+         adc.temp_samples, adc_cap.blocks, adc_cap.overruns,
+         adc_cap.process_us_max);
+  adc_cap.process_us_max = 0;
+  return ok;
+}
+
+// RSSI goes over the cyw43 SPI bus, it changes slowly
+static bool sched_rssi_read(void *arg) {
+  return cyw43_wifi_get_rssi(&cyw43_state, &sensor_data.rssi) == 0;
+}
+
+static bool sched_report(void *arg);
+
+// Period, conversion time, first read, bus, event driven, start, read. The
+// MPU is released by its data-ready interrupt; sound comes before the report
+// on the same deadline because it is earlier in the table.
+static const sensor_sched_channel_t sched_table[SCHED_CHANNELS] = {
+    [SCHED_MPU] = {"mpu", MPU_DRAIN_MS, 0, 0, SCHED_BUS_I2C0, true, NULL,
+                   sched_mpu_read, NULL},
+    [SCHED_BH1750] = {"bh1750", BH1750_PERIOD_MS, BH1750_CONVERSION_MS, 0,
+                      SCHED_BUS_I2C0, false, sched_bh1750_start,
+                      sched_bh1750_read, NULL},
+    [SCHED_SOUND] = {"sound", REPORT_MS, 0, REPORT_MS, SENSOR_SCHED_NO_BUS,
+                     false, NULL, sched_sound_read, NULL},
+    [SCHED_RSSI] = {"rssi", RSSI_PERIOD_MS, 0, 0, SCHED_BUS_CYW43, false,
+                    NULL, sched_rssi_read, NULL},
+    [SCHED_REPORT] = {"report", REPORT_MS, 0, REPORT_MS, SENSOR_SCHED_NO_BUS,
+                      false, NULL, sched_report, NULL},
+};
+static sensor_sched_t sched;
+
+static uint32_t sched_now_ms() {
+  return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static bool sched_report(void *arg) {
+  sensor_data_t *data = &sensor_data;
+  uint32_t now = sched_now_ms();
+
+  printf("MPU: %lu samples (%lu total, %lu bursts, %lu overflows, %lu "
+         "dropped)\n",
+         mpu_window, mpu.samples, mpu.bursts, mpu.overflows, mpu.ring_dropped);
+  if (wake_stats.n)
+    printf("Wake: latency %lu/%lu/%luus (min/avg/max), jitter max %luus\n",
+           wake_stats.lat_min, wake_stats.lat_sum / wake_stats.n,
+           wake_stats.lat_max, wake_stats.jit_max);
+  if (i2c0_bus.xfers)
+    printf("I2C0: %lu xfers, %lu errors, latency avg %lluus max %luus, "
+           "busy %lu%%, queue max %lu/%lu\n",
+           i2c0_bus.xfers, i2c0_bus.errors,
+           i2c0_bus.latency_sum_us / i2c0_bus.xfers, i2c0_bus.latency_max_us,
+           i2c0_bus.busy_us / (REPORT_MS * 10),
+           i2c0_bus.depth_max[I2C_BUS_HIGH],
+           i2c0_bus.depth_max[I2C_BUS_NORMAL]);
+  i2c0_bus.busy_us = 0;
+  i2c0_bus.latency_max_us = 0;
+  memset(&wake_stats, 0, sizeof(wake_stats));
+  mpu_window = 0;
+
+  // achieved rate and misses per channel over the report interval
+  for (int i = 0; i < SCHED_CHANNELS; i++) {
+    data->sched_rate[i] = sensor_sched_rate_chz(&sched, i, now);
+    data->sched_misses[i] = sched.st[i].misses;
+    printf("Sched: %-6s " CENTI_FMT " Hz, %lu reads, %lu misses, %lu errors, "
+           "late max %lums\n",
+           sched_table[i].name, CENTI_ARGS((int32_t)data->sched_rate[i]),
+           sched.st[i].reads, sched.st[i].misses, sched.st[i].errors,
+           sched.st[i].late_max_ms);
+  }
+  sensor_sched_stats_reset(&sched, now);
+
+  // compact features of the decimated window instead of raw samples
+  for (int i = 0; i < IMU_AXES; i++) {
+    dsp_features_t f;
+    if (dsp_window_features(&imu_win[i], &f)) {
+      if (i < 3) {
+        data->accel[i] = f.mean;
+        data->vib_rms[i] = f.rms;
+        data->vib_peak[i] = f.peak;
+        data->vib_crest[i] = f.crest_q8;
+      } else {
+        data->gyro[i - 3] = f.mean;
+      }
+    }
+    dsp_window_reset(&imu_win[i]);
+  }
+  printf("Vib: rms %u/%u/%u peak %u/%u/%u LSB\n", data->vib_rms[0],
+         data->vib_rms[1], data->vib_rms[2], data->vib_peak[0],
+         data->vib_peak[1], data->vib_peak[2]);
+
+  data->uptime_sec = xTaskGetTickCount() / configTICK_RATE_HZ;
+
+  printf("Lux: " CENTI_FMT " Temp: " CENTI_FMT "C RSSI: %ld Uptime: %lus\n",
+         CENTI_ARGS(data->lux), CENTI_ARGS(data->temp_chip), data->rssi,
+         data->uptime_sec);
+
+  if (report_cfg_pending) {
+    taskENTER_CRITICAL();
+    report_cfg = report_cfg_new;
+    report_cfg_pending = false;
+    taskEXIT_CRITICAL();
+    report_config_apply(&report_cfg);
+    printf("Report: deadbands lux %ld temp %ld accel %ld gyro %ld vib %ld "
+           "sound %ld, hysteresis %ld%%, heartbeat %lus\n",
+           report_cfg.lux, report_cfg.temp, report_cfg.accel, report_cfg.gyro,
+           report_cfg.vib, report_cfg.sound, report_cfg.hyst_pct,
+           report_cfg.heartbeat_s);
+  }
+  uint16_t vib_max = data->vib_rms[0];
+  for (int i = 1; i < 3; i++)
+    if (data->vib_rms[i] > vib_max)
+      vib_max = data->vib_rms[i];
+  const int32_t values[RPT_CHANNELS] = {
+      data->lux,      data->temp_chip, data->temp_mpu, data->accel[0],
+      data->accel[1], data->accel[2],  data->gyro[0],  data->gyro[1],
+      data->gyro[2],  vib_max,         data->sound_leq};
+  report_reason_t why = report_filter_check(&report_filter, values, now);
+  data->tx_sent = report_filter.sent;
+  data->tx_suppressed = report_filter.suppressed;
+  printf("Report: %s, %lu sent / %lu suppressed (%lu heartbeats)\n",
+         report_reason_name[why], report_filter.sent, report_filter.suppressed,
+         report_filter.heartbeats);
+
+  telemetry_msg_t msg = {.type = MSG_SENSOR, .sensor = *data};
+  if (why != REPORT_SUPPRESSED)
+    xQueueSend(xSensorQueue, &msg, 0);
+
+  if (vib_spec.windows && why != REPORT_SUPPRESSED) {
+    msg.type = MSG_SPECTRUM;
+    spectrum_data_t *sp = &msg.spectrum;
+    sp->uptime_sec = data->uptime_sec;
+    sp->fs_hz = vib_spec.fs_hz;
+    sp->n = vib_spec.n;
+    sp->windows = vib_spec.windows;
+    // the FFT runs in this task between I2C transactions: us * MHz
+    sp->fft_cycles = vib_fft_max_us * (clock_get_hz(clk_sys) / 1000000);
+    fft_spectrum_bands(&vib_spec, vib_band_edges, VIB_BANDS, sp->bands);
+    sp->npeaks = fft_spectrum_peaks(&vib_spec, sp->peaks, VIB_PEAKS);
+    xQueueSend(xSensorQueue, &msg, 0);
+    printf("FFT: %u windows, 3x%u points in %luus (max %luus, %lu cycles), "
+           "up to %lu windows/s\n",
+           sp->windows, sp->n, vib_fft_us, vib_fft_max_us, sp->fft_cycles,
+           vib_fft_max_us ? 1000000 / vib_fft_max_us : 0);
+  }
+  fft_spectrum_reset(&vib_spec);
+  vib_fft_max_us = 0;
+  char s1[32], s2[32], s3[32], s4[32];
+  snprintf(s1, 32, "WiFi: %s", WIFI_SSID);
+  snprintf(s2, 32, "IP:%s", ip4addr_ntoa(netif_ip4_addr(netif_list)));
+  snprintf(s3, 32, "Lux:%ld T:" CENTI_FMT "C", (long)(data->lux / 100),
+           CENTI_ARGS(data->temp_chip));
+  snprintf(s4, 32, "RSSI:%ld Up:%lus", data->rssi, data->uptime_sec);
+  safe_oled_print(s1, s2, s3, s4);
+  printf("OLED: %lu widgets/%lu glyphs redrawn, %lu/%u bytes skipped, "
+         "show %luus, bus %luus, lock %luus (max %luus)\n",
+         ui.redrawn, ui.glyphs, disp.skipped_bytes, disp.bufsize,
+         disp.last_show_us, disp.i2c.last_xfer_us, oled_lock_us,
+         oled_lock_max_us);
+  static bool tog = false;
+  static const uint8_t BMP_DOT[25] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+                                      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  if (tog)
+    led_draw(BMP_DOT, 10, 0, 0);
+  else
+    led_clear();
+  tog = !tog;
+  return true;
+}
+
 // --- TASKS ---
 void vSensorTask(void *pvParameters) {
-  uint8_t cmd[] = {0x6B, 0x00};
-  i2c_write_timeout_us(i2c0, MPU6050_ADDR, cmd, 2, false, 10000);
-  uint8_t bh_cmd = 0x10;
-  i2c_write_timeout_us(i2c0, BH1750_ADDR, &bh_cmd, 1, false, 10000);
-  sensor_data_t data;
+  mpu6050_init(&mpu, i2c0, mpu_addr);
+  if (i2c0_managed)
+    mpu6050_set_xfer(&mpu, i2c_bus_xfer, &i2c0_bus);
+  if (!mpu6050_fifo_start(&mpu, MPU_RATE_HZ, MPU_DLPF, mpu_ring, 256))
+    printf("MPU FIFO start failed\n");
+  gpio_init(MPU_INT_PIN);
+  gpio_set_dir(MPU_INT_PIN, GPIO_IN);
+  gpio_pull_down(MPU_INT_PIN);
+  gpio_set_irq_enabled_with_callback(MPU_INT_PIN, GPIO_IRQ_EDGE_RISE, true,
+                                     mpu_int_callback);
+  mpu6050_data_ready_irq(&mpu, true);
+  adc_cap_ok = adc_capture_init(&adc_cap, MIC_ADC_INPUT, ADC_BLOCK,
+                                ADC_RATE_HZ, ADC_TASK_PRIORITY);
+  if (!adc_cap_ok) {
+    printf("ADC capture start failed, no sound level\n");
+    adc_set_temp_sensor_enabled(true);
+  }
+  for (int i = 0; i < IMU_AXES; i++) {
+    dsp_fir_init(&imu_fir[i], fir_imu_lowpass, FIR_IMU_LOWPASS_TAPS,
+                 IMU_DECIM);
+    dsp_window_reset(&imu_win[i]);
+  }
+  fft_spectrum_init(&vib_spec, VIB_FFT_N, mpu.rate_hz);
+  report_filter_init(&report_filter, RPT_CHANNELS, 0);
+  report_config_apply(&report_cfg);
+  sensor_sched_init(&sched, sched_table, SCHED_CHANNELS, sched_now_ms());
   printf("SensorTask Started\n");
   while (1) {
-    printf("Reading I2C...\n");
-    uint8_t raw[6];
-    uint8_t reg = 0x3B;
-    int ret = i2c_write_timeout_us(i2c0, MPU6050_ADDR, &reg, 1, true, 5000);
-    if (ret < 0)
-      printf("MPU Write Fail: %d\n", ret);
-
-    i2c_read_timeout_us(i2c0, MPU6050_ADDR, raw, 6, false, 5000);
-    data.ax = (int16_t)((raw[0] << 8) | raw[1]);
-    data.ay = (int16_t)((raw[2] << 8) | raw[3]);
-    data.az = (int16_t)((raw[4] << 8) | raw[5]);
-    uint8_t lux_raw[2];
-    if (i2c_read_timeout_us(i2c0, BH1750_ADDR, lux_raw, 2, false, 5000) == 2) {
-      data.lux = ((lux_raw[0] << 8) | lux_raw[1]) / 1.2f;
-    } else {
-      data.lux = 0;
+    uint32_t wait = sensor_sched_run(&sched, sched_now_ms());
+    // woken early by the data-ready ISR; without INT the MPU channel still
+    // runs every 2 * MPU_DRAIN_MS and counts as a miss
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait))) {
+      wake_stats_add(&wake_stats, mpu_irq_us, time_us_32());
+      sensor_sched_release(&sched, SCHED_MPU, sched_now_ms());
     }
+  }
+}
+
+void vDisplayTask(void *pvParameters) {
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    // let the previous frame finish outside the lock
+    ssd1306_show_wait(&disp);
+    if (xSemaphoreTake(xOledMutex, portMAX_DELAY) == pdTRUE) {
+      uint32_t taken = time_us_32();
+      ssd1306_show_async(&disp, NULL, NULL);
+      oled_lock_release(taken);
+    }
+  }
+}
+
+// One keep-alive connection to the server for every message
+static http_conn_t http;
+static udp_tx_t udp;
+
+static void format_sensor(const sensor_data_t *data, const http_conn_t *net,
+                          char *buffer, size_t size) {
+  // crest factor as hundredths: Q8.8 * 100 / 256
+  int32_t crest[3];
+  for (int i = 0; i < 3; i++)
+    crest[i] = data->vib_crest[i] * 100 / 256;
+  int len = snprintf(
+      buffer, size,
+      "{\"lux\":" CENTI_FMT ",\"temp\":" CENTI_FMT
+      ",\"rssi\":%ld,\"uptime\":%lu,"
+      "\"accel\":{\"x\":%d,\"y\":%d,\"z\":%d},"
+      "\"gyro\":{\"x\":%d,\"y\":%d,\"z\":%d},\"temp_mpu\":" CENTI_FMT
+      ",\"vib\":{\"rms\":[%u,%u,%u],\"peak\":[%u,%u,%u],"
+      "\"crest\":[" CENTI_FMT "," CENTI_FMT "," CENTI_FMT "]},"
+      "\"sound\":{\"leq\":" CENTI_FMT ",\"lmax\":" CENTI_FMT
+      ",\"peak\":" CENTI_FMT "},"
+      "\"tx\":{\"sent\":%lu,\"suppressed\":%lu},\"sched\":{",
+      CENTI_ARGS(data->lux), CENTI_ARGS(data->temp_chip), data->rssi,
+      data->uptime_sec, data->accel[0], data->accel[1], data->accel[2],
+      data->gyro[0], data->gyro[1], data->gyro[2],
+      CENTI_ARGS(data->temp_mpu), data->vib_rms[0], data->vib_rms[1],
+      data->vib_rms[2], data->vib_peak[0], data->vib_peak[1],
+      data->vib_peak[2], CENTI_ARGS(crest[0]), CENTI_ARGS(crest[1]),
+      CENTI_ARGS(crest[2]), CENTI_ARGS(data->sound_leq),
+      CENTI_ARGS(data->sound_lmax), CENTI_ARGS(data->sound_peak),
+      data->tx_sent, data->tx_suppressed);
+  // per channel [achieved Hz, deadline misses]
+  for (int i = 0; i < SCHED_CHANNELS && len < (int)size; i++)
+    len += snprintf(buffer + len, size - len,
+                    "%s\"%s\":[" CENTI_FMT ",%lu]", i ? "," : "",
+                    sched_table[i].name,
+                    CENTI_ARGS((int32_t)data->sched_rate[i]),
+                    data->sched_misses[i]);
+  // requests per connection, average and worst send-to-response time
+  uint32_t lat_us = net->requests ? net->latency_sum_us / net->requests : 0;
+  if (len < (int)size)
+    snprintf(buffer + len, size - len,
+             "},\"net\":{\"rpc\":" CENTI_FMT ",\"lat_ms\":" CENTI_FMT
+             ",\"lat_max_ms\":" CENTI_FMT ",\"conn\":%lu}}",
+             CENTI_ARGS((int32_t)http_conn_rpc_centi(net)),
+             CENTI_ARGS((int32_t)(lat_us / 10)),
+             CENTI_ARGS((int32_t)(net->latency_max_us / 10)),
+             net->connections);
+}
+
+static void format_spectrum(const spectrum_data_t *sp, char *buffer,
+                            size_t size) {
+  int len = snprintf(buffer, size,
+                     "{\"uptime\":%lu,\"fs\":%u,\"n\":%u,\"windows\":%u,"
+                     "\"fft_cycles\":%lu,\"bands\":[",
+                     sp->uptime_sec, sp->fs_hz, sp->n, sp->windows,
+                     sp->fft_cycles);
+  for (int b = 0; b < VIB_BANDS && len < (int)size; b++)
+    len += snprintf(buffer + len, size - len, "%s[%u,%u,%lu]", b ? "," : "",
+                    vib_band_edges[b], vib_band_edges[b + 1], sp->bands[b]);
+  if (len < (int)size)
+    len += snprintf(buffer + len, size - len, "],\"peaks\":[");
+  for (int p = 0; p < sp->npeaks && len < (int)size; p++)
+    len += snprintf(buffer + len, size - len, "%s[" CENTI_FMT ",%lu]",
+                    p ? "," : "", CENTI_ARGS((int32_t)sp->peaks[p].freq_chz),
+                    sp->peaks[p].amp);
+  if (len < (int)size)
+    snprintf(buffer + len, size - len, "]}");
+}
+
+// Encodes a sample straight into the batch buffer
+static bool wifi_add_sample(batch_t *b, const sensor_data_t *data) {
+  static char item[WIFI_BODY_SIZE];
+  if (b->format == BATCH_RAW) {
+    size_t room;
+    void *at = batch_reserve(b, &room);
+    size_t len = sensor_frame_encode(data, &http, at, room);
+    return len && batch_commit(b, len, sched_now_ms());
+  }
+  format_sensor(data, &http, item, sizeof(item));
+  return batch_add(b, item, strnlen(item, sizeof(item)), sched_now_ms());
+}
+
+// One request of a burst: a sample batch or a spectrum
+typedef struct {
+  const char *path;
+  const char *content_type;
+  const void *body;
+  size_t len;
+  uint32_t samples; // sensor samples in body, 0 for a spectrum
+} wifi_post_t;
+
+// Report config from a server reply, applied by the sensor task
+static void wifi_config(const char *reply) {
+  report_config_t c = report_cfg_new;
+  if (report_config_parse(reply, &c) &&
+      memcmp(&c, &report_cfg_new, sizeof(c))) {
+    taskENTER_CRITICAL();
+    report_cfg_new = c;
+    report_cfg_pending = true;
+    taskEXIT_CRITICAL();
+  }
+}
 
-    // Internal Temperature (ADC Channel 4)
-    adc_select_input(4);
-    float adc_voltage = adc_read() * 3.3f / (1 << 12);
-    data.temp_chip = 27.0f - (adc_voltage - 0.706f) / 0.001721f;
-
-    // RSSI (WiFi Signal Strength)
-    cyw43_wifi_get_rssi(&cyw43_state, &data.rssi);
-
-    // Uptime
-    data.uptime_sec = xTaskGetTickCount() / configTICK_RATE_HZ;
-
-    printf("Lux: %.2f Temp: %.1fC RSSI: %ld Uptime: %lus\\n", data.lux,
-           data.temp_chip, data.rssi, data.uptime_sec);
-
-    xQueueSend(xSensorQueue, &data, 0);
-    char s1[32], s2[32], s3[32], s4[32];
-    snprintf(s1, 32, "WiFi: %s", WIFI_SSID);
-    snprintf(s2, 32, "IP:%s", ip4addr_ntoa(netif_ip4_addr(netif_list)));
-    snprintf(s3, 32, "Lux:%.0f T:%.1fC", data.lux, data.temp_chip);
-    snprintf(s4, 32, "RSSI:%ld Up:%lus", data.rssi, data.uptime_sec);
-    safe_oled_print(s1, s2, s3, s4);
-    static bool tog = false;
-    static const uint8_t BMP_DOT[25] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
-                                        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    if (tog)
-      led_draw(BMP_DOT, 10, 0, 0);
+static void wifi_reply(const wifi_post_t *post, int status,
+                       const char *reply) {
+  if (status != 200)
+    printf("WiFi: %s -> %d\n", post->path, status);
+  else if (post->samples)
+    wifi_config(reply);
+}
+
+// Fire and forget; the server answers some datagrams with the report
+// config, picked up here without waiting
+static void wifi_send_udp(const void *frames, size_t len, uint32_t samples) {
+  static char reply[256];
+  if (!udp_tx_send(&udp, frames, len, samples, sched_now_ms()))
+    printf("WiFi: datagram %lu lost (%lu samples)\n", udp.seq - 1, samples);
+  while (udp_tx_recv(&udp, reply, sizeof(reply)) > 0)
+    wifi_config(reply);
+}
+
+// Requests go out back to back on the kept-alive connection, then the
+// responses are read in order. Requests left without a response (the server
+// closed or reset the connection mid-burst) are posted again, one at a time,
+// on a new connection.
+static void wifi_send(const wifi_post_t *posts, int n) {
+  static char reply[512];
+  int sent = 0, done = 0;
+  while (sent < n &&
+         http_conn_send(&http, posts[sent].path, posts[sent].content_type,
+                        posts[sent].body, posts[sent].len))
+    sent++;
+  for (int status; done < sent; done++) {
+    if ((status = http_conn_recv(&http, reply, sizeof(reply))) < 0)
+      break;
+    wifi_reply(&posts[done], status, reply);
+  }
+  for (; done < n; done++) {
+    int status = http_conn_post(&http, posts[done].path,
+                                posts[done].content_type, posts[done].body,
+                                posts[done].len, reply, sizeof(reply));
+    if (status < 0)
+      printf("WiFi: %s lost (%lu samples)\n", posts[done].path,
+             posts[done].samples);
     else
-      led_clear();
-    tog = !tog;
-    vTaskDelay(pdMS_TO_TICKS(2000));
+      wifi_reply(&posts[done], status, reply);
   }
 }
 
+// Both encodings of one sample, bytes and cycles each, averaged over
+// WIFI_BENCH_RUNS runs
+static void wifi_bench(const sensor_data_t *data) {
+  static char buf[WIFI_BODY_SIZE];
+  uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+  size_t json_len = 0, frame_len = 0;
+  uint32_t t0 = time_us_32();
+  for (int i = 0; i < WIFI_BENCH_RUNS; i++) {
+    format_sensor(data, &http, buf, sizeof(buf));
+    json_len = strnlen(buf, sizeof(buf));
+  }
+  uint32_t t1 = time_us_32();
+  for (int i = 0; i < WIFI_BENCH_RUNS; i++)
+    frame_len = sensor_frame_encode(data, &http, buf, sizeof(buf));
+  uint32_t t2 = time_us_32();
+  printf("WiFi: encode JSON %u bytes %lu cycles, frame %u bytes %lu cycles\n",
+         (unsigned)json_len, (t1 - t0) * mhz / WIFI_BENCH_RUNS,
+         (unsigned)frame_len,
+         (t2 - t1) * mhz / WIFI_BENCH_RUNS);
+}
+
+static void wifi_stats(const batch_t *b) {
+  uint32_t batches = 0;
+  for (int i = 0; i < BATCH_REASONS; i++)
+    batches += b->flushes[i];
+  printf("WiFi: %lu req / %lu conn (" CENTI_FMT " per conn, max %lu), "
+         "latency avg %lu us max %lu us, closes %lu, errors %lu, "
+         "retries %lu\n",
+         http.requests, http.connections,
+         CENTI_ARGS((int32_t)http_conn_rpc_centi(&http)),
+         http.conn_requests_max,
+         (uint32_t)(http.requests ? http.latency_sum_us / http.requests : 0),
+         http.latency_max_us,
+         http.server_closes, http.errors, http.retries);
+  printf("WiFi: %lu samples in %lu batches (" CENTI_FMT
+         " per batch, %lu bytes per sample), flushed by count %lu, "
+         "bytes %lu, age %lu\n",
+         b->samples, batches,
+         CENTI_ARGS((int32_t)(batches ? b->samples * 100 / batches : 0)),
+         b->samples ? b->bytes / b->samples : 0, b->flushes[BATCH_COUNT],
+         b->flushes[BATCH_BYTES], b->flushes[BATCH_AGE]);
+  if (udp.datagrams || udp.errors)
+    printf("WiFi: UDP %lu datagrams, %lu samples, %lu bytes, %lu errors\n",
+           udp.datagrams, udp.samples, udp.bytes, udp.errors);
+}
+
+// Samples collect in a batch posted to HTTP_PATH_BATCH once it holds
+// BATCH_MAX_SAMPLES samples, BATCH_MAX_BYTES bytes, or its oldest sample is
+// BATCH_MAX_AGE_MS old. Spectra are posted on their own, in the same burst.
 void vWifiTask(void *pvParameters) {
-  sensor_data_t data;
-  char buffer[256];
+  static telemetry_msg_t msg;
+  static sensor_data_t last;
+  static batch_t batch;
+  static char spectrum[HTTP_CONN_PIPELINE - 1][WIFI_BODY_SIZE];
+  wifi_post_t posts[HTTP_CONN_PIPELINE];
+  uint32_t stats_at = 0;
+  report_cfg_new = report_cfg;
+  http_conn_init(&http, SERVER_IP, SERVER_PORT, HTTP_TIMEOUT_MS);
+  // a new session per boot tells the server the sequence restarts
+  bool use_udp =
+      TELEMETRY_UDP &&
+      udp_tx_init(&udp, SERVER_IP, UDP_PORT, (uint16_t)get_rand_32());
+  if (use_udp)
+    batch_init(&batch, BATCH_RAW, UDP_MAX_SAMPLES, UDP_TX_PAYLOAD,
+               UDP_MAX_AGE_MS);
+  else
+    batch_init(&batch, TELEMETRY_BINARY ? BATCH_RAW : BATCH_JSON,
+               BATCH_MAX_SAMPLES, BATCH_MAX_BYTES, BATCH_MAX_AGE_MS);
+  if (TELEMETRY_UDP && !use_udp)
+    printf("WiFi: UDP socket failed, samples go over HTTP\n");
   printf("WiFiTask Started\n");
   while (1) {
-    if (xQueueReceive(xSensorQueue, &data, portMAX_DELAY) == pdTRUE) {
-      printf("WiFi: Got data from queue (Lux: %.1f)\n", data.lux);
-      snprintf(buffer, 256,
-               "{\"lux\":%.2f,\"temp\":%.2f,\"rssi\":%ld,\"uptime\":%lu,"
-               "\"accel\":{\"x\":%d,\"y\":%d,\"z\":%d}}",
-               data.lux, data.temp_chip, data.rssi, data.uptime_sec, data.ax,
-               data.ay, data.az);
-      int sock = socket(AF_INET, SOCK_STREAM, 0);
-      if (sock < 0) {
-        printf("WiFi: Socket creation failed\n");
-        continue;
-      }
-      printf("WiFi: Socket created (%d)\n", sock);
-      struct sockaddr_in server_addr;
-      server_addr.sin_family = AF_INET;
-      server_addr.sin_port = htons(SERVER_PORT);
-      inet_aton(SERVER_IP, &server_addr.sin_addr);
-      printf("WiFi: Connecting to %s:%d...\n", SERVER_IP, SERVER_PORT);
-      if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) <
-          0) {
-        printf("WiFi: Connect failed\n");
-        lwip_close(sock);
+    uint32_t wait = batch_wait_ms(&batch, sched_now_ms());
+    TickType_t ticks =
+        wait == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait);
+    batch_reason_t flush = BATCH_WAIT;
+    bool pending = false; // msg waits for the next batch
+    int n = 0;
+
+    // wait for the first message or the batch age, then drain the queue
+    // while the burst has room and the batch is still open
+    while (flush == BATCH_WAIT && n < HTTP_CONN_PIPELINE - 1 &&
+           xQueueReceive(xSensorQueue, &msg, ticks) == pdTRUE) {
+      ticks = 0;
+      if (msg.type == MSG_SPECTRUM) {
+        format_spectrum(&msg.spectrum, spectrum[n], WIFI_BODY_SIZE);
+        posts[n] = (wifi_post_t){HTTP_PATH_SPECTRUM, "application/json",
+                                 spectrum[n],
+                                 strnlen(spectrum[n], WIFI_BODY_SIZE), 0};
+        n++;
         continue;
       }
-      printf("WiFi: Connected! Sending...\n");
-      char req[512];
-      int len = snprintf(req, sizeof(req),
-                         "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: "
-                         "application/json\r\nContent-Length: "
-                         "%d\r\nConnection: close\r\n\r\n%s",
-                         HTTP_PATH, SERVER_IP, (int)strlen(buffer), buffer);
-      send(sock, req, len, 0);
-      char rx_buf[128];
-      recv(sock, rx_buf, sizeof(rx_buf) - 1, 0);
-      lwip_close(sock);
-      printf("WiFi: Data Sent OK\n");
+      last = msg.sensor;
+      if (wifi_add_sample(&batch, &msg.sensor))
+        flush = batch_due(&batch, sched_now_ms());
+      else if (batch.count) {
+        flush = BATCH_BYTES;
+        pending = true;
+      } else
+        printf("WiFi: sample larger than a batch, dropped\n");
+    }
+    if (flush == BATCH_WAIT)
+      flush = batch_due(&batch, sched_now_ms());
+    if (flush != BATCH_WAIT) {
+      size_t len;
+      const void *body = batch_close(&batch, flush, &len);
+      if (use_udp)
+        wifi_send_udp(body, len, batch.count);
+      else
+        posts[n++] = (wifi_post_t){HTTP_PATH_BATCH,
+                                   batch.format == BATCH_RAW
+                                       ? FRAME_CONTENT_TYPE
+                                       : "application/json",
+                                   body, len, batch.count};
+    }
+    if (n)
+      wifi_send(posts, n);
+    if (flush != BATCH_WAIT) {
+      batch_clear(&batch);
+      if (pending)
+        wifi_add_sample(&batch, &msg.sensor);
+    }
+
+    if (http.requests + udp.datagrams - stats_at >= WIFI_STATS_EVERY) {
+      stats_at = http.requests + udp.datagrams;
+      wifi_stats(&batch);
+      wifi_bench(&last);
     }
   }
 }
 
 void vMainTask(void *pvParameters) {
+#ifdef VERBOSE_BOOT
+  ssd1306_console(&disp, true);
+  oled_log("FreeRTOS Mode");
+  oled_log("cyw43 init...");
+  if (cyw43_arch_init_with_country(CYW43_COUNTRY_BRAZIL)) {
+    oled_log("WiFi Fail");
+    vTaskDelete(NULL);
+  }
+  cyw43_wifi_pm(&cyw43_state,
+                cyw43_pm_value(CYW43_NO_POWERSAVE_MODE, 20, 1, 1, 1));
+  cyw43_arch_enable_sta_mode();
+  oled_log("SSID %s", WIFI_SSID);
+  int err, attempt = 1;
+  oled_log("Try %d...", attempt);
+  while ((err = cyw43_arch_wifi_connect_timeout_ms(
+              WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK, 30000))) {
+    oled_log("err %d link %d", err,
+             cyw43_wifi_link_status(&cyw43_state, CYW43_ITF_STA));
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    oled_log("Try %d...", ++attempt);
+  }
+  oled_log("IP %s", ip4addr_ntoa(netif_ip4_addr(netif_list)));
+  ssd1306_console(&disp, false);
+  oled_ui_invalidate(&ui);
+#else
   safe_oled_print("FreeRTOS Mode", "Init WiFi...", NULL, NULL);
   if (cyw43_arch_init_with_country(CYW43_COUNTRY_BRAZIL)) {
     safe_oled_print("WiFi Fail", NULL, NULL, NULL);
@@ -247,14 +1086,16 @@ void vMainTask(void *pvParameters) {
     safe_oled_print("Retrying...", NULL, NULL, NULL);
     vTaskDelay(pdMS_TO_TICKS(1000));
   }
+#endif
   safe_oled_print("Connected!", ip4addr_ntoa(netif_ip4_addr(netif_list)), NULL,
                   NULL);
+  safe_oled_icon(&img_wifi);
   buzzer_beep(1000, 200);
   led_draw(BMP_OK, 0, 0, 50);
   vTaskDelay(pdMS_TO_TICKS(1000));
   led_clear();
-  xSensorQueue = xQueueCreate(5, sizeof(sensor_data_t));
-  xTaskCreate(vSensorTask, "Sensor", 2048, NULL, 4, NULL);
+  xSensorQueue = xQueueCreate(5, sizeof(telemetry_msg_t));
+  xTaskCreate(vSensorTask, "Sensor", 2048, NULL, 4, &xSensorTask);
   xTaskCreate(vWifiTask, "WiFi", 2048, NULL, 3, NULL);
   vTaskDelete(NULL);
 }
@@ -274,26 +1115,66 @@ void vAssertCalled(void) {
     ;
 }
 
+// Sensor bus and addresses from the cached topology. Only i2c0 has a bus
+// manager (i2c1 belongs to the OLED), so devices found on i2c1 pins are
+// listed but not used; the BH1750 must share the MPU6050's pins.
+static void topology_setup(uint *sda, uint *scl) {
+  static const char *const source_name[] = {"cached", "rescanned",
+                                            "rescanned, save failed"};
+  uint32_t t0 = time_us_32();
+  i2c_topology_source_t source =
+      i2c_topology_boot(&i2c_topo, TOPOLOGY_SKIP_PINS, OLED_ADDR);
+  printf("I2C topology %s: %u devices in %lu ms\n", source_name[source],
+         i2c_topo.count, (time_us_32() - t0) / 1000);
+  for (int i = 0; i < i2c_topo.count; i++) {
+    const i2c_dev_t *d = &i2c_topo.dev[i];
+    printf("  I2C%u GP%u/%u 0x%02X %s\n", d->bus, d->sda, d->scl, d->addr,
+           i2c_topology_type_name(d->type));
+  }
+
+  const i2c_dev_t *m = i2c_topology_find(&i2c_topo, I2C_DEV_MPU6050);
+  if (m && m->bus == 0) {
+    *sda = m->sda;
+    *scl = m->scl;
+    mpu_addr = m->addr;
+  } else {
+    printf("MPU6050 not on i2c0, using GP%u/%u 0x%02X\n", *sda, *scl,
+           mpu_addr);
+  }
+  const i2c_dev_t *b = i2c_topology_find(&i2c_topo, I2C_DEV_BH1750);
+  if (b && b->bus == 0 && b->sda == *sda)
+    bh1750_addr = b->addr;
+}
+
 int main() {
   stdio_init_all();
   sleep_ms(2000);
   printf("=== BitDogLab FreeRTOS BOOT ===\n");
+  // Before anything else claims pins: the probe drives every candidate pair,
+  // and the flash write stalls XIP, which is only safe without the scheduler
+  uint sda = SDA_SENSORS, scl = SCL_SENSORS;
+  topology_setup(&sda, &scl);
   i2c_init(i2c1, 400000);
   gpio_set_function(SDA_OLED, GPIO_FUNC_I2C);
   gpio_set_function(SCL_OLED, GPIO_FUNC_I2C);
   gpio_pull_up(SDA_OLED);
   gpio_pull_up(SCL_OLED);
-  i2c_init(i2c0, 100000);
-  gpio_set_function(0, GPIO_FUNC_I2C);
-  gpio_set_function(1, GPIO_FUNC_I2C);
-  gpio_pull_up(0);
-  gpio_pull_up(1);
+  i2c_init(i2c0, 400000);
+  gpio_set_function(sda, GPIO_FUNC_I2C);
+  gpio_set_function(scl, GPIO_FUNC_I2C);
+  gpio_pull_up(sda);
+  gpio_pull_up(scl);
+  i2c0_managed = i2c_bus_init(&i2c0_bus, i2c0, 256, 8, I2C0_BUS_PRIORITY);
+  if (!i2c0_managed)
+    printf("I2C0 bus manager init failed, using blocking I2C\n");
   ssd1306_init(&disp, 128, 64, OLED_ADDR, i2c1);
+  ssd1306_double_buffer(&disp);
   ssd1306_clear(&disp);
+  oled_ui_setup();
 
-  // Initialize ADC for internal temperature
+  // ADC for the microphone and the internal temperature, free running from
+  // the sensor task on
   adc_init();
-  adc_set_temp_sensor_enabled(true);
 
   buzzer_init_hw();
   led_pio = pio0;
@@ -305,6 +1186,7 @@ int main() {
   buzzer_beep(660, 100);
   buzzer_beep(880, 100);
 
+  xTaskCreate(vDisplayTask, "Display", 1024, NULL, 2, &xDisplayTask);
   xTaskCreate(vMainTask, "MainInit", 2048, NULL, 1, NULL);
   vTaskStartScheduler();
   while (1)
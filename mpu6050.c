@@ -0,0 +1,208 @@
+/**
+* @file mpu6050.c
+*
+* mpu6050 accelerometer/gyroscope driver
+*/
+
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+
+#include "mpu6050.h"
+
+#define MPU6050_TIMEOUT_US 5000
+// samples per burst read, bounds the stack buffer
+#define MPU6050_BURST 16
+
+#define MPU6050_FIFO_OFLOW 0x10
+#define MPU6050_DATA_RDY 0x01
+// TEMP_FIFO_EN | XG | YG | ZG | ACCEL_FIFO_EN
+#define MPU6050_ALL_FIFO 0xF8
+#define MPU6050_USER_FIFO_EN 0x40
+#define MPU6050_USER_FIFO_RESET 0x04
+
+static bool mpu6050_write_reg(mpu6050_t *m, uint8_t reg, uint8_t val) {
+    uint8_t buf[2]= {reg, val};
+
+    if(m->xfer) {
+        if(m->xfer(m->xfer_ctx, m->address, buf, 2, NULL, 0)!=2) {
+            ++m->errors;
+            return false;
+        }
+        return true;
+    }
+
+    if(i2c_write_timeout_us(m->i2c_i, m->address, buf, 2, false, MPU6050_TIMEOUT_US)!=2) {
+        ++m->errors;
+        return false;
+    }
+    return true;
+}
+
+static bool mpu6050_read_regs(mpu6050_t *m, uint8_t reg, uint8_t *dst, size_t len) {
+    if(m->xfer) {
+        // register address and burst in one transaction with a repeated start
+        if(m->xfer(m->xfer_ctx, m->address, &reg, 1, dst, len)!=(int) (len+1)) {
+            ++m->errors;
+            return false;
+        }
+        return true;
+    }
+
+    if(i2c_write_timeout_us(m->i2c_i, m->address, &reg, 1, true, MPU6050_TIMEOUT_US)!=1
+            || i2c_read_timeout_us(m->i2c_i, m->address, dst, len, false, MPU6050_TIMEOUT_US*(1+len/16))!=(int) len) {
+        ++m->errors;
+        return false;
+    }
+    return true;
+}
+
+inline static int16_t mpu6050_be16(const uint8_t *b) {
+    return (int16_t) ((b[0]<<8)|b[1]);
+}
+
+static void mpu6050_decode(const uint8_t *raw, mpu6050_sample_t *s) {
+    s->ax=mpu6050_be16(raw);
+    s->ay=mpu6050_be16(raw+2);
+    s->az=mpu6050_be16(raw+4);
+    s->temp=mpu6050_be16(raw+6);
+    s->gx=mpu6050_be16(raw+8);
+    s->gy=mpu6050_be16(raw+10);
+    s->gz=mpu6050_be16(raw+12);
+}
+
+bool mpu6050_init(mpu6050_t *m, i2c_inst_t *i2c_instance, uint8_t address) {
+    m->i2c_i=i2c_instance;
+    m->address=address;
+    m->xfer=NULL;
+    m->xfer_ctx=NULL;
+    m->fifo=false;
+    m->rate_hz=0;
+    m->period_us=0;
+    m->ring=NULL;
+    m->ring_size=0;
+    m->head=m->tail=0;
+    m->samples=m->bursts=m->overflows=m->ring_dropped=m->errors=0;
+
+    return mpu6050_write_reg(m, MPU6050_PWR_MGMT_1, 0x00);
+}
+
+void mpu6050_set_xfer(mpu6050_t *m, mpu6050_xfer_fn fn, void *ctx) {
+    m->xfer=fn;
+    m->xfer_ctx=ctx;
+}
+
+bool mpu6050_read(mpu6050_t *m, mpu6050_sample_t *s) {
+    uint8_t raw[MPU6050_SAMPLE_BYTES];
+
+    if(!mpu6050_read_regs(m, MPU6050_ACCEL_XOUT_H, raw, sizeof(raw)))
+        return false;
+
+    mpu6050_decode(raw, s);
+    s->t_us=time_us_32();
+    return true;
+}
+
+static bool mpu6050_fifo_reset(mpu6050_t *m) {
+    return mpu6050_write_reg(m, MPU6050_USER_CTRL, MPU6050_USER_FIFO_RESET)
+        && mpu6050_write_reg(m, MPU6050_USER_CTRL, MPU6050_USER_FIFO_EN);
+}
+
+bool mpu6050_fifo_start(mpu6050_t *m, uint32_t rate_hz, uint8_t dlpf, mpu6050_sample_t *ring, size_t ring_size) {
+    if(rate_hz<4)
+        rate_hz=4;
+    if(rate_hz>1000)
+        rate_hz=1000;
+    if(dlpf<1 || dlpf>6)
+        dlpf=1;
+
+    uint32_t div=1000/rate_hz-1;
+    m->rate_hz=1000/(div+1);
+    m->period_us=1000000/m->rate_hz;
+    m->ring=ring;
+    m->ring_size=ring_size;
+    m->head=m->tail=0;
+
+    // overflow shows up in INT_STATUS, reading it clears the flag
+    uint8_t status;
+    if(!mpu6050_write_reg(m, MPU6050_FIFO_EN, 0)
+            || !mpu6050_write_reg(m, MPU6050_CONFIG, dlpf)
+            || !mpu6050_write_reg(m, MPU6050_SMPLRT_DIV, div)
+            || !mpu6050_write_reg(m, MPU6050_INT_ENABLE, MPU6050_FIFO_OFLOW)
+            || !mpu6050_fifo_reset(m)
+            || !mpu6050_read_regs(m, MPU6050_INT_STATUS, &status, 1)
+            || !mpu6050_write_reg(m, MPU6050_FIFO_EN, MPU6050_ALL_FIFO))
+        return false;
+
+    m->fifo=true;
+    return true;
+}
+
+bool mpu6050_data_ready_irq(mpu6050_t *m, bool enable) {
+    // push-pull, active high, 50 us pulse: nothing to acknowledge per sample
+    return mpu6050_write_reg(m, MPU6050_INT_PIN_CFG, 0x00)
+        && mpu6050_write_reg(m, MPU6050_INT_ENABLE, MPU6050_FIFO_OFLOW|(enable?MPU6050_DATA_RDY:0));
+}
+
+void mpu6050_fifo_stop(mpu6050_t *m) {
+    mpu6050_write_reg(m, MPU6050_FIFO_EN, 0);
+    mpu6050_write_reg(m, MPU6050_USER_CTRL, 0);
+    m->fifo=false;
+}
+
+int mpu6050_fifo_drain(mpu6050_t *m) {
+    uint8_t buf[MPU6050_BURST*MPU6050_SAMPLE_BYTES];
+    uint8_t status, count_raw[2];
+
+    if(!m->fifo)
+        return 0;
+
+    if(!mpu6050_read_regs(m, MPU6050_INT_STATUS, &status, 1))
+        return -1;
+    if(status&MPU6050_FIFO_OFLOW) {
+        // the oldest bytes were overwritten, sample boundaries are lost
+        ++m->overflows;
+        return mpu6050_fifo_reset(m)?0:-1;
+    }
+
+    if(!mpu6050_read_regs(m, MPU6050_FIFO_COUNT_H, count_raw, 2))
+        return -1;
+
+    uint32_t now=time_us_32();
+    uint32_t n=((count_raw[0]<<8)|count_raw[1])/MPU6050_SAMPLE_BYTES;
+    int moved=0;
+
+    while(n) {
+        uint32_t burst=n>MPU6050_BURST?MPU6050_BURST:n;
+        if(!mpu6050_read_regs(m, MPU6050_FIFO_R_W, buf, burst*MPU6050_SAMPLE_BYTES))
+            return moved?moved:-1;
+        ++m->bursts;
+
+        for(uint32_t i=0; i<burst; ++i, --n) {
+            size_t next=(m->head+1)%m->ring_size;
+            if(next==m->tail) {
+                ++m->ring_dropped;
+                continue;
+            }
+
+            mpu6050_sample_t *s=&m->ring[m->head];
+            mpu6050_decode(buf+i*MPU6050_SAMPLE_BYTES, s);
+            // the newest sample in the fifo is about now, older ones one period apart
+            s->t_us=now-(n-1)*m->period_us;
+            m->head=next;
+            ++moved;
+        }
+    }
+
+    m->samples+=moved;
+    return moved;
+}
+
+size_t mpu6050_read_samples(mpu6050_t *m, mpu6050_sample_t *out, size_t max) {
+    size_t n=0;
+
+    while(n<max && m->tail!=m->head) {
+        out[n++]=m->ring[m->tail];
+        m->tail=(m->tail+1)%m->ring_size;
+    }
+    return n;
+}
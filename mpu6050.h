@@ -0,0 +1,189 @@
+/**
+* @file mpu6050.h
+*
+* mpu6050 accelerometer/gyroscope: single reads, or the on-chip fifo drained
+* in bursts into a ring buffer of timestamped samples
+*/
+
+#ifndef _inc_mpu6050
+#define _inc_mpu6050
+
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+
+/**
+*	@brief registers used by the driver
+*/
+typedef enum {
+    MPU6050_SMPLRT_DIV = 0x19,
+    MPU6050_CONFIG = 0x1A,
+    MPU6050_ACCEL_CONFIG = 0x1C,
+    MPU6050_FIFO_EN = 0x23,
+    MPU6050_INT_PIN_CFG = 0x37,
+    MPU6050_INT_ENABLE = 0x38,
+    MPU6050_INT_STATUS = 0x3A,
+    MPU6050_ACCEL_XOUT_H = 0x3B,
+    MPU6050_USER_CTRL = 0x6A,
+    MPU6050_PWR_MGMT_1 = 0x6B,
+    MPU6050_FIFO_COUNT_H = 0x72,
+    MPU6050_FIFO_R_W = 0x74,
+    MPU6050_WHO_AM_I = 0x75
+} mpu6050_reg_t;
+
+/**
+*	@brief bytes the fifo holds on chip
+*/
+#define MPU6050_FIFO_SIZE 1024
+
+/**
+*	@brief bytes per sample: accel, temperature and gyro, the register order
+*	from ACCEL_XOUT_H and also the order the fifo stores them in
+*/
+#define MPU6050_SAMPLE_BYTES 14
+
+/**
+*	@brief one sample of all channels
+*/
+typedef struct {
+    int16_t ax, ay, az;	/**< raw accelerometer, 16384 LSB/g at +-2g */
+    int16_t temp;		/**< raw die temperature, see mpu6050_temp_c */
+    int16_t gx, gy, gz;	/**< raw gyroscope, 131 LSB/(deg/s) at +-250 deg/s */
+    uint32_t t_us;		/**< time the sample was taken (time_us_32 clock) */
+} mpu6050_sample_t;
+
+/**
+*	@brief die temperature in degrees Celsius
+*/
+#define mpu6050_temp_c(raw) ((raw)/340.0f+36.53f)
+
+/**
+*	@brief die temperature in hundredths of a degree, integer only
+*/
+#define mpu6050_temp_centi(raw) ((int32_t) (raw)*5/17+3653)
+
+/**
+*	@brief bus transaction: write tx, then (repeated start) read rx
+*
+*	@return bytes transferred or PICO_ERROR_*
+*/
+typedef int (*mpu6050_xfer_fn)(void *ctx, uint8_t addr, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+
+/**
+*	@brief driver state
+*/
+typedef struct {
+    i2c_inst_t *i2c_i;	/**< bus the sensor is on */
+    uint8_t address;	/**< i2c address */
+    mpu6050_xfer_fn xfer;	/**< NULL: blocking sdk calls on i2c_i */
+    void *xfer_ctx;		/**< for xfer */
+    bool fifo;			/**< fifo mode running */
+    uint32_t rate_hz;	/**< sample rate in fifo mode */
+    uint32_t period_us;	/**< sample period in fifo mode */
+    mpu6050_sample_t *ring;	/**< samples drained from the fifo */
+    size_t ring_size;	/**< entries in ring */
+    volatile size_t head;	/**< next entry written by mpu6050_fifo_drain */
+    volatile size_t tail;	/**< next entry returned by mpu6050_read_samples */
+    uint32_t samples;	/**< samples drained so far */
+    uint32_t bursts;	/**< burst reads done so far */
+    uint32_t overflows;	/**< times the chip fifo overflowed (its content is dropped) */
+    uint32_t ring_dropped;	/**< samples lost because ring was full */
+    uint32_t errors;	/**< failed bus transactions */
+} mpu6050_t;
+
+/**
+*	@brief wake the sensor up
+*
+*	@param[in] m : driver state
+*	@param[in] i2c_instance : i2c bus, already set up
+*	@param[in] address : i2c address (0x68 or 0x69)
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool mpu6050_init(mpu6050_t *m, i2c_inst_t *i2c_instance, uint8_t address);
+
+/**
+*	@brief route bus transactions through a transfer function (e.g. a bus
+*	manager shared with other tasks) instead of blocking sdk calls
+*
+*	@param[in] m : driver state, after mpu6050_init
+*	@param[in] fn : transfer function, NULL for the sdk calls again
+*	@param[in] ctx : passed to fn
+*/
+void mpu6050_set_xfer(mpu6050_t *m, mpu6050_xfer_fn fn, void *ctx);
+
+/**
+*	@brief read all current sensor registers in one 14 byte burst
+*
+*	@param[in] m : driver state
+*	@param[out] s : sample, timestamped now
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool mpu6050_read(mpu6050_t *m, mpu6050_sample_t *s);
+
+/**
+*	@brief start sampling into the chip fifo
+*
+*	The sample rate is 1 kHz divided by an integer, the DLPF is on (it sets
+*	the 1 kHz base rate). Each record is 14 bytes (accel, temp, gyro), so the
+*	1024 byte fifo holds about 73 samples and overflows after 73 ms at 1 kHz:
+*	call mpu6050_fifo_drain at least every 50 ms.
+*
+*	@param[in] m : driver state
+*	@param[in] rate_hz : wanted sample rate, 4 to 1000 Hz
+*	@param[in] dlpf : DLPF_CFG 1..6 (184, 94, 44, 21, 10, 5 Hz bandwidth)
+*	@param[in] ring : storage for drained samples
+*	@param[in] ring_size : number of entries in ring
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool mpu6050_fifo_start(mpu6050_t *m, uint32_t rate_hz, uint8_t dlpf, mpu6050_sample_t *ring, size_t ring_size);
+
+/**
+*	@brief pulse the INT pin (active high, 50 us) whenever a sample is ready
+*
+*	Works in both modes; in fifo mode the edge means one more sample is in
+*	the fifo. Overflow keeps raising the pin as well.
+*
+*	@param[in] m : driver state
+*	@param[in] enable : false to only flag overflow in INT_STATUS again
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool mpu6050_data_ready_irq(mpu6050_t *m, bool enable);
+
+/**
+*	@brief stop fifo sampling
+*
+*	@param[in] m : driver state
+*/
+void mpu6050_fifo_stop(mpu6050_t *m);
+
+/**
+*	@brief move everything in the chip fifo into the ring buffer
+*
+*	Reads in multi-sample bursts. Samples are timestamped backwards from now
+*	at the sample period. On overflow the fifo is reset and counted.
+*
+*	@param[in] m : driver state
+*
+*	@return samples moved, -1 on bus error
+*/
+int mpu6050_fifo_drain(mpu6050_t *m);
+
+/**
+*	@brief take samples out of the ring buffer
+*
+*	@param[in] m : driver state
+*	@param[out] out : destination
+*	@param[in] max : entries in out
+*
+*	@return number of samples copied
+*/
+size_t mpu6050_read_samples(mpu6050_t *m, mpu6050_sample_t *out, size_t max);
+
+#endif
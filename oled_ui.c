@@ -0,0 +1,174 @@
+/**
+* @file oled_ui.c
+*
+* retained widgets on top of the ssd1306 driver
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "oled_ui.h"
+
+extern const uint8_t font_8x5[];
+
+void oled_ui_init(oled_ui_t *ui, ssd1306_t *disp, oled_widget_t *widgets, size_t capacity) {
+    ui->disp=disp;
+    ui->widgets=widgets;
+    ui->count=0;
+    ui->capacity=capacity;
+    ui->redrawn=0;
+    ui->glyphs=0;
+    ui->frames=0;
+    ui->redrawn_total=0;
+}
+
+static oled_widget_t *oled_ui_add(oled_ui_t *ui, oled_ui_kind_t kind, uint32_t x, uint32_t y) {
+    if(ui->count>=ui->capacity)
+        return NULL;
+
+    oled_widget_t *w=&ui->widgets[ui->count++];
+    memset(w, 0, sizeof(*w));
+    w->kind=kind;
+    w->x=x;
+    w->y=y;
+    w->scale=1;
+    w->font=font_8x5;
+    return w;
+}
+
+oled_widget_t *oled_ui_add_text(oled_ui_t *ui, oled_ui_kind_t kind, uint32_t x, uint32_t y, uint32_t scale, const char *text) {
+    oled_widget_t *w=oled_ui_add(ui, kind, x, y);
+    if(w==NULL)
+        return NULL;
+
+    w->scale=scale;
+    oled_ui_set_text(w, text);
+    return w;
+}
+
+oled_widget_t *oled_ui_add_icon(oled_ui_t *ui, uint32_t x, uint32_t y, const ssd1306_image_t *img) {
+    oled_widget_t *w=oled_ui_add(ui, OLED_UI_ICON, x, y);
+    if(w==NULL)
+        return NULL;
+
+    oled_ui_set_icon(w, img);
+    return w;
+}
+
+void oled_ui_set_text(oled_widget_t *w, const char *text) {
+    if(text==NULL)
+        text="";
+    if(strncmp(w->text, text, OLED_UI_TEXT_MAX-1)==0)
+        return;
+
+    strncpy(w->text, text, OLED_UI_TEXT_MAX-1);
+    w->text[OLED_UI_TEXT_MAX-1]='\0';
+    w->dirty=strcmp(w->text, w->drawn)!=0;
+}
+
+void oled_ui_printf(oled_widget_t *w, const char *format, ...) {
+    char text[OLED_UI_TEXT_MAX];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    oled_ui_set_text(w, text);
+}
+
+void oled_ui_set_icon(oled_widget_t *w, const ssd1306_image_t *img) {
+    w->img=img;
+    w->dirty=w->img!=w->img_drawn;
+}
+
+// one character cell, spacing included
+static void oled_ui_cell(const oled_widget_t *w, uint32_t *width, uint32_t *height) {
+    *width=(w->font[1]+w->font[2])*w->scale;
+    *height=w->font[0]*w->scale;
+}
+
+static uint32_t oled_ui_draw_label(ssd1306_t *p, oled_widget_t *w) {
+    uint32_t cw, ch;
+    oled_ui_cell(w, &cw, &ch);
+
+    size_t old_len=strlen(w->drawn);
+    if(old_len)
+        ssd1306_clear_square(p, w->x, w->y, old_len*cw, ch);
+    ssd1306_draw_string_with_font(p, w->x, w->y, w->scale, w->font, w->text);
+    return strlen(w->text);
+}
+
+static uint32_t oled_ui_draw_value(ssd1306_t *p, oled_widget_t *w) {
+    uint32_t cw, ch, glyphs=0;
+    oled_ui_cell(w, &cw, &ch);
+
+    size_t old_len=strlen(w->drawn), new_len=strlen(w->text);
+    size_t len=old_len>new_len?old_len:new_len;
+    for(size_t i=0; i<len; ++i) {
+        char was=i<old_len?w->drawn[i]:' ';
+        char is=i<new_len?w->text[i]:' ';
+        if(was==is)
+            continue;
+
+        uint32_t x=w->x+i*cw;
+        ssd1306_clear_square(p, x, w->y, cw, ch);
+        if(is!=' ') {
+            ssd1306_draw_char_with_font(p, x, w->y, w->scale, w->font, is);
+            ++glyphs;
+        }
+    }
+    return glyphs;
+}
+
+static void oled_ui_draw_icon(ssd1306_t *p, oled_widget_t *w) {
+    const ssd1306_image_t *old=w->img_drawn;
+
+    // the new image overwrites its own box, only clear what it leaves uncovered
+    if(old && (w->img==NULL || old->width>w->img->width || old->height>w->img->height))
+        ssd1306_clear_square(p, w->x, w->y, old->width, old->height);
+    if(w->img)
+        ssd1306_blit_native(p, w->x, w->y, w->img);
+    w->img_drawn=w->img;
+}
+
+uint32_t oled_ui_render(oled_ui_t *ui) {
+    ui->redrawn=0;
+    ui->glyphs=0;
+
+    for(size_t i=0; i<ui->count; ++i) {
+        oled_widget_t *w=&ui->widgets[i];
+        if(!w->dirty)
+            continue;
+
+        switch(w->kind) {
+        case OLED_UI_LABEL:
+            ui->glyphs+=oled_ui_draw_label(ui->disp, w);
+            strcpy(w->drawn, w->text);
+            break;
+        case OLED_UI_VALUE:
+            ui->glyphs+=oled_ui_draw_value(ui->disp, w);
+            strcpy(w->drawn, w->text);
+            break;
+        case OLED_UI_ICON:
+            oled_ui_draw_icon(ui->disp, w);
+            break;
+        }
+
+        w->dirty=false;
+        ++ui->redrawn;
+    }
+
+    ++ui->frames;
+    ui->redrawn_total+=ui->redrawn;
+    return ui->redrawn;
+}
+
+void oled_ui_invalidate(oled_ui_t *ui) {
+    for(size_t i=0; i<ui->count; ++i) {
+        oled_widget_t *w=&ui->widgets[i];
+        w->drawn[0]='\0';
+        w->img_drawn=NULL;
+        w->dirty=w->text[0]!='\0' || w->img!=NULL;
+    }
+}
@@ -0,0 +1,136 @@
+/**
+* @file oled_ui.h
+*
+* retained widgets on top of the ssd1306 driver: every widget remembers what
+* it last drew and only touches the framebuffer when its content changes
+*/
+
+#ifndef _inc_oled_ui
+#define _inc_oled_ui
+
+#include "ssd1306.h"
+
+/**
+*	@brief longest text a widget can hold (terminator included)
+*/
+#define OLED_UI_TEXT_MAX 24
+
+/**
+*	@brief how a widget is redrawn when it changes
+*/
+typedef enum {
+    OLED_UI_LABEL,	/**< text, redrawn as a whole */
+    OLED_UI_VALUE,	/**< text, only the character cells that changed are redrawn */
+    OLED_UI_ICON	/**< native image, redrawn when a different image (or none) is set */
+} oled_ui_kind_t;
+
+/**
+*	@brief one widget, owned by the caller
+*/
+typedef struct {
+    oled_ui_kind_t kind;
+    uint8_t x, y;		/**< top left corner */
+    uint8_t scale;		/**< font scale */
+    const uint8_t *font;	/**< font used for text widgets */
+    char text[OLED_UI_TEXT_MAX];	/**< wanted text */
+    char drawn[OLED_UI_TEXT_MAX];	/**< text in the framebuffer */
+    const ssd1306_image_t *img;		/**< wanted image */
+    const ssd1306_image_t *img_drawn;	/**< image in the framebuffer */
+    bool dirty;
+} oled_widget_t;
+
+/**
+*	@brief a screen: a display and the widgets drawn on it
+*/
+typedef struct {
+    ssd1306_t *disp;
+    oled_widget_t *widgets;
+    size_t count, capacity;
+    uint32_t redrawn;	/**< widgets redrawn by the last oled_ui_render */
+    uint32_t glyphs;	/**< characters rasterized by the last oled_ui_render */
+    uint32_t frames;	/**< oled_ui_render calls so far */
+    uint32_t redrawn_total;	/**< widgets redrawn so far */
+} oled_ui_t;
+
+/**
+*	@brief set up an empty screen
+*
+*	@param[in] ui : screen
+*	@param[in] disp : display the widgets are drawn on
+*	@param[in] widgets : storage for the widgets
+*	@param[in] capacity : number of entries in widgets
+*/
+void oled_ui_init(oled_ui_t *ui, ssd1306_t *disp, oled_widget_t *widgets, size_t capacity);
+
+/**
+*	@brief add a text widget
+*
+*	@param[in] ui : screen
+*	@param[in] kind : OLED_UI_LABEL or OLED_UI_VALUE
+*	@param[in] x : x position
+*	@param[in] y : y position
+*	@param[in] scale : font scale
+*	@param[in] text : initial text, may be NULL
+*
+*	@return the widget, NULL if the screen is full
+*/
+oled_widget_t *oled_ui_add_text(oled_ui_t *ui, oled_ui_kind_t kind, uint32_t x, uint32_t y, uint32_t scale, const char *text);
+
+/**
+*	@brief add an icon widget
+*
+*	@param[in] ui : screen
+*	@param[in] x : x position
+*	@param[in] y : y position
+*	@param[in] img : initial image, may be NULL
+*
+*	@return the widget, NULL if the screen is full
+*/
+oled_widget_t *oled_ui_add_icon(oled_ui_t *ui, uint32_t x, uint32_t y, const ssd1306_image_t *img);
+
+/**
+*	@brief change the text of a widget, nothing happens if it is the same
+*
+*	@param[in] w : widget
+*	@param[in] text : new text, NULL for none; truncated to OLED_UI_TEXT_MAX-1
+*/
+void oled_ui_set_text(oled_widget_t *w, const char *text);
+
+/**
+*	@brief printf into a text widget
+*
+*	@param[in] w : widget
+*	@param[in] format : format string
+*/
+void oled_ui_printf(oled_widget_t *w, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+*	@brief change the image of an icon widget, NULL hides it
+*
+*	@param[in] w : widget
+*	@param[in] img : new image
+*/
+void oled_ui_set_icon(oled_widget_t *w, const ssd1306_image_t *img);
+
+/**
+*	@brief draw every widget that changed into the framebuffer
+*
+*	Only the area of the changed widgets (or changed characters) is cleared,
+*	so the driver's dirty tracking sends just those columns on the next show.
+*
+*	@param[in] ui : screen
+*
+*	@return number of widgets redrawn
+*/
+uint32_t oled_ui_render(oled_ui_t *ui);
+
+/**
+*	@brief the framebuffer was cleared behind the widgets, redraw all of them
+*
+*	Call after ssd1306_clear() or anything else that wiped the screen.
+*
+*	@param[in] ui : screen
+*/
+void oled_ui_invalidate(oled_ui_t *ui);
+
+#endif
@@ -1,9 +1,14 @@
 import os
 import csv
+import json
+import socket
+import struct
+import threading
 from functools import wraps
 from flask import Flask, request, jsonify, render_template, Response
-from datetime import datetime
+from datetime import datetime, timedelta
 from dotenv import load_dotenv
+from werkzeug.serving import WSGIRequestHandler
 
 # Load environment variables
 load_dotenv()
@@ -13,7 +18,10 @@ app = Flask(__name__)
 # Configuration - use script directory for CSV
 SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
 DATA_FILE = os.path.join(SCRIPT_DIR, "sensor_data.csv")
+SPECTRUM_FILE = os.path.join(SCRIPT_DIR, "spectrum_data.csv")
+CONFIG_FILE = os.path.join(SCRIPT_DIR, "report_config.json")
 PORT = int(os.getenv("PORT", 5001))
+UDP_PORT = int(os.getenv("UDP_PORT", 5002))
 
 # Authentication credentials
 AUTH_USERNAME = os.getenv("AUTH_USERNAME", "admin")
@@ -47,22 +55,90 @@ def requires_auth(f):
     return decorated
 
 
-# Initialize CSV if it doesn't exist
-if not os.path.exists(DATA_FILE):
+CSV_FIELDS = [
+    "timestamp",
+    "lux",
+    "temp",
+    "rssi",
+    "uptime",
+    "accel_x",
+    "accel_y",
+    "accel_z",
+    "gyro_x",
+    "gyro_y",
+    "gyro_z",
+    "temp_mpu",
+    "vib_rms_x",
+    "vib_rms_y",
+    "vib_rms_z",
+    "vib_peak",
+    "vib_crest",
+    "sound_leq",
+    "sound_lmax",
+    "tx_sent",
+    "tx_suppressed",
+    "sched",
+    "net_rpc",
+    "net_latency_ms",
+]
+# Columns every row has had since the first firmware; newer ones may be empty
+REQUIRED_FIELDS = CSV_FIELDS[:8]
+# Vibration spectrum messages; bands and peaks are stored as JSON lists
+SPECTRUM_FIELDS = ["timestamp", "uptime", "fs", "n", "windows", "fft_cycles", "bands", "peaks"]
+
+
+def init_csv():
+    """Create the CSV, or add the new columns to a file from older firmware."""
+    if not os.path.exists(DATA_FILE):
+        with open(DATA_FILE, "w", newline="") as f:
+            csv.writer(f).writerow(CSV_FIELDS)
+        return
+
+    with open(DATA_FILE, "r", newline="") as f:
+        rows = list(csv.reader(f))
+    if rows and rows[0] == CSV_FIELDS:
+        return
+
+    old_fields = rows[0] if rows else []
     with open(DATA_FILE, "w", newline="") as f:
-        writer = csv.writer(f)
-        writer.writerow(
-            [
-                "timestamp",
-                "lux",
-                "temp",
-                "rssi",
-                "uptime",
-                "accel_x",
-                "accel_y",
-                "accel_z",
-            ]
-        )
+        writer = csv.DictWriter(f, fieldnames=CSV_FIELDS, restval="")
+        writer.writeheader()
+        for row in rows[1:]:
+            writer.writerow({k: v for k, v in zip(old_fields, row) if k in CSV_FIELDS})
+    print(f"Migrated {DATA_FILE} to {len(CSV_FIELDS)} columns")
+
+
+init_csv()
+
+# Report-by-exception settings handed to the device in every /submit_data
+# reply. Deadbands are in the units the firmware sends before scaling:
+# lux, temperatures and sound levels in hundredths, accel/gyro/vibration in
+# raw LSB.
+REPORT_CONFIG_DEFAULTS = {
+    "lux": 1000,
+    "temp": 20,
+    "accel": 300,
+    "gyro": 100,
+    "vib": 50,
+    "sound": 300,
+    "hyst": 50,
+    "hb": 60,
+}
+
+
+def load_report_config():
+    config = dict(REPORT_CONFIG_DEFAULTS)
+    if os.path.exists(CONFIG_FILE):
+        with open(CONFIG_FILE) as f:
+            config.update({k: int(v) for k, v in json.load(f).items() if k in config})
+    return config
+
+
+report_config = load_report_config()
+
+
+def report_config_string():
+    return ",".join(f"{k}={v}" for k, v in report_config.items())
 
 
 @app.route("/")
@@ -71,38 +147,365 @@ def index():
     return render_template("index.html")
 
 
+# Packed little-endian frames from the firmware (frame.h, sensor_frame.c):
+# version, type and payload length, then the fields of that version in order.
+# Fields are only appended within a version, so a longer payload still
+# decodes.
+FRAME_CONTENT_TYPE = "application/x-bitdog-frame"
+FRAME_HEADER = struct.Struct("<BBH")
+FRAME_SENSOR = 1
+SENSOR_V1 = struct.Struct("<I3i3h3h3H3H3H3hb2IB")
+SCHED_V1 = struct.Struct("<HI")
+NET_V1 = struct.Struct("<4I")
+# Acquisition scheduler channels, in firmware table order
+SCHED_CHANNELS = ["mpu", "bh1750", "sound", "rssi", "report"]
+
+
+def decode_sensor(version, payload):
+    """One sensor frame as the dict the JSON firmware sends."""
+    if version != 1:
+        raise ValueError(f"Unknown sensor frame version {version}")
+    v = SENSOR_V1.unpack_from(payload)
+    uptime, lux, temp, temp_mpu = v[0:4]
+    accel, gyro = v[4:7], v[7:10]
+    rms, peak, crest = v[10:13], v[13:16], v[16:19]
+    sound = v[19:22]
+    rssi, tx_sent, tx_suppressed, channels = v[22:26]
+    pos = SENSOR_V1.size
+    sched = {}
+    for i in range(channels):
+        rate, misses = SCHED_V1.unpack_from(payload, pos)
+        pos += SCHED_V1.size
+        sched[SCHED_CHANNELS[i] if i < len(SCHED_CHANNELS) else f"ch{i}"] = [rate / 100, misses]
+    rpc, lat_us, lat_max_us, conn = NET_V1.unpack_from(payload, pos)
+    return {
+        "lux": lux / 100,
+        "temp": temp / 100,
+        "rssi": rssi,
+        "uptime": uptime,
+        "accel": dict(zip("xyz", accel)),
+        "gyro": dict(zip("xyz", gyro)),
+        "temp_mpu": temp_mpu / 100,
+        # crest factor is Q8.8 on the wire
+        "vib": {"rms": list(rms), "peak": list(peak), "crest": [round(c / 256, 2) for c in crest]},
+        "sound": dict(zip(("leq", "lmax", "peak"), (s / 100 for s in sound))),
+        "tx": {"sent": tx_sent, "suppressed": tx_suppressed},
+        "sched": sched,
+        "net": {"rpc": rpc / 100, "lat_ms": round(lat_us / 1000, 2), "lat_max_ms": round(lat_max_us / 1000, 2), "conn": conn},
+    }
+
+
+def decode_frames(body):
+    """Sensor samples in a body of frames back to back; other types are skipped."""
+    samples = []
+    pos = 0
+    while pos < len(body):
+        version, frame_type, length = FRAME_HEADER.unpack_from(body, pos)
+        pos += FRAME_HEADER.size
+        payload = body[pos : pos + length]
+        if len(payload) < length:
+            raise ValueError("Truncated frame")
+        pos += length
+        if frame_type == FRAME_SENSOR:
+            samples.append(decode_sensor(version, payload))
+    return samples
+
+
+def request_samples():
+    """Samples in the request: binary frames, a JSON object or a JSON array."""
+    if request.mimetype == FRAME_CONTENT_TYPE:
+        return decode_frames(request.get_data())
+    data = request.json
+    return [data] if isinstance(data, dict) else data
+
+
+# Flask request threads and the UDP receiver append to the same file
+csv_lock = threading.Lock()
+
+
+def save_sample(data, timestamp):
+    """Append one sensor sample to the CSV."""
+    lux = data.get("lux", 0)
+    temp = data.get("temp", 0)
+    rssi = data.get("rssi", 0)
+    uptime = data.get("uptime", 0)
+    accel = data.get("accel", {})
+    ax = accel.get("x", 0)
+    ay = accel.get("y", 0)
+    az = accel.get("z", 0)
+    gyro = data.get("gyro", {})
+    gx = gyro.get("x", "")
+    gy = gyro.get("y", "")
+    gz = gyro.get("z", "")
+    temp_mpu = data.get("temp_mpu", "")
+    # Vibration features per accelerometer axis; peak and crest factor
+    # are stored for the worst axis
+    vib = data.get("vib", {})
+    rms = vib.get("rms") or ["", "", ""]
+    vib_peak = max(vib["peak"]) if vib.get("peak") else ""
+    vib_crest = max(vib["crest"]) if vib.get("crest") else ""
+    # Microphone levels in dBFS: equivalent level and loudest block
+    sound = data.get("sound", {})
+    sound_leq = sound.get("leq", "")
+    sound_lmax = sound.get("lmax", "")
+    tx = data.get("tx", {})
+    tx_sent = tx.get("sent", "")
+    tx_suppressed = tx.get("suppressed", "")
+    # Acquisition scheduler: {channel: [achieved Hz, deadline misses]}
+    sched = data.get("sched")
+    # Keep-alive connection: requests per connection, mean latency
+    net = data.get("net", {})
+    net_rpc = net.get("rpc", "")
+    net_latency = net.get("lat_ms", "")
+
+    with csv_lock, open(DATA_FILE, "a", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(
+            [timestamp, lux, temp, rssi, uptime, ax, ay, az, gx, gy, gz, temp_mpu]
+            + list(rms[:3])
+            + [vib_peak, vib_crest, sound_leq, sound_lmax, tx_sent, tx_suppressed]
+            + [json.dumps(sched) if sched else "", net_rpc, net_latency]
+        )
+
+    print(
+        f"[{timestamp}] Lux={lux:.1f} Temp={temp:.1f}°C RSSI={rssi}dBm Uptime={uptime}s Accel=({ax},{ay},{az}) Gyro=({gx},{gy},{gz}) MPU={temp_mpu}°C Vib={rms} crest={vib_crest} Sound={sound_leq}/{sound_lmax}dBFS Tx={tx_sent}/{tx_suppressed} Sched={sched} Net={net_rpc}req/conn {net_latency}ms"
+    )
+
+
+def save_samples(samples):
+    """Save samples the device held back, oldest first, dating each one
+    from its uptime relative to the newest."""
+    now = datetime.now()
+    newest = max(s.get("uptime", 0) for s in samples)
+    for data in samples:
+        age = newest - data.get("uptime", newest)
+        save_sample(data, (now - timedelta(seconds=age)).strftime("%Y-%m-%d %H:%M:%S"))
+
+
 @app.route("/submit_data", methods=["POST"])
 def submit_data():
     try:
-        data = request.json
-        if not data:
+        samples = request_samples()
+        if not samples:
             return jsonify({"error": "No data provided"}), 400
 
+        for data in samples:
+            save_sample(data, datetime.now().strftime("%Y-%m-%d %H:%M:%S"))
+        return (
+            jsonify({"status": "success", "message": "Data saved", "config": report_config_string()}),
+            200,
+        )
+
+    except (ValueError, struct.error) as e:
+        return jsonify({"error": f"Bad frame: {e}"}), 400
+    except Exception as e:
+        print(f"Error saving data: {e}")
+        return jsonify({"error": str(e)}), 500
+
+
+@app.route("/submit_batch", methods=["POST"])
+def submit_batch():
+    """Several samples, oldest first: a JSON array or binary frames."""
+    try:
+        samples = request_samples()
+        if not isinstance(samples, list) or not samples:
+            return jsonify({"error": "Expected a non-empty array or frames"}), 400
+
+        save_samples(samples)
+        return (
+            jsonify(
+                {
+                    "status": "success",
+                    "message": f"{len(samples)} samples saved",
+                    "config": report_config_string(),
+                }
+            ),
+            200,
+        )
+
+    except (ValueError, struct.error) as e:
+        return jsonify({"error": f"Bad frame: {e}"}), 400
+    except Exception as e:
+        print(f"Error saving batch: {e}")
+        return jsonify({"error": str(e)}), 500
+
+
+@app.route("/submit_spectrum", methods=["POST"])
+def submit_spectrum():
+    try:
+        data = request.json
+        if not data or "bands" not in data:
+            return jsonify({"error": "No spectrum provided"}), 400
+
         timestamp = datetime.now().strftime("%Y-%m-%d %H:%M:%S")
-        lux = data.get("lux", 0)
-        temp = data.get("temp", 0)
-        rssi = data.get("rssi", 0)
-        uptime = data.get("uptime", 0)
-        accel = data.get("accel", {})
-        ax = accel.get("x", 0)
-        ay = accel.get("y", 0)
-        az = accel.get("z", 0)
-
-        # Save to CSV
-        with open(DATA_FILE, "a", newline="") as f:
+        # bands: [low Hz, high Hz, rms], peaks: [frequency Hz, amplitude]
+        bands = data.get("bands", [])
+        peaks = data.get("peaks", [])
+        new_file = not os.path.exists(SPECTRUM_FILE)
+        with open(SPECTRUM_FILE, "a", newline="") as f:
             writer = csv.writer(f)
-            writer.writerow([timestamp, lux, temp, rssi, uptime, ax, ay, az])
+            if new_file:
+                writer.writerow(SPECTRUM_FIELDS)
+            writer.writerow(
+                [
+                    timestamp,
+                    data.get("uptime", 0),
+                    data.get("fs", 0),
+                    data.get("n", 0),
+                    data.get("windows", 0),
+                    data.get("fft_cycles", 0),
+                    json.dumps(bands),
+                    json.dumps(peaks),
+                ]
+            )
 
-        print(
-            f"[{timestamp}] Lux={lux:.1f} Temp={temp:.1f}°C RSSI={rssi}dBm Uptime={uptime}s Accel=({ax},{ay},{az})"
-        )
-        return jsonify({"status": "success", "message": "Data saved"}), 200
+        top = ", ".join(f"{p[0]}Hz:{p[1]}" for p in peaks)
+        print(f"[{timestamp}] Spectrum n={data.get('n')} windows={data.get('windows')} cycles={data.get('fft_cycles')} peaks=[{top}]")
+        return jsonify({"status": "success", "message": "Spectrum saved"}), 200
 
     except Exception as e:
-        print(f"Error saving data: {e}")
+        print(f"Error saving spectrum: {e}")
         return jsonify({"error": str(e)}), 500
 
 
+@app.route("/api/spectrum", methods=["GET"])
+@requires_auth
+def get_spectrum():
+    results = []
+    try:
+        if os.path.exists(SPECTRUM_FILE):
+            with open(SPECTRUM_FILE, "r") as f:
+                for row in list(csv.DictReader(f))[-20:]:
+                    row["bands"] = json.loads(row["bands"])
+                    row["peaks"] = json.loads(row["peaks"])
+                    results.append(row)
+    except Exception as e:
+        print(f"Error reading spectrum: {e}")
+    return jsonify(results)
+
+
+@app.route("/api/config", methods=["GET", "POST"])
+@requires_auth
+def api_config():
+    """Read or change the device's report-by-exception deadbands."""
+    if request.method == "POST":
+        changes = request.json or {}
+        unknown = [k for k in changes if k not in REPORT_CONFIG_DEFAULTS]
+        if unknown:
+            return jsonify({"error": f"Unknown keys: {', '.join(unknown)}"}), 400
+        try:
+            values = {k: int(v) for k, v in changes.items()}
+        except (TypeError, ValueError):
+            return jsonify({"error": "Values must be integers"}), 400
+        if any(v < 0 for v in values.values()):
+            return jsonify({"error": "Values must not be negative"}), 400
+        report_config.update(values)
+        with open(CONFIG_FILE, "w") as f:
+            json.dump(report_config, f, indent=2)
+        print(f"Report config: {report_config_string()}")
+    return jsonify(report_config)
+
+
+# UDP telemetry (udp_tx.h): a header with version, sample count, boot
+# session, sequence number and device time in ms, then sensor frames
+DATAGRAM_HEADER = struct.Struct("<BBHII")
+# Every n-th datagram is answered with the report config and logs the stats
+UDP_CONFIG_EVERY = 16
+# Sequence numbers this far behind are no longer waited for
+UDP_REORDER_WINDOW = 1024
+
+
+class SequenceStats:
+    """Loss and reordering of one sender, from its sequence numbers."""
+
+    def __init__(self, session):
+        self.session = session
+        self.received = 0
+        self.samples = 0
+        self.expected = None
+        self.lost = 0
+        self.gaps = 0
+        self.reordered = 0
+        self.duplicates = 0
+        self.missing = set()
+
+    def update(self, seq):
+        self.received += 1
+        if self.expected is None or seq == self.expected:
+            self.expected = seq + 1
+        elif seq > self.expected:
+            # everything skipped counts as lost until it shows up late
+            self.gaps += 1
+            self.lost += seq - self.expected
+            self.missing.update(range(max(self.expected, seq - UDP_REORDER_WINDOW), seq))
+            self.expected = seq + 1
+        elif seq in self.missing:
+            self.missing.discard(seq)
+            self.lost -= 1
+            self.reordered += 1
+        else:
+            self.duplicates += 1
+            return False
+        if len(self.missing) > UDP_REORDER_WINDOW:
+            self.missing = {m for m in self.missing if m >= self.expected - UDP_REORDER_WINDOW}
+        return True
+
+    def as_dict(self):
+        sent = self.received - self.duplicates + self.lost
+        return {
+            "session": self.session,
+            "received": self.received,
+            "samples": self.samples,
+            "lost": self.lost,
+            "loss_pct": round(100 * self.lost / sent, 2) if sent else 0,
+            "gaps": self.gaps,
+            "reordered": self.reordered,
+            "duplicates": self.duplicates,
+        }
+
+
+# Per device address; a new boot session starts the counts over
+udp_stats = {}
+
+
+def handle_datagram(sock, data, addr):
+    version, count, session, seq, time_ms = DATAGRAM_HEADER.unpack_from(data)
+    if version != 1:
+        raise ValueError(f"Unknown datagram version {version}")
+    stats = udp_stats.get(addr[0])
+    if stats is None or stats.session != session:
+        stats = udp_stats[addr[0]] = SequenceStats(session)
+        print(f"UDP: {addr[0]} session {session:04x}")
+    if stats.update(seq):
+        samples = decode_frames(data[DATAGRAM_HEADER.size :])
+        if samples:
+            stats.samples += len(samples)
+            save_samples(samples)
+    if seq % UDP_CONFIG_EVERY == 0:
+        print(f"UDP: {addr[0]} {stats.as_dict()}")
+        sock.sendto(json.dumps({"config": report_config_string()}).encode(), addr)
+
+
+def udp_receiver(port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", port))
+    print(f"Receiving UDP telemetry on port {port}")
+    while True:
+        data, addr = sock.recvfrom(2048)
+        try:
+            handle_datagram(sock, data, addr)
+        except (ValueError, struct.error) as e:
+            print(f"UDP: bad datagram from {addr[0]}: {e}")
+        except Exception as e:
+            print(f"Error saving datagram: {e}")
+
+
+@app.route("/api/udp", methods=["GET"])
+@requires_auth
+def get_udp_stats():
+    return jsonify({addr: stats.as_dict() for addr, stats in udp_stats.items()})
+
+
 @app.route("/api/data", methods=["GET"])
 @requires_auth
 def get_data():
@@ -112,8 +515,8 @@ def get_data():
             reader = csv.DictReader(f)
             data = []
             for row in reader:
-                # Filter out rows with None values
-                if all(v is not None and v != "" for v in row.values()):
+                # Skip broken rows; gyro/temp_mpu are empty in old ones
+                if all(row.get(k) not in (None, "") for k in REQUIRED_FIELDS):
                     data.append(row)
             results = data[-50:]
     except Exception as e:
@@ -123,4 +526,10 @@ def get_data():
 
 if __name__ == "__main__":
     print(f"Starting server on port {PORT}...")
+    # HTTP/1.1 keeps the device's connection open between posts; the
+    # default HTTP/1.0 closes it after every response
+    WSGIRequestHandler.protocol_version = "HTTP/1.1"
+    # debug mode runs the app in a reloader child; only that one listens
+    if os.environ.get("WERKZEUG_RUN_MAIN") == "true":
+        threading.Thread(target=udp_receiver, args=(UDP_PORT,), daemon=True).start()
     app.run(host="0.0.0.0", port=PORT, debug=True)
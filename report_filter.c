@@ -0,0 +1,75 @@
+/**
+* @file report_filter.c
+*
+* report by exception filter
+*/
+
+#include <string.h>
+
+#include "report_filter.h"
+
+bool report_filter_init(report_filter_t *f, uint32_t channels, uint32_t heartbeat_ms) {
+    if(channels<1 || channels>REPORT_MAX_CHANNELS)
+        return false;
+
+    memset(f, 0, sizeof(*f));
+    f->channels=channels;
+    f->heartbeat_ms=heartbeat_ms;
+    return true;
+}
+
+void report_filter_set(report_filter_t *f, uint32_t channel, int32_t deadband, int32_t hysteresis) {
+    if(channel>=f->channels)
+        return;
+
+    f->deadband[channel]=deadband<0?0:deadband;
+    f->hysteresis[channel]=hysteresis<0?0:hysteresis;
+}
+
+void report_filter_force(report_filter_t *f) {
+    f->primed=false;
+}
+
+report_reason_t report_filter_check(report_filter_t *f, const int32_t *values, uint32_t now_ms) {
+    report_reason_t reason=REPORT_SUPPRESSED;
+    uint32_t crossed=0;	// channels past their threshold in this record
+
+    if(!f->primed) {
+        reason=REPORT_FIRST;
+    } else {
+        for(uint32_t i=0; i<f->channels; ++i) {
+            int32_t delta=values[i]-f->last[i];
+            if(delta==0)
+                continue;
+            int8_t dir=delta>0?1:-1;
+            int32_t mag=delta>0?delta:-delta;
+            int32_t need=f->deadband[i]+(dir!=f->dir[i] && f->dir[i]!=0?f->hysteresis[i]:0);
+            if(mag>=need && mag>0) {
+                crossed|=1u<<i;
+                ++f->crossings[i];
+                reason=REPORT_CHANGE;
+            }
+        }
+        if(reason==REPORT_SUPPRESSED && f->heartbeat_ms && now_ms-f->last_sent_ms>=f->heartbeat_ms) {
+            ++f->heartbeats;
+            reason=REPORT_HEARTBEAT;
+        }
+    }
+
+    if(reason==REPORT_SUPPRESSED) {
+        ++f->suppressed;
+        return reason;
+    }
+
+    for(uint32_t i=0; i<f->channels; ++i) {
+        if(reason==REPORT_FIRST)
+            f->dir[i]=0;
+        else if(crossed&(1u<<i))
+            f->dir[i]=values[i]>f->last[i]?1:-1;
+        f->last[i]=values[i];
+    }
+    f->last_sent_ms=now_ms;
+    f->primed=true;
+    ++f->sent;
+    return reason;
+}
@@ -0,0 +1,91 @@
+/**
+* @file report_filter.h
+*
+* report by exception: a record is only transmitted when one of its channels
+* moved past its deadband since the last transmitted record, or when the
+* heartbeat interval passed without any transmission
+*/
+
+#ifndef _inc_report_filter
+#define _inc_report_filter
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+*	@brief most channels per filter
+*/
+#define REPORT_MAX_CHANNELS 12
+
+/**
+*	@brief why report_filter_check let a record through
+*/
+typedef enum {
+    REPORT_SUPPRESSED,	/**< nothing changed enough */
+    REPORT_FIRST,		/**< first record after init */
+    REPORT_CHANGE,		/**< a channel crossed its deadband */
+    REPORT_HEARTBEAT	/**< silence lasted heartbeat_ms */
+} report_reason_t;
+
+/**
+*	@brief filter state and statistics
+*/
+typedef struct {
+    uint32_t channels;
+    int32_t deadband[REPORT_MAX_CHANNELS];	/**< change that triggers a report, 0 reports every change */
+    int32_t hysteresis[REPORT_MAX_CHANNELS];	/**< extra change needed when the direction reverses */
+    int32_t last[REPORT_MAX_CHANNELS];		/**< values of the last record sent */
+    int8_t dir[REPORT_MAX_CHANNELS];		/**< direction of the last reported change */
+    uint32_t heartbeat_ms;	/**< longest silence, 0 for none */
+    uint32_t last_sent_ms;
+    bool primed;		/**< a record has been sent */
+    uint32_t sent;		/**< records let through */
+    uint32_t suppressed;	/**< records dropped */
+    uint32_t heartbeats;	/**< records sent only because of the heartbeat */
+    uint32_t crossings[REPORT_MAX_CHANNELS];	/**< reports triggered per channel */
+} report_filter_t;
+
+/**
+*	@brief set up a filter with all deadbands at 0 (report every change)
+*
+*	@param[in] f : filter
+*	@param[in] channels : values per record, up to REPORT_MAX_CHANNELS
+*	@param[in] heartbeat_ms : longest silence, 0 for none
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool report_filter_init(report_filter_t *f, uint32_t channels, uint32_t heartbeat_ms);
+
+/**
+*	@brief set the thresholds of one channel
+*
+*	@param[in] f : filter
+*	@param[in] channel : channel index
+*	@param[in] deadband : change from the last sent value that triggers a report
+*	@param[in] hysteresis : extra change needed when moving back against
+*	the last reported change, so noise around a level does not flip-flop
+*/
+void report_filter_set(report_filter_t *f, uint32_t channel, int32_t deadband, int32_t hysteresis);
+
+/**
+*	@brief decide whether a record goes out
+*
+*	When it does, its values become the new reference for every channel.
+*
+*	@param[in] f : filter
+*	@param[in] values : one value per channel
+*	@param[in] now_ms : current time
+*
+*	@return reason, REPORT_SUPPRESSED if the record should be dropped
+*/
+report_reason_t report_filter_check(report_filter_t *f, const int32_t *values, uint32_t now_ms);
+
+/**
+*	@brief send the next record regardless of its values
+*
+*	@param[in] f : filter
+*/
+void report_filter_force(report_filter_t *f);
+
+#endif
@@ -0,0 +1,44 @@
+/**
+* @file sensor_frame.c
+*
+* telemetry sample to binary frame
+*/
+
+#include "frame.h"
+#include "sensor_frame.h"
+
+size_t sensor_frame_encode(const sensor_data_t *data, const http_conn_t *net, void *buf, size_t size) {
+    frame_t f;
+
+    frame_begin(&f, buf, size, FRAME_SENSOR);
+    frame_u32(&f, data->uptime_sec);
+    frame_i32(&f, data->lux);
+    frame_i32(&f, data->temp_chip);
+    frame_i32(&f, data->temp_mpu);
+    for(int i=0; i<3; ++i)
+        frame_i16(&f, data->accel[i]);
+    for(int i=0; i<3; ++i)
+        frame_i16(&f, data->gyro[i]);
+    for(int i=0; i<3; ++i)
+        frame_u16(&f, data->vib_rms[i]);
+    for(int i=0; i<3; ++i)
+        frame_u16(&f, data->vib_peak[i]);
+    for(int i=0; i<3; ++i)
+        frame_u16(&f, data->vib_crest[i]);
+    frame_i16_sat(&f, data->sound_leq);
+    frame_i16_sat(&f, data->sound_lmax);
+    frame_i16_sat(&f, data->sound_peak);
+    frame_i8(&f, (int8_t) data->rssi);
+    frame_u32(&f, data->tx_sent);
+    frame_u32(&f, data->tx_suppressed);
+    frame_u8(&f, SCHED_CHANNELS);
+    for(int i=0; i<SCHED_CHANNELS; ++i) {
+        frame_u16(&f, data->sched_rate[i]);
+        frame_u32(&f, data->sched_misses[i]);
+    }
+    frame_u32(&f, http_conn_rpc_centi(net));
+    frame_u32(&f, net->requests?net->latency_sum_us/net->requests:0);
+    frame_u32(&f, net->latency_max_us);
+    frame_u32(&f, net->connections);
+    return frame_end(&f);
+}
@@ -0,0 +1,63 @@
+/**
+* @file sensor_frame.h
+*
+* one telemetry sample and its binary frame encoding. The layout is mirrored
+* by decode_sensor() in pico-server/server.py; any change to it needs a new
+* FRAME_VERSION there and here
+*/
+
+#ifndef _inc_sensor_frame
+#define _inc_sensor_frame
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "http_conn.h"
+
+/**
+*	@brief acquisition scheduler channels, in firmware table order
+*/
+typedef enum {
+    SCHED_MPU,
+    SCHED_BH1750,
+    SCHED_SOUND,
+    SCHED_RSSI,
+    SCHED_REPORT,
+    SCHED_CHANNELS
+} sched_channel_t;
+
+/**
+*	@brief one telemetry sample
+*/
+typedef struct {
+    int32_t lux;		/**< centilux */
+    int32_t temp_chip;	/**< hundredths of a degree */
+    int16_t accel[3];	/**< window means, raw LSB */
+    int16_t gyro[3];
+    uint16_t vib_rms[3], vib_peak[3];	/**< accel around the mean, raw LSB */
+    uint16_t vib_crest[3];	/**< peak / rms in Q8.8 */
+    int32_t temp_mpu;	/**< hundredths of a degree */
+    int32_t sound_leq, sound_lmax, sound_peak;	/**< hundredths of a dBFS */
+    uint32_t tx_sent, tx_suppressed;	/**< report filter counters */
+    uint16_t sched_rate[SCHED_CHANNELS];	/**< achieved reads/s in hundredths */
+    uint32_t sched_misses[SCHED_CHANNELS];	/**< deadline misses since boot */
+    int32_t rssi;
+    uint32_t uptime_sec;
+} sensor_data_t;
+
+/**
+*	@brief encode a sample as one FRAME_SENSOR frame
+*
+*	Same content as the JSON the firmware sends, about a fifth of the bytes
+*	and no printf.
+*
+*	@param[in] data : sample
+*	@param[in] net : connection whose statistics go in the frame
+*	@param[in] buf : destination
+*	@param[in] size : room in buf
+*
+*	@return frame length, 0 if it did not fit
+*/
+size_t sensor_frame_encode(const sensor_data_t *data, const http_conn_t *net, void *buf, size_t size);
+
+#endif
@@ -0,0 +1,158 @@
+/**
+* @file sensor_sched.c
+*
+* table-driven acquisition scheduler
+*/
+
+#include "sensor_sched.h"
+
+// a after b, with wrap around
+#define SENSOR_SCHED_AFTER(a, b) ((int32_t) ((a)-(b))>0)
+
+// time the channel wants the cpu next: its start, or its read
+static uint32_t sensor_sched_action_ms(const sensor_sched_t *s, size_t i) {
+    const sensor_sched_channel_t *c=&s->ch[i];
+    const sensor_sched_state_t *st=&s->st[i];
+
+    if(c->start && !st->converting)
+        return st->next_ms-c->conversion_ms;
+    // a start that had to wait for its bus pushes the read back
+    if(st->converting && SENSOR_SCHED_AFTER(st->ready_ms, st->next_ms))
+        return st->ready_ms;
+    return st->next_ms;
+}
+
+static void sensor_sched_read(sensor_sched_t *s, size_t i, uint32_t now_ms) {
+    const sensor_sched_channel_t *c=&s->ch[i];
+    sensor_sched_state_t *st=&s->st[i];
+    uint32_t late=SENSOR_SCHED_AFTER(now_ms, st->next_ms)?now_ms-st->next_ms:0;
+
+    if(!c->read(c->arg))
+        ++st->errors;
+    ++st->reads;
+    ++st->window_reads;
+    st->converting=false;
+    if(late>st->late_max_ms)
+        st->late_max_ms=late;
+
+    if(c->event) {
+        // ran without its event: the source stalled
+        if(!st->released)
+            ++st->misses;
+        st->released=false;
+        st->next_ms=now_ms+2*c->period_ms;
+        return;
+    }
+
+    if(late>c->period_ms/2)
+        ++st->misses;
+    // keep the phase; whole periods that went by are misses too
+    st->next_ms+=c->period_ms;
+    while(!SENSOR_SCHED_AFTER(st->next_ms, now_ms)) {
+        st->next_ms+=c->period_ms;
+        ++st->misses;
+    }
+}
+
+bool sensor_sched_init(sensor_sched_t *s, const sensor_sched_channel_t *table, size_t count, uint32_t now_ms) {
+    s->ch=table;
+    s->count=0;
+    s->passes=0;
+
+    if(count>SENSOR_SCHED_MAX)
+        return false;
+
+    for(size_t i=0; i<count; ++i) {
+        sensor_sched_state_t *st=&s->st[i];
+        if(table[i].period_ms==0 || table[i].read==NULL)
+            return false;
+        *st=(sensor_sched_state_t) {0};
+        // the first conversion starts no earlier than now
+        st->next_ms=now_ms+table[i].offset_ms+(table[i].start?table[i].conversion_ms:0);
+        if(table[i].event)
+            st->next_ms+=2*table[i].period_ms;
+    }
+    s->count=count;
+    sensor_sched_stats_reset(s, now_ms);
+    return true;
+}
+
+void sensor_sched_release(sensor_sched_t *s, size_t idx, uint32_t now_ms) {
+    if(idx>=s->count)
+        return;
+    s->st[idx].released=true;
+    s->st[idx].next_ms=now_ms;
+}
+
+uint32_t sensor_sched_run(sensor_sched_t *s, uint32_t now_ms) {
+    uint32_t busy=0, done=0;
+    bool blocked=false;
+
+    while(1) {
+        // earliest due action among the channels not run yet in this pass
+        size_t best=s->count;
+        for(size_t i=0; i<s->count; ++i) {
+            if(done&(1u<<i) || SENSOR_SCHED_AFTER(sensor_sched_action_ms(s, i), now_ms))
+                continue;
+            uint8_t bus=s->ch[i].bus;
+            if(bus!=SENSOR_SCHED_NO_BUS && (busy&(1u<<(bus&31)))) {
+                blocked=true;
+                continue;
+            }
+            if(best==s->count || SENSOR_SCHED_AFTER(sensor_sched_action_ms(s, best), sensor_sched_action_ms(s, i)))
+                best=i;
+        }
+        if(best==s->count)
+            break;
+
+        const sensor_sched_channel_t *c=&s->ch[best];
+        sensor_sched_state_t *st=&s->st[best];
+        done|=1u<<best;
+        if(c->bus!=SENSOR_SCHED_NO_BUS)
+            busy|=1u<<(c->bus&31);
+
+        if(c->start && !st->converting) {
+            if(c->start(c->arg)) {
+                st->converting=true;
+                st->ready_ms=now_ms+c->conversion_ms;
+            } else {
+                // try again next period
+                ++st->errors;
+                st->next_ms+=c->period_ms;
+            }
+        } else {
+            sensor_sched_read(s, best, now_ms);
+        }
+    }
+
+    if(done)
+        ++s->passes;
+    if(blocked)
+        return 0;
+
+    uint32_t wait=UINT32_MAX;
+    for(size_t i=0; i<s->count; ++i) {
+        uint32_t at=sensor_sched_action_ms(s, i);
+        if(!SENSOR_SCHED_AFTER(at, now_ms))
+            return 0;
+        if(at-now_ms<wait)
+            wait=at-now_ms;
+    }
+    return wait;
+}
+
+uint32_t sensor_sched_rate_chz(const sensor_sched_t *s, size_t idx, uint32_t now_ms) {
+    uint32_t elapsed=now_ms-s->window_start_ms;
+
+    if(idx>=s->count || elapsed==0)
+        return 0;
+    return (uint32_t) ((uint64_t) s->st[idx].window_reads*100000/elapsed);
+}
+
+void sensor_sched_stats_reset(sensor_sched_t *s, uint32_t now_ms) {
+    s->window_start_ms=now_ms;
+    for(size_t i=0; i<s->count; ++i) {
+        s->st[i].window_reads=0;
+        s->st[i].late_max_ms=0;
+    }
+}
@@ -0,0 +1,118 @@
+/**
+* @file sensor_sched.h
+*
+* table-driven acquisition scheduler: every channel declares its period,
+* conversion time and bus; conversions are started early enough for the
+* result to be ready at the read deadline, channels sharing a bus take turns
+* and each channel keeps its achieved rate and deadline misses
+*/
+
+#ifndef _inc_sensor_sched
+#define _inc_sensor_sched
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+*	@brief most channels per scheduler
+*/
+#define SENSOR_SCHED_MAX 8
+
+/**
+*	@brief bus of a channel that does not touch a shared bus
+*/
+#define SENSOR_SCHED_NO_BUS 0xFF
+
+/**
+*	@brief one acquisition channel, usually in a const table
+*
+*	A read is due every period_ms. With start set, the conversion is started
+*	conversion_ms before the read. Event channels are due when released
+*	(see sensor_sched_release); the period is the expected release interval
+*	and after two periods without a release they run anyway, as a miss.
+*	A read later than half a period is a deadline miss.
+*/
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    uint32_t conversion_ms;	/**< start to result ready, 0 without start */
+    uint32_t offset_ms;		/**< first read this long after init */
+    uint8_t bus;			/**< channels on the same bus never run in the same pass, or SENSOR_SCHED_NO_BUS */
+    bool event;				/**< released by sensor_sched_release */
+    bool (*start)(void *arg);	/**< begin a conversion, may be NULL */
+    bool (*read)(void *arg);	/**< fetch and use the result */
+    void *arg;
+} sensor_sched_channel_t;
+
+/**
+*	@brief per channel state and statistics
+*/
+typedef struct {
+    uint32_t next_ms;		/**< read deadline */
+    bool converting;		/**< start done, read pending */
+    uint32_t ready_ms;		/**< result of the running conversion ready */
+    bool released;			/**< event arrived */
+    uint32_t reads;			/**< reads done */
+    uint32_t errors;		/**< start or read returned false */
+    uint32_t misses;		/**< late reads and skipped periods */
+    uint32_t late_max_ms;	/**< worst read time past the deadline */
+    uint32_t window_reads;	/**< reads since sensor_sched_stats_reset */
+} sensor_sched_state_t;
+
+/**
+*	@brief scheduler
+*/
+typedef struct {
+    const sensor_sched_channel_t *ch;
+    size_t count;
+    sensor_sched_state_t st[SENSOR_SCHED_MAX];
+    uint32_t window_start_ms;	/**< since sensor_sched_stats_reset */
+    uint32_t passes;		/**< sensor_sched_run calls that did work */
+} sensor_sched_t;
+
+/**
+*	@brief set up a scheduler over a channel table
+*
+*	@param[in] s : scheduler
+*	@param[in] table : channels, must outlive the scheduler
+*	@param[in] count : channels in table, up to SENSOR_SCHED_MAX
+*	@param[in] now_ms : current time
+*
+*	@return bool.
+*	@retval false if count is too large or a period is 0
+*/
+bool sensor_sched_init(sensor_sched_t *s, const sensor_sched_channel_t *table, size_t count, uint32_t now_ms);
+
+/**
+*	@brief make an event channel due now
+*
+*	@param[in] s : scheduler
+*	@param[in] idx : channel
+*	@param[in] now_ms : current time
+*/
+void sensor_sched_release(sensor_sched_t *s, size_t idx, uint32_t now_ms);
+
+/**
+*	@brief run the due starts and reads, earliest deadline first, one per bus
+*
+*	@param[in] s : scheduler
+*	@param[in] now_ms : current time
+*
+*	@return ms until the next start or read, 0 if work is still due
+*/
+uint32_t sensor_sched_run(sensor_sched_t *s, uint32_t now_ms);
+
+/**
+*	@brief achieved read rate since sensor_sched_stats_reset
+*
+*	@return reads per second in hundredths
+*/
+uint32_t sensor_sched_rate_chz(const sensor_sched_t *s, size_t idx, uint32_t now_ms);
+
+/**
+*	@brief start a new window for sensor_sched_rate_chz and late_max_ms
+*/
+void sensor_sched_stats_reset(sensor_sched_t *s, uint32_t now_ms);
+
+#endif
@@ -24,7 +24,6 @@ SOFTWARE.
 */
 
 #include <pico/stdlib.h>
-#include <hardware/i2c.h>
 #include <pico/binary_info.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,39 +32,103 @@ SOFTWARE.
 #include "ssd1306.h"
 #include "font.h"
 
-inline static void swap(int32_t *a, int32_t *b) {
-    int32_t *t=a;
-    *a=*b;
-    *b=*t;
+// one complete i2c transaction (control byte included) through the transport
+inline static void ssd1306_xfer(ssd1306_t *p, const uint8_t *src, size_t len) {
+    ++p->transport->transactions;
+    p->transport->bytes+=len;
+    p->transport->write(p->transport, p->address, src, len);
 }
 
-inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, char *name) {
-    switch(i2c_write_blocking(i2c, addr, src, len, false)) {
-    case PICO_ERROR_GENERIC:
-        printf("[%s] addr not acknowledged!\n", name);
-        break;
-    case PICO_ERROR_TIMEOUT:
-        printf("[%s] timeout!\n", name);
-        break;
-    default:
-        //printf("[%s] wrote successfully %lu bytes!\n", name, len);
-        break;
+// packs a command sequence behind a single 0x00 control byte
+static void ssd1306_queue_command(ssd1306_t *p, const uint8_t *cmds, size_t len) {
+    uint8_t d[1+SSD1306_MAX_COMMAND];
+
+    while(len) {
+        size_t n=len>SSD1306_MAX_COMMAND?SSD1306_MAX_COMMAND:len;
+
+        d[0]=0x00;
+        memcpy(d+1, cmds, n);
+        ssd1306_xfer(p, d, n+1);
+
+        cmds+=n;
+        len-=n;
     }
 }
 
+void ssd1306_command(ssd1306_t *p, const uint8_t *cmds, size_t len) {
+    ssd1306_queue_command(p, cmds, len);
+    p->transport->commit(p->transport, p->address, NULL, NULL);
+}
+
 inline static void ssd1306_write(ssd1306_t *p, uint8_t val) {
-    uint8_t d[2]= {0x00, val};
-    fancy_write(p->i2c_i, p->address, d, 2, "ssd1306_write");
+    ssd1306_command(p, &val, 1);
+}
+
+// approximate bus cost (bytes incl. address) of opening a new column/page window
+#define SSD1306_WINDOW_OVERHEAD 9
+
+inline static void ssd1306_mark_dirty(ssd1306_t *p, uint32_t page, uint32_t x0, uint32_t x1) {
+    if(x0<p->dirty_min[page])
+        p->dirty_min[page]=x0;
+    if(x1>p->dirty_max[page])
+        p->dirty_max[page]=x1;
+}
+
+inline static void ssd1306_mark_all_dirty(ssd1306_t *p) {
+    for(uint8_t page=0; page<p->pages; ++page)
+        ssd1306_mark_dirty(p, page, 0, p->width-1);
+}
+
+inline static void ssd1306_mark_clean(ssd1306_t *p, uint32_t page) {
+    p->dirty_min[page]=0xFF;
+    p->dirty_max[page]=0;
+}
+
+// in double buffer mode the transmitter works on front and the ranges handed
+// over by ssd1306_swap, otherwise directly on the drawing buffer
+inline static uint8_t *ssd1306_tx_buffer(ssd1306_t *p) {
+    return p->front?p->front:p->buffer;
+}
+
+inline static uint8_t *ssd1306_tx_min(ssd1306_t *p) {
+    return p->front?p->pending_min:p->dirty_min;
+}
+
+inline static uint8_t *ssd1306_tx_max(ssd1306_t *p) {
+    return p->front?p->pending_max:p->dirty_max;
 }
 
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance) {
+    p->i2c_i=i2c_instance;
+
+    // room for a full frame split into one window per page
+    ssd1306_i2c_transport_init(&p->i2c, i2c_instance, (height/8)*(width+1+8)+SSD1306_MAX_COMMAND+1);
+    if(!ssd1306_init_with_transport(p, width, height, address, &p->i2c.base)) {
+        ssd1306_i2c_transport_deinit(&p->i2c);
+        return false;
+    }
+
+    return true;
+}
+
+bool ssd1306_init_with_transport(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, ssd1306_transport_t *transport) {
     p->width=width;
     p->height=height;
     p->pages=height/8;
     p->address=address;
 
-    p->i2c_i=i2c_instance;
+    if(p->pages>SSD1306_MAX_PAGES)
+        return false;
 
+    p->transport=transport;
+    p->front=NULL;
+    p->done_cb=NULL;
+    p->last_show_us=0;
+    p->start_line=0;
+    p->pending_start_line=0;
+    p->sent_start_line=0;	// set by the init sequence below
+    p->console=false;
+    p->console_lines=0;
 
     p->bufsize=(p->pages)*(p->width);
     if((p->buffer=malloc(p->bufsize+1))==NULL) {
@@ -75,6 +138,19 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
 
     ++(p->buffer);
 
+    if((p->shadow=malloc(p->bufsize))==NULL) {
+        free(p->buffer-1);
+        p->bufsize=0;
+        return false;
+    }
+
+    // display RAM content is unknown after power up, first show sends everything
+    p->shadow_valid=false;
+    p->skipped_bytes=0;
+    for(uint8_t page=0; page<SSD1306_MAX_PAGES; ++page)
+        ssd1306_mark_clean(p, page);
+    ssd1306_mark_all_dirty(p);
+
     // from https://github.com/makerportal/rpi-pico-ssd1306
     uint8_t cmds[]= {
         SET_DISP,
@@ -109,14 +185,19 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
         0x00,  // horizontal
     };
 
-    for(size_t i=0; i<sizeof(cmds); ++i)
-        ssd1306_write(p, cmds[i]);
+    ssd1306_command(p, cmds, sizeof(cmds));
 
     return true;
 }
 
 inline void ssd1306_deinit(ssd1306_t *p) {
+    ssd1306_show_wait(p);
+    if(p->transport==&p->i2c.base)
+        ssd1306_i2c_transport_deinit(&p->i2c);
     free(p->buffer-1);
+    free(p->shadow);
+    if(p->front)
+        free(p->front-1);
 }
 
 inline void ssd1306_poweroff(ssd1306_t *p) {
@@ -128,8 +209,8 @@ inline void ssd1306_poweron(ssd1306_t *p) {
 }
 
 inline void ssd1306_contrast(ssd1306_t *p, uint8_t val) {
-    ssd1306_write(p, SET_CONTRAST);
-    ssd1306_write(p, val);
+    uint8_t cmds[]= {SET_CONTRAST, val};
+    ssd1306_command(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_invert(ssd1306_t *p, uint8_t inv) {
@@ -138,52 +219,95 @@ inline void ssd1306_invert(ssd1306_t *p, uint8_t inv) {
 
 inline void ssd1306_clear(ssd1306_t *p) {
     memset(p->buffer, 0, p->bufsize);
+    ssd1306_mark_all_dirty(p);
 }
 
 void ssd1306_clear_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
     if(x>=p->width || y>=p->height) return;
 
     p->buffer[x+p->width*(y>>3)]&=~(0x1<<(y&0x07));
+    ssd1306_mark_dirty(p, y>>3, x, x);
 }
 
 void ssd1306_draw_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
     if(x>=p->width || y>=p->height) return;
 
     p->buffer[x+p->width*(y>>3)]|=0x1<<(y&0x07); // y>>3==y/8 && y&0x7==y%8
+    ssd1306_mark_dirty(p, y>>3, x, x);
 }
 
-void ssd1306_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
-    if(x1>x2) {
-        swap(&x1, &x2);
-        swap(&y1, &y2);
+// sets or clears a clipped rectangle a whole page byte at a time
+static void ssd1306_fill_rect(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height, bool set) {
+    if(x>=p->width || y>=p->height || width==0 || height==0)
+        return;
+    if(width>p->width-x)
+        width=p->width-x;
+    if(height>p->height-y)
+        height=p->height-y;
+
+    uint32_t y_end=y+height;
+    for(uint32_t page=y>>3; page<=(y_end-1)>>3; ++page) {
+        uint32_t top=page<<3;
+        uint8_t mask=0xFF;
+
+        if(y>top)
+            mask&=0xFF<<(y-top);
+        if(y_end<top+8)
+            mask&=0xFF>>(top+8-y_end);
+
+        uint8_t *dst=p->buffer+page*p->width+x;
+        if(mask==0xFF)
+            memset(dst, set?0xFF:0x00, width);
+        else if(set)
+            for(uint32_t c=0; c<width; ++c)
+                dst[c]|=mask;
+        else
+            for(uint32_t c=0; c<width; ++c)
+                dst[c]&=~mask;
+
+        ssd1306_mark_dirty(p, page, x, x+width-1);
     }
+}
 
-    if(x1==x2) {
-        if(y1>y2)
-            swap(&y1, &y2);
-        for(int32_t i=y1; i<=y2; ++i)
-            ssd1306_draw_pixel(p, x1, i);
+void ssd1306_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    // straight lines are just one pixel wide rectangles
+    if(y1==y2 && x1>=0 && x2>=0 && y1>=0) {
+        ssd1306_fill_rect(p, x1<x2?x1:x2, y1, abs(x2-x1)+1, 1, true);
+        return;
+    }
+    if(x1==x2 && x1>=0 && y1>=0 && y2>=0) {
+        ssd1306_fill_rect(p, x1, y1<y2?y1:y2, 1, abs(y2-y1)+1, true);
         return;
     }
 
-    float m=(float) (y2-y1) / (float) (x2-x1);
+    // integer bresenham, works in all octants without gaps
+    int32_t dx=abs(x2-x1), sx=x1<x2?1:-1;
+    int32_t dy=-abs(y2-y1), sy=y1<y2?1:-1;
+    int32_t err=dx+dy;
 
-    for(int32_t i=x1; i<=x2; ++i) {
-        float y=m*(float) (i-x1)+(float) y1;
-        ssd1306_draw_pixel(p, i, (uint32_t) y);
+    for(;;) {
+        ssd1306_draw_pixel(p, x1, y1);
+        if(x1==x2 && y1==y2)
+            break;
+
+        int32_t e2=2*err;
+        if(e2>=dy) {
+            err+=dy;
+            x1+=sx;
+        }
+        if(e2<=dx) {
+            err+=dx;
+            y1+=sy;
+        }
     }
 }
 
 void ssd1306_clear_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
-    for(uint32_t i=0; i<width; ++i)
-        for(uint32_t j=0; j<height; ++j)
-            ssd1306_clear_pixel(p, x+i, y+j);
+    ssd1306_fill_rect(p, x, y, width, height, false);
 }
 
 void ssd1306_draw_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
-    for(uint32_t i=0; i<width; ++i)
-        for(uint32_t j=0; j<height; ++j)
-            ssd1306_draw_pixel(p, x+i, y+j);
+    ssd1306_fill_rect(p, x, y, width, height, true);
 }
 
 void ssd1306_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
@@ -193,10 +317,87 @@ void ssd1306_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t wi
     ssd1306_draw_line(p, x+width, y, x+width, y+height);
 }
 
+// ORs a page-ordered bitmap (stride bytes per page row) into the buffer at any y
+static void ssd1306_blit_or(ssd1306_t *p, uint32_t x, uint32_t y, const uint8_t *src, uint32_t cols, uint32_t stride, uint32_t src_pages) {
+    if(x>=p->width || y>=p->height)
+        return;
+    if(cols>p->width-x)
+        cols=p->width-x;
+
+    uint32_t page=y>>3, shift=y&7;
+    for(uint32_t sp=0; sp<src_pages; ++sp, ++page, src+=stride) {
+        if(page>=p->pages)
+            break;
+
+        uint8_t *dst=p->buffer+page*p->width+x;
+        for(uint32_t c=0; c<cols; ++c)
+            dst[c]|=src[c]<<shift;
+        ssd1306_mark_dirty(p, page, x, x+cols-1);
+
+        if(shift && page+1<p->pages) {
+            dst+=p->width;
+            for(uint32_t c=0; c<cols; ++c)
+                dst[c]|=src[c]>>(8-shift);
+            ssd1306_mark_dirty(p, page+1, x, x+cols-1);
+        }
+    }
+}
+
+#define SSD1306_GLYPH_CACHE_SIZE 16
+#define SSD1306_GLYPH_CACHE_MAX_SCALE 3
+#define SSD1306_GLYPH_CACHE_MAX_COLS 16
+
+// direct mapped cache of upscaled single-page glyphs, shared by all displays
+// (draw calls are expected to be serialized by the caller anyway)
+static struct {
+    const uint8_t *font;
+    char c;
+    uint8_t scale;
+    uint8_t data[SSD1306_GLYPH_CACHE_MAX_SCALE*SSD1306_GLYPH_CACHE_MAX_COLS];
+} ssd1306_glyph_cache[SSD1306_GLYPH_CACHE_SIZE];
+
+static const uint8_t *ssd1306_scaled_glyph(const uint8_t *font, char c, uint32_t scale) {
+    uint32_t slot=((uint8_t) c+scale*7)%SSD1306_GLYPH_CACHE_SIZE;
+    uint32_t cols=font[1]*scale;
+
+    if(ssd1306_glyph_cache[slot].font==font && ssd1306_glyph_cache[slot].c==c && ssd1306_glyph_cache[slot].scale==scale)
+        return ssd1306_glyph_cache[slot].data;
+
+    const uint8_t *glyph=font+5+(c-font[3])*font[1];
+    uint8_t *data=ssd1306_glyph_cache[slot].data;
+
+    for(uint32_t w=0; w<font[1]; ++w) {
+        uint32_t column=0;
+        for(uint32_t j=0; j<8; ++j)
+            if(glyph[w]&(1<<j))
+                column|=((1u<<scale)-1)<<(j*scale);
+
+        for(uint32_t s=0; s<scale; ++s)
+            for(uint32_t sp=0; sp<scale; ++sp)
+                data[sp*cols+w*scale+s]=column>>(sp*8);
+    }
+
+    ssd1306_glyph_cache[slot].font=font;
+    ssd1306_glyph_cache[slot].c=c;
+    ssd1306_glyph_cache[slot].scale=scale;
+    return data;
+}
+
 void ssd1306_draw_char_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, char c) {
     if(c<font[3]||c>font[4])
         return;
 
+    // fonts up to 8 rows high are one byte per column, same layout as a page
+    if(font[0]<=8 && scale==1) {
+        ssd1306_blit_or(p, x, y, font+5+(c-font[3])*font[1], font[1], font[1], 1);
+        return;
+    }
+
+    if(font[0]<=8 && scale>1 && scale<=SSD1306_GLYPH_CACHE_MAX_SCALE && font[1]*scale<=SSD1306_GLYPH_CACHE_MAX_COLS) {
+        ssd1306_blit_or(p, x, y, ssd1306_scaled_glyph(font, c, scale), font[1]*scale, font[1]*scale, scale);
+        return;
+    }
+
     uint32_t parts_per_line=(font[0]>>3)+((font[0]&7)>0);
     for(uint8_t w=0; w<font[1]; ++w) { // width
         uint32_t pp=(c-font[3])*font[1]*parts_per_line+w*parts_per_line+5;
@@ -227,6 +428,34 @@ void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, c
     ssd1306_draw_string_with_font(p, x, y, scale, font_8x5, s);
 }
 
+uint32_t ssd1306_draw_string_font(ssd1306_t *p, uint32_t x, uint32_t y, const ssd1306_font_t *font, const char *s) {
+    for(; *s; ++s) {
+        uint8_t c=*s;
+        if(c<font->first || c>font->last)
+            continue;
+
+        uint32_t i=c-font->first, w=font->width[i];
+        if(w==0)
+            continue;
+
+        ssd1306_blit_or(p, x, y, font->data+font->offset[i], w, w, font->height>>3);
+        x+=w+font->spacing;
+    }
+    return x;
+}
+
+uint32_t ssd1306_string_width(const ssd1306_font_t *font, const char *s) {
+    uint32_t width=0;
+
+    for(; *s; ++s) {
+        uint8_t c=*s;
+        if(c<font->first || c>font->last || font->width[c-font->first]==0)
+            continue;
+        width+=font->width[c-font->first]+font->spacing;
+    }
+    return width?width-font->spacing:0;
+}
+
 static inline uint32_t ssd1306_bmp_get_val(const uint8_t *data, const size_t offset, uint8_t size) {
     switch(size) {
     case 1:
@@ -290,17 +519,299 @@ inline void ssd1306_bmp_show_image(ssd1306_t *p, const uint8_t *data, const long
     ssd1306_bmp_show_image_with_offset(p, data, size, 0, 0);
 }
 
-void ssd1306_show(ssd1306_t *p) {
-    uint8_t payload[]= {SET_COL_ADDR, 0, p->width-1, SET_PAGE_ADDR, 0, p->pages-1};
+// replaces the rows selected by mask of one image page row at pixel row y
+static void ssd1306_copy_page_row(ssd1306_t *p, uint32_t x, uint32_t y, const uint8_t *src, uint32_t cols, uint8_t mask) {
+    if(x>=p->width || y>=p->height)
+        return;
+    if(cols>p->width-x)
+        cols=p->width-x;
+
+    uint32_t page=y>>3, shift=y&7;
+    uint8_t *dst=p->buffer+page*p->width+x;
+
+    if(shift==0 && mask==0xFF) {
+        memcpy(dst, src, cols);
+    } else {
+        uint8_t keep=~(mask<<shift);
+        for(uint32_t c=0; c<cols; ++c)
+            dst[c]=(dst[c]&keep)|((src[c]&mask)<<shift);
+    }
+    ssd1306_mark_dirty(p, page, x, x+cols-1);
+
+    if(shift && page+1<p->pages) {
+        uint8_t keep=~(mask>>(8-shift));
+        dst+=p->width;
+        for(uint32_t c=0; c<cols; ++c)
+            dst[c]=(dst[c]&keep)|((src[c]&mask)>>(8-shift));
+        ssd1306_mark_dirty(p, page+1, x, x+cols-1);
+    }
+}
+
+void ssd1306_blit_native(ssd1306_t *p, uint32_t x, uint32_t y, const ssd1306_image_t *img) {
+    uint32_t img_pages=(img->height+7)>>3;
+    const uint8_t *src=img->data, *end=img->data+img->size;
+    uint8_t line[255];
+    uint32_t run=0;
+    bool literal=false;
+
+    for(uint32_t r=0; r<img_pages; ++r) {
+        uint8_t mask=(r==img_pages-1 && (img->height&7))?(1<<(img->height&7))-1:0xFF;
+        const uint8_t *row=src;
+
+        if(img->rle) {
+            // PackBits runs may continue across page rows
+            for(uint32_t c=0; c<img->width; ++c) {
+                if(run==0) {
+                    if(src>=end)
+                        return;
+                    uint8_t n=*src++;
+                    literal=n<128;
+                    run=literal?n+1:n-126;
+                }
+                line[c]=*src;
+                if(literal || run==1)
+                    ++src;
+                --run;
+            }
+            row=line;
+        } else {
+            src+=img->width;
+        }
+
+        ssd1306_copy_page_row(p, x, y+(r<<3), row, img->width, mask);
+    }
+}
+
+static void ssd1306_send_window(ssd1306_t *p, uint32_t page0, uint32_t page1, uint32_t x0, uint32_t x1) {
+    uint8_t payload[]= {SET_COL_ADDR, x0, x1, SET_PAGE_ADDR, page0, page1};
     if(p->width==64) {
         payload[1]+=32;
         payload[2]+=32;
     }
 
-    for(size_t i=0; i<sizeof(payload); ++i)
-        ssd1306_write(p, payload[i]);
+    ssd1306_queue_command(p, payload, sizeof(payload));
+
+    // the display keeps its RAM pointer between transactions, so each page
+    // slice goes out on its own, prefixed in place by the data control byte
+    for(uint32_t page=page0; page<=page1; ++page) {
+        uint8_t *row=ssd1306_tx_buffer(p)+page*p->width+x0;
+        uint8_t saved=*(row-1);
+
+        *(row-1)=0x40;
+        ssd1306_xfer(p, row-1, x1-x0+2);
+        *(row-1)=saved;
+
+        memcpy(p->shadow+page*p->width+x0, row, x1-x0+1);
+    }
+}
+
+static void ssd1306_render(ssd1306_t *p) {
+    int32_t x0[SSD1306_MAX_PAGES], x1[SSD1306_MAX_PAGES];
+    uint8_t *dmin=ssd1306_tx_min(p), *dmax=ssd1306_tx_max(p);
+
+    // shrink every dirty range to the bytes that really differ from display RAM
+    for(uint32_t page=0; page<p->pages; ++page) {
+        const uint8_t *row=ssd1306_tx_buffer(p)+page*p->width;
+        const uint8_t *shadow=p->shadow+page*p->width;
+        int32_t a=dmin[page], b=dmax[page];
+
+        if(!p->shadow_valid) {
+            a=0;
+            b=p->width-1;
+        }
+
+        if(a<=b && p->shadow_valid) {
+            while(a<=b && row[a]==shadow[a]) ++a;
+            while(a<=b && row[b]==shadow[b]) --b;
+        }
+
+        x0[page]=a;
+        x1[page]=b;
+        dmin[page]=0xFF;
+        dmax[page]=0;
+    }
+
+    // group consecutive dirty pages into one window while that is cheaper than
+    // paying the addressing overhead again
+    uint32_t sent=0;
+    for(uint32_t page=0; page<p->pages;) {
+        if(x0[page]>x1[page]) {
+            ++page;
+            continue;
+        }
+
+        uint32_t last=page;
+        int32_t a=x0[page], b=x1[page];
+        uint32_t cost=b-a+1;
+
+        while(last+1<p->pages && x0[last+1]<=x1[last+1]) {
+            int32_t na=a<x0[last+1]?a:x0[last+1];
+            int32_t nb=b>x1[last+1]?b:x1[last+1];
+            uint32_t merged=(last-page+2)*(nb-na+1);
+
+            if(merged>cost+(x1[last+1]-x0[last+1]+1)+SSD1306_WINDOW_OVERHEAD)
+                break;
+
+            a=na;
+            b=nb;
+            cost=merged;
+            ++last;
+        }
+
+        ssd1306_send_window(p, page, last, a, b);
+        sent+=(last-page+1)*(b-a+1);
+        page=last+1;
+    }
+
+    p->shadow_valid=true;
+    p->skipped_bytes=p->bufsize-sent;
+}
+
+static void ssd1306_frame_done(void *arg) {
+    ssd1306_t *p=(ssd1306_t *) arg;
+
+    // a lost frame leaves display RAM unknown, resend everything next time
+    if(!p->transport->ok) {
+        p->shadow_valid=false;
+        p->sent_start_line=0xFF;
+        p->transport->ok=true;
+    }
+
+    if(p->done_cb)
+        p->done_cb(p->done_arg);
+}
+
+bool ssd1306_show_async(ssd1306_t *p, void (*done)(void *arg), void *arg) {
+    uint32_t start=time_us_32();
+
+    ssd1306_render(p);
+
+    // scrolling goes out after the page it reveals
+    uint8_t line=p->front?p->pending_start_line:p->start_line;
+    if(line!=p->sent_start_line) {
+        uint8_t cmd=SET_DISP_START_LINE|line;
+        ssd1306_queue_command(p, &cmd, 1);
+        p->sent_start_line=line;
+    }
+
+    // an empty frame completes at once; the previous one must report first
+    ssd1306_show_wait(p);
+    p->done_cb=done;
+    p->done_arg=arg;
+    bool async=p->transport->commit(p->transport, p->address, ssd1306_frame_done, p);
+
+    p->last_show_us=time_us_32()-start;
+    return async;
+}
+
+bool ssd1306_double_buffer(ssd1306_t *p) {
+    if(p->front)
+        return true;
+    if((p->front=malloc(p->bufsize+1))==NULL)
+        return false;
+
+    ++(p->front);
+    memcpy(p->front, p->buffer, p->bufsize);
+    for(uint8_t page=0; page<SSD1306_MAX_PAGES; ++page) {
+        p->pending_min[page]=p->dirty_min[page];
+        p->pending_max[page]=p->dirty_max[page];
+        ssd1306_mark_clean(p, page);
+    }
+    return true;
+}
+
+void ssd1306_swap(ssd1306_t *p) {
+    if(p->front==NULL)
+        return;
+
+    // only the changed spans need to reach the front buffer, the back buffer
+    // keeps its content so producers can keep drawing incrementally
+    for(uint32_t page=0; page<p->pages; ++page) {
+        uint32_t a=p->dirty_min[page], b=p->dirty_max[page];
+        if(a>b)
+            continue;
+
+        memcpy(p->front+page*p->width+a, p->buffer+page*p->width+a, b-a+1);
+        if(a<p->pending_min[page])
+            p->pending_min[page]=a;
+        if(b>p->pending_max[page])
+            p->pending_max[page]=b;
+        ssd1306_mark_clean(p, page);
+    }
+    p->pending_start_line=p->start_line;
+}
+
+void ssd1306_console(ssd1306_t *p, bool enable) {
+    ssd1306_clear(p);
+    p->start_line=0;
+    p->console=enable;
+    p->console_lines=0;
+}
+
+void ssd1306_console_print(ssd1306_t *p, const char *s) {
+    uint32_t page;
+
+    if(!p->console)
+        return;
+
+    if(p->console_lines<p->pages) {
+        page=p->console_lines++;
+    } else if(p->pages==SSD1306_MAX_PAGES) {
+        // the oldest line is at the top, reuse its page and make it the bottom one
+        page=p->start_line>>3;
+        p->start_line=((page+1)%p->pages)<<3;
+    } else {
+        memmove(p->buffer, p->buffer+p->width, p->bufsize-p->width);
+        ssd1306_mark_all_dirty(p);
+        page=p->pages-1;
+    }
+
+    ssd1306_fill_rect(p, 0, page<<3, p->width, 8, false);
+    for(uint32_t x=0; *s && x+font_8x5[1]<=p->width; x+=font_8x5[1]+font_8x5[2])
+        ssd1306_draw_char_with_font(p, x, page<<3, 1, font_8x5, *(s++));
+}
 
-    *(p->buffer-1)=0x40;
+void ssd1306_show_wait(ssd1306_t *p) {
+    p->transport->wait(p->transport);
+}
 
-    fancy_write(p->i2c_i, p->address, p->buffer-1, p->bufsize+1, "ssd1306_show");
+static void ssd1306_mock_write(ssd1306_transport_t *base, uint8_t addr, const uint8_t *src, size_t len) {
+    ssd1306_mock_transport_t *t=(ssd1306_mock_transport_t *) base;
+
+    (void) addr;
+    if(t->log==NULL)
+        return;
+    if(len>t->log_size-t->log_len)
+        len=t->log_size-t->log_len;
+    memcpy(t->log+t->log_len, src, len);
+    t->log_len+=len;
+}
+
+static bool ssd1306_mock_commit(ssd1306_transport_t *base, uint8_t addr, void (*done)(void *arg), void *arg) {
+    (void) base;
+    (void) addr;
+    if(done)
+        done(arg);
+    return false;
+}
+
+static void ssd1306_mock_wait(ssd1306_transport_t *base) {
+    (void) base;
+}
+
+void ssd1306_mock_transport_init(ssd1306_mock_transport_t *t, uint8_t *log, size_t log_size) {
+    t->base.write=ssd1306_mock_write;
+    t->base.commit=ssd1306_mock_commit;
+    t->base.wait=ssd1306_mock_wait;
+    t->base.transactions=0;
+    t->base.bytes=0;
+    t->base.ok=true;
+    t->log=log;
+    t->log_size=log_size;
+    t->log_len=0;
+}
+
+void ssd1306_show(ssd1306_t *p) {
+    ssd1306_show_async(p, NULL, NULL);
+    ssd1306_show_wait(p);
 }
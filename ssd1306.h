@@ -33,6 +33,16 @@ SOFTWARE.
 #include <pico/stdlib.h>
 #include <hardware/i2c.h>
 
+/** 
+*	@brief maximum number of pages (8 rows each) supported by the controller
+*/
+#define SSD1306_MAX_PAGES 8
+
+/**
+*	@brief maximum number of command bytes packed into one transaction
+*/
+#define SSD1306_MAX_COMMAND 32
+
 /**
 *	@brief defines commands used in ssd1306
 */
@@ -56,6 +66,49 @@ typedef enum {
     SET_CHARGE_PUMP = 0x8D
 } ssd1306_command_t;
 
+/**
+*	@brief moves complete i2c transactions (control byte included) to the display
+*
+*	Concrete transports embed this as their first member.
+*/
+typedef struct ssd1306_transport {
+    void (*write)(struct ssd1306_transport *t, uint8_t addr, const uint8_t *src, size_t len);	/**< send or queue one transaction */
+    bool (*commit)(struct ssd1306_transport *t, uint8_t addr, void (*done)(void *arg), void *arg);	/**< start queued transactions, true if done will be called later */
+    void (*wait)(struct ssd1306_transport *t);	/**< wait for committed transactions */
+    uint32_t transactions;	/**< transactions written so far */
+    uint32_t bytes;		/**< bytes written so far (without address) */
+    volatile bool ok;	/**< false once a transaction failed, reset by the driver */
+} ssd1306_transport_t;
+
+/**
+*	@brief i2c transport, blocking or with transactions fed to the tx fifo by dma
+*/
+typedef struct {
+    ssd1306_transport_t base;
+    i2c_inst_t *i2c_i;	/**< i2c connection instance */
+    int dma_chan;		/**< dma channel, -1 for blocking writes */
+    uint16_t *queue;	/**< queued data_cmd words */
+    size_t queue_size;	/**< capacity of queue in words */
+    size_t queue_len;	/**< number of queued words */
+    volatile bool busy;	/**< dma transfer in progress */
+    void (*done_cb)(void *arg);	/**< completion callback of the transfer in flight */
+    void *done_arg;		/**< argument for done_cb */
+    uint32_t xfer_start_us;	/**< start time of the transfer in flight */
+    uint32_t last_xfer_us;	/**< time the last dma transfer took on the bus */
+    volatile uint32_t nacks;	/**< dma transfers ended by a missing ack */
+    uint32_t nacks_reported;	/**< nacks already printed from task context */
+} ssd1306_i2c_transport_t;
+
+/**
+*	@brief in-memory transport for host tests, records the raw byte stream
+*/
+typedef struct {
+    ssd1306_transport_t base;
+    uint8_t *log;		/**< transaction bytes, may be NULL to only count */
+    size_t log_size;	/**< capacity of log */
+    size_t log_len;		/**< bytes recorded */
+} ssd1306_mock_transport_t;
+
 /**
 *	@brief holds the configuration
 */
@@ -68,8 +121,52 @@ typedef struct {
     bool external_vcc; 	/**< whether display uses external vcc */ 
     uint8_t *buffer;	/**< display buffer */
     size_t bufsize;		/**< buffer size */
+    uint8_t *shadow;	/**< copy of display RAM as of the last ssd1306_show */
+    bool shadow_valid;	/**< false until the whole display RAM was written once */
+    uint8_t dirty_min[SSD1306_MAX_PAGES];	/**< first changed column per page (dirty_min>dirty_max: page clean) */
+    uint8_t dirty_max[SSD1306_MAX_PAGES];	/**< last changed column per page */
+    uint32_t skipped_bytes;	/**< buffer bytes the last ssd1306_show did not have to send */
+    uint8_t *front;		/**< frame handed to the transmitter, NULL unless double buffered */
+    uint8_t pending_min[SSD1306_MAX_PAGES];	/**< first swapped but not yet sent column per page */
+    uint8_t pending_max[SSD1306_MAX_PAGES];	/**< last swapped but not yet sent column per page */
+    ssd1306_transport_t *transport;	/**< where transactions go */
+    ssd1306_i2c_transport_t i2c;	/**< transport set up by ssd1306_init */
+    void (*done_cb)(void *arg);	/**< called when the frame in flight reached the display */
+    void *done_arg;		/**< argument for done_cb */
+    uint32_t last_show_us;	/**< time the caller spent in the last show call */
+    uint8_t start_line;		/**< display start line of the frame being drawn */
+    uint8_t pending_start_line;	/**< start line handed over with ssd1306_swap */
+    uint8_t sent_start_line;	/**< start line the display has, 0xFF if unknown */
+    bool console;		/**< console mode active */
+    uint8_t console_lines;	/**< lines printed since console mode started, saturates at pages */
 } ssd1306_t;
 
+/**
+*	@brief bitmap already in display RAM layout (one byte per column and page,
+*	LSB on top), generated at build time by tools/img2ssd1306.py
+*/
+typedef struct {
+    uint8_t width;		/**< width in pixels */
+    uint8_t height;		/**< height in pixels */
+    bool rle;			/**< data is PackBits compressed */
+    uint16_t size;		/**< size of data in bytes */
+    const uint8_t *data;	/**< page ordered image data */
+} ssd1306_image_t;
+
+/**
+*	@brief proportional font with glyphs in display RAM layout, generated at
+*	build time by tools/fontgen.py
+*/
+typedef struct {
+    uint8_t height;		/**< height in pixels, multiple of 8 */
+    uint8_t spacing;	/**< columns between glyphs */
+    uint8_t first;		/**< first character in the font */
+    uint8_t last;		/**< last character in the font */
+    const uint16_t *offset;	/**< start of each glyph in data (last-first+2 entries) */
+    const uint8_t *width;	/**< width of each glyph, 0 if the font does not have it */
+    const uint8_t *data;	/**< page ordered glyphs, width bytes per page row */
+} ssd1306_font_t;
+
 /**
 *	@brief initialize display
 *
@@ -85,6 +182,63 @@ typedef struct {
 */
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance);
 
+/**
+*	@brief initialize display on a custom transport
+*
+*	@param[in] p : pointer to instance of ssd1306_t
+*	@param[in] width : width of display
+*	@param[in] height : heigth of display
+*	@param[in] address : i2c address of display
+*	@param[in] transport : transport the display is reached through
+*
+* 	@return bool.
+*	@retval true for Success
+*	@retval false if initialization failed
+*/
+bool ssd1306_init_with_transport(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, ssd1306_transport_t *transport);
+
+/**
+*	@brief set up the i2c transport
+*
+*	With queue_size>0 a dma channel and the i2c interrupt are claimed and
+*	transactions are queued until commit. Falls back to blocking writes if
+*	that is not possible.
+*
+*	@param[in] t : transport to initialize
+*	@param[in] i2c_instance : instance of i2c connection
+*	@param[in] queue_size : queue capacity in bytes, 0 for blocking writes
+*
+* 	@return bool.
+*	@retval true if dma is used
+*	@retval false for blocking writes
+*/
+bool ssd1306_i2c_transport_init(ssd1306_i2c_transport_t *t, i2c_inst_t *i2c_instance, size_t queue_size);
+
+/**
+*	@brief release dma channel and interrupt of the i2c transport
+*
+*	@param[in] t : transport
+*/
+void ssd1306_i2c_transport_deinit(ssd1306_i2c_transport_t *t);
+
+/**
+*	@brief set up the in-memory transport
+*
+*	@param[in] t : transport to initialize
+*	@param[in] log : buffer receiving the transaction bytes, may be NULL
+*	@param[in] log_size : size of log
+*/
+void ssd1306_mock_transport_init(ssd1306_mock_transport_t *t, uint8_t *log, size_t log_size);
+
+/**
+*	@brief send a command sequence as a single transaction
+*
+*	@param[in] p : instance of display
+*	@param[in] cmds : command bytes (with their arguments)
+*	@param[in] len : number of bytes
+*/
+void ssd1306_command(ssd1306_t *p, const uint8_t *cmds, size_t len);
+
 /**
 *	@brief deinitialize display
 *
@@ -130,11 +284,91 @@ void ssd1306_invert(ssd1306_t *p, uint8_t inv);
 /**
 	@brief display buffer, should be called on change
 
+	Only the column windows touched since the last call (and actually
+	different from what the display already holds) are transmitted.
+	The number of buffer bytes saved is left in p->skipped_bytes.
+
 	@param[in] p : instance of display
 
 */
 void ssd1306_show(ssd1306_t *p);
 
+/**
+	@brief display buffer without waiting for the bus
+
+	The changed windows are copied into the transport queue, so the buffer
+	may be drawn on again as soon as this returns. Transports without a
+	queue (blocking i2c) send the frame right away.
+
+	@param[in] p : instance of display
+	@param[in] done : called from interrupt context once the frame is on the display, may be NULL
+	@param[in] arg : argument passed to done
+
+	@return bool.
+	@retval true if the frame is still in flight
+	@retval false if it was sent blocking (done has already been called)
+*/
+bool ssd1306_show_async(ssd1306_t *p, void (*done)(void *arg), void *arg);
+
+/**
+	@brief switch to front/back buffer mode
+
+	Drawing keeps going to p->buffer (the back buffer), ssd1306_show only
+	transmits what was handed over with ssd1306_swap. Producers can then
+	render without holding the lock that serializes the transmitter.
+
+	@param[in] p : instance of display
+
+	@return bool.
+	@retval true for Success
+	@retval false if the front buffer could not be allocated
+*/
+bool ssd1306_double_buffer(ssd1306_t *p);
+
+/**
+	@brief hand the back buffer over to the transmitter
+
+	Copies the spans changed since the last swap into the front buffer. The
+	back buffer keeps its content. No-op unless double buffered.
+
+	@param[in] p : instance of display
+
+*/
+void ssd1306_swap(ssd1306_t *p);
+
+/**
+	@brief enter or leave console mode
+
+	In console mode every page is one text line. Once the screen is full a
+	new line overwrites the oldest page and the display start line is moved
+	so that it appears at the bottom: appending a line sends a single page
+	plus one command instead of the whole screen. Both directions clear the
+	buffer; leaving resets the start line.
+
+	@param[in] p : instance of display
+	@param[in] enable : true to enter console mode
+*/
+void ssd1306_console(ssd1306_t *p, bool enable);
+
+/**
+	@brief append a line in console mode (shown by the next ssd1306_show)
+
+	Panels shorter than 64 rows cannot wrap the start line over their RAM,
+	there the buffer is shifted up in software instead.
+
+	@param[in] p : instance of display
+	@param[in] s : text, cut at the right edge
+*/
+void ssd1306_console_print(ssd1306_t *p, const char *s);
+
+/**
+	@brief wait until an asynchronous transfer has finished
+
+	@param[in] p : instance of display
+
+*/
+void ssd1306_show_wait(ssd1306_t *p);
+
 /**
 	@brief clear display buffer
 
@@ -225,6 +459,19 @@ void ssd1306_bmp_show_image_with_offset(ssd1306_t *p, const uint8_t *data, const
 */
 void ssd1306_bmp_show_image(ssd1306_t *p, const uint8_t *data, const long size);
 
+/**
+	@brief copy a native page-ordered image into the buffer
+
+	Pixels of the image rectangle replace what was there before. Page aligned
+	images are copied with memcpy, others are shifted and masked in.
+
+	@param[in] p : instance of display
+	@param[in] x : x position of top left corner
+	@param[in] y : y position of top left corner
+	@param[in] img : image generated by tools/img2ssd1306.py
+*/
+void ssd1306_blit_native(ssd1306_t *p, uint32_t x, uint32_t y, const ssd1306_image_t *img);
+
 /**
 	@brief draw char with given font
 
@@ -271,4 +518,27 @@ void ssd1306_draw_string_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_
 */
 void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const char *s);
 
+/**
+	@brief draw string with a generated proportional font
+
+	@param[in] p : instance of display
+	@param[in] x : x starting position of text
+	@param[in] y : y starting position of text
+	@param[in] font : font from tools/fontgen.py
+	@param[in] s : text to draw
+
+	@return x position after the last glyph
+*/
+uint32_t ssd1306_draw_string_font(ssd1306_t *p, uint32_t x, uint32_t y, const ssd1306_font_t *font, const char *s);
+
+/**
+	@brief width of a string in a generated proportional font
+
+	@param[in] font : font from tools/fontgen.py
+	@param[in] s : text to measure
+
+	@return width in pixels, without trailing spacing
+*/
+uint32_t ssd1306_string_width(const ssd1306_font_t *font, const char *s);
+
 #endif
@@ -0,0 +1,257 @@
+/*
+
+MIT License
+
+Copyright (c) 2021 David Schramm
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+* @file ssd1306_i2c.c
+*
+* i2c transport for ssd1306 displays: blocking writes, or transactions
+* queued as data_cmd words and fed to the tx fifo by dma
+*/
+
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "ssd1306.h"
+
+inline static bool fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, char *name) {
+    switch(i2c_write_blocking(i2c, addr, src, len, false)) {
+    case PICO_ERROR_GENERIC:
+        printf("[%s] addr not acknowledged!\n", name);
+        return false;
+    case PICO_ERROR_TIMEOUT:
+        printf("[%s] timeout!\n", name);
+        return false;
+    default:
+        //printf("[%s] wrote successfully %lu bytes!\n", name, len);
+        return true;
+    }
+}
+
+// one transport per i2c instance may own the dma path
+static ssd1306_i2c_transport_t *ssd1306_async_owner[2];
+
+static void ssd1306_i2c_wait(ssd1306_transport_t *base) {
+    ssd1306_i2c_transport_t *t=(ssd1306_i2c_transport_t *) base;
+
+    while(t->busy)
+        tight_loop_contents();
+}
+
+static void ssd1306_async_finish(ssd1306_i2c_transport_t *t, bool ok) {
+    i2c_get_hw(t->i2c_i)->intr_mask=0;
+    t->last_xfer_us=time_us_32()-t->xfer_start_us;
+    if(!ok)
+        t->base.ok=false;
+    t->busy=false;
+
+    if(t->done_cb)
+        t->done_cb(t->done_arg);
+}
+
+static void ssd1306_dma_irq_handler(void) {
+    for(uint i=0; i<2; ++i) {
+        ssd1306_i2c_transport_t *t=ssd1306_async_owner[i];
+        if(t==NULL || !dma_channel_get_irq1_status(t->dma_chan))
+            continue;
+
+        dma_channel_acknowledge_irq1(t->dma_chan);
+        // everything is in the tx fifo now, wait until the last byte left the wire
+        i2c_get_hw(t->i2c_i)->intr_mask|=I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+}
+
+static void ssd1306_i2c_irq(ssd1306_i2c_transport_t *t) {
+    i2c_hw_t *hw=i2c_get_hw(t->i2c_i);
+    uint32_t stat=hw->intr_stat;
+
+    if(stat&I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // device did not ack, the rest of the queue is dropped
+        dma_channel_set_irq1_enabled(t->dma_chan, false);
+        dma_channel_abort(t->dma_chan);
+        dma_channel_acknowledge_irq1(t->dma_chan);
+        dma_channel_set_irq1_enabled(t->dma_chan, true);
+        (void) hw->clr_tx_abrt;
+        ++t->nacks;
+        ssd1306_async_finish(t, false);
+    } else if(stat&I2C_IC_INTR_STAT_R_TX_EMPTY_BITS) {
+        hw->intr_mask&=~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+        (void) hw->clr_stop_det;
+        if(hw->status&I2C_IC_STATUS_MST_ACTIVITY_BITS)
+            hw->intr_mask|=I2C_IC_INTR_MASK_M_STOP_DET_BITS;
+        else
+            ssd1306_async_finish(t, true);
+    } else if(stat&I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void) hw->clr_stop_det;
+        ssd1306_async_finish(t, true);
+    }
+}
+
+static void ssd1306_i2c0_irq_handler(void) {
+    ssd1306_i2c_irq(ssd1306_async_owner[0]);
+}
+
+static void ssd1306_i2c1_irq_handler(void) {
+    ssd1306_i2c_irq(ssd1306_async_owner[1]);
+}
+
+// stdio takes a mutex, so aborts seen in the interrupt are printed here
+static void ssd1306_i2c_report(ssd1306_i2c_transport_t *t) {
+    uint32_t nacks=t->nacks;
+
+    if(nacks!=t->nacks_reported) {
+        printf("[ssd1306_i2c] addr not acknowledged! (%lu transfers)\n", (unsigned long) (nacks-t->nacks_reported));
+        t->nacks_reported=nacks;
+    }
+}
+
+static bool ssd1306_i2c_commit(ssd1306_transport_t *base, uint8_t addr, void (*done)(void *arg), void *arg) {
+    ssd1306_i2c_transport_t *t=(ssd1306_i2c_transport_t *) base;
+
+    ssd1306_i2c_report(t);
+
+    if(t->dma_chan<0 || t->queue_len==0) {
+        if(done)
+            done(arg);
+        return false;
+    }
+
+    i2c_hw_t *hw=i2c_get_hw(t->i2c_i);
+    hw->enable=0;
+    hw->tar=addr;
+    hw->enable=1;
+    hw->intr_mask=I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    t->done_cb=done;
+    t->done_arg=arg;
+    t->busy=true;
+    t->xfer_start_us=time_us_32();
+    dma_channel_transfer_from_buffer_now(t->dma_chan, t->queue, t->queue_len);
+    t->queue_len=0;
+    return true;
+}
+
+static void ssd1306_i2c_write(ssd1306_transport_t *base, uint8_t addr, const uint8_t *src, size_t len) {
+    ssd1306_i2c_transport_t *t=(ssd1306_i2c_transport_t *) base;
+
+    ssd1306_i2c_wait(base);
+
+    if(t->dma_chan<0 || len>t->queue_size) {
+        if(!fancy_write(t->i2c_i, addr, src, len, "ssd1306_i2c"))
+            t->base.ok=false;
+        return;
+    }
+
+    if(t->queue_len+len>t->queue_size) {
+        ssd1306_i2c_commit(base, addr, NULL, NULL);
+        ssd1306_i2c_wait(base);
+    }
+
+    // STOP after the last byte, the controller starts the next transaction on its own
+    uint16_t *dst=t->queue+t->queue_len;
+    for(size_t i=0; i<len; ++i)
+        dst[i]=src[i];
+    dst[len-1]|=I2C_IC_DATA_CMD_STOP_BITS;
+    t->queue_len+=len;
+}
+
+bool ssd1306_i2c_transport_init(ssd1306_i2c_transport_t *t, i2c_inst_t *i2c_instance, size_t queue_size) {
+    static bool dma_irq_installed=false;
+    uint idx=i2c_hw_index(i2c_instance);
+
+    t->base.write=ssd1306_i2c_write;
+    t->base.commit=ssd1306_i2c_commit;
+    t->base.wait=ssd1306_i2c_wait;
+    t->base.transactions=0;
+    t->base.bytes=0;
+    t->base.ok=true;
+    t->i2c_i=i2c_instance;
+    t->dma_chan=-1;
+    t->queue=NULL;
+    t->queue_size=0;
+    t->queue_len=0;
+    t->busy=false;
+    t->done_cb=NULL;
+    t->last_xfer_us=0;
+    t->nacks=0;
+    t->nacks_reported=0;
+
+    if(queue_size==0 || ssd1306_async_owner[idx]!=NULL)
+        return false;
+
+    int chan=dma_claim_unused_channel(false);
+    if(chan<0)
+        return false;
+
+    if((t->queue=malloc(queue_size*sizeof(uint16_t)))==NULL) {
+        dma_channel_unclaim(chan);
+        return false;
+    }
+
+    dma_channel_config c=dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c_instance, true));
+    dma_channel_configure(chan, &c, &i2c_get_hw(i2c_instance)->data_cmd, t->queue, 0, false);
+    dma_channel_set_irq1_enabled(chan, true);
+
+    if(!dma_irq_installed) {
+        irq_add_shared_handler(DMA_IRQ_1, ssd1306_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_1, true);
+        dma_irq_installed=true;
+    }
+
+    i2c_get_hw(i2c_instance)->intr_mask=0;
+    irq_set_exclusive_handler(I2C0_IRQ+idx, idx?ssd1306_i2c1_irq_handler:ssd1306_i2c0_irq_handler);
+    irq_set_enabled(I2C0_IRQ+idx, true);
+
+    t->dma_chan=chan;
+    t->queue_size=queue_size;
+    ssd1306_async_owner[idx]=t;
+    return true;
+}
+
+void ssd1306_i2c_transport_deinit(ssd1306_i2c_transport_t *t) {
+    ssd1306_i2c_wait(&t->base);
+
+    if(t->dma_chan<0)
+        return;
+
+    uint idx=i2c_hw_index(t->i2c_i);
+    irq_set_enabled(I2C0_IRQ+idx, false);
+    irq_remove_handler(I2C0_IRQ+idx, idx?ssd1306_i2c1_irq_handler:ssd1306_i2c0_irq_handler);
+    dma_channel_set_irq1_enabled(t->dma_chan, false);
+    dma_channel_unclaim(t->dma_chan);
+    free(t->queue);
+
+    ssd1306_async_owner[idx]=NULL;
+    t->dma_chan=-1;
+    t->queue=NULL;
+    t->queue_size=0;
+}
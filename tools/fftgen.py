@@ -0,0 +1,55 @@
+"""
+Generate the Q15 tables for fft.c: twiddle factors and a Hann window.
+
+One set of tables serves every power-of-two length up to the maximum;
+shorter transforms step through them with a stride.
+
+    fft_cos[k], fft_sin[k]   cos/sin(2*pi*k/N) for k < N/2
+    fft_hann[i]              periodic Hann window for i <= N/2 (symmetric)
+
+Usage:
+    python fftgen.py <out.h> <max n>
+"""
+
+import math
+import sys
+
+
+def q15(v):
+    return max(-32768, min(32767, int(round(v * 32768))))
+
+
+def c_array(name, values):
+    lines = []
+    for i in range(0, len(values), 12):
+        lines.append("    " + ", ".join("%d" % v for v in values[i : i + 12]) + ",")
+    return "static const int16_t %s[] = {\n%s\n};\n\n" % (name, "\n".join(lines))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__.strip().splitlines()[-1].strip())
+
+    n = int(sys.argv[2])
+    if n < 4 or n & (n - 1):
+        sys.exit("max n must be a power of two >= 4")
+
+    cos = [q15(math.cos(2 * math.pi * k / n)) for k in range(n // 2)]
+    sin = [q15(math.sin(2 * math.pi * k / n)) for k in range(n // 2)]
+    hann = [q15(0.5 - 0.5 * math.cos(2 * math.pi * i / n)) for i in range(n // 2 + 1)]
+
+    text = "// generated by tools/fftgen.py, do not edit\n"
+    text += "#ifndef _inc_fft_tables\n#define _inc_fft_tables\n\n#include <stdint.h>\n\n"
+    text += "#define FFT_TABLE_N %d\n\n" % n
+    text += c_array("fft_cos", cos)
+    text += c_array("fft_sin", sin)
+    text += c_array("fft_hann", hann)
+    text += "#endif\n"
+
+    with open(sys.argv[1], "w") as f:
+        f.write(text)
+    print("fft tables for n <= %d: %d bytes flash" % (n, 2 * (len(cos) + len(sin) + len(hann))))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,74 @@
+"""
+Generate Q15 low-pass FIR taps for dsp_fir_decimate().
+
+Windowed-sinc design (Hamming window), linear phase. The taps are rounded to
+Q15 and the centre tap takes the rounding error, so the DC gain is exactly
+1.0 (sum of the taps is 32768) and a constant input comes out unchanged.
+
+Every filter becomes a table plus its length:
+    static const int16_t fir_<name>[];
+    #define FIR_<NAME>_TAPS <n>
+
+Usage:
+    python firgen.py <out.h> <name> <taps> <cutoff> [<name> <taps> <cutoff> ...]
+
+cutoff is the -6 dB frequency as a fraction of the input sample rate (0..0.5).
+"""
+
+import math
+import sys
+
+
+def lowpass(taps, cutoff):
+    """Return (Q15 taps, float taps) of a Hamming windowed-sinc low-pass."""
+    if taps < 3 or taps % 2 == 0:
+        raise ValueError("tap count must be odd and >= 3")
+    if not 0 < cutoff < 0.5:
+        raise ValueError("cutoff must be between 0 and 0.5")
+    mid = (taps - 1) / 2
+    h = []
+    for n in range(taps):
+        x = n - mid
+        s = 2 * cutoff if x == 0 else math.sin(2 * math.pi * cutoff * x) / (math.pi * x)
+        w = 0.54 - 0.46 * math.cos(2 * math.pi * n / (taps - 1))
+        h.append(s * w)
+    total = sum(h)
+    h = [v / total for v in h]
+    q = [int(round(v * 32768)) for v in h]
+    q[taps // 2] += 32768 - sum(q)
+    return q, h
+
+
+def response_db(h, f):
+    """Magnitude of the float taps at frequency f (fraction of the sample rate)."""
+    re = sum(v * math.cos(2 * math.pi * f * n) for n, v in enumerate(h))
+    im = sum(v * math.sin(2 * math.pi * f * n) for n, v in enumerate(h))
+    return 20 * math.log10(max(math.hypot(re, im), 1e-12))
+
+
+def main():
+    args = sys.argv[1:]
+    if len(args) < 4 or (len(args) - 1) % 3:
+        sys.exit(__doc__.strip().split("Usage:")[1].strip().splitlines()[0].strip())
+
+    text = "// generated by tools/firgen.py, do not edit\n"
+    text += "#ifndef _inc_fir_taps\n#define _inc_fir_taps\n\n#include <stdint.h>\n\n"
+    for i in range(1, len(args), 3):
+        name, taps, cutoff = args[i], int(args[i + 1]), float(args[i + 2])
+        q, h = lowpass(taps, cutoff)
+        text += "// %d taps, cutoff %.4f fs, %.1f dB at 2x cutoff\n" % (
+            taps, cutoff, response_db(h, min(2 * cutoff, 0.5)))
+        text += "#define FIR_%s_TAPS %d\n" % (name.upper(), taps)
+        lines = []
+        for j in range(0, taps, 12):
+            lines.append("    " + ", ".join("%d" % v for v in q[j : j + 12]) + ",")
+        text += "static const int16_t fir_%s[] = {\n%s\n};\n\n" % (name, "\n".join(lines))
+        print("fir_%s: %d taps, %.1f dB at %.3f fs" % (name, taps, response_db(h, min(2 * cutoff, 0.5)), min(2 * cutoff, 0.5)))
+    text += "#endif\n"
+
+    with open(args[0], "w") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
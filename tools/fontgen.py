@@ -0,0 +1,184 @@
+"""
+Generate proportional SSD1306 fonts from the fixed 5x8 table in font.h.
+
+Glyphs are stored the way the display RAM is laid out (one byte per column
+and page, LSB on top, page rows one after another), so ssd1306_draw_string_font()
+can OR them into the framebuffer without touching single pixels. Every font
+gets a per-glyph offset and width table instead of a fixed cell.
+
+Fonts generated:
+    font_6x8           font_8x5 with empty columns trimmed (proportional)
+    font_10x16_digits  digits and number punctuation, font_8x5 scaled 2x
+                       with EPX smoothing instead of blocky pixel doubling
+
+Usage:
+    python fontgen.py <font.h> <out.h>
+"""
+
+import os
+import re
+import sys
+
+
+def read_font(path, name="font_8x5"):
+    """Return (height, width, spacing, first, last, glyphs) from a font.h table."""
+    with open(path) as f:
+        text = f.read()
+    m = re.search(r"%s\s*\[\s*\]\s*=\s*\{(.*?)\}" % name, text, re.S)
+    if not m:
+        raise ValueError("%s not found in %s" % (name, path))
+    body = re.sub(r"/\*.*?\*/|//[^\n]*", "", m.group(1), flags=re.S)
+    values = [int(v, 0) for v in re.findall(r"0[xX][0-9a-fA-F]+|\d+", body)]
+    height, width, spacing, first, last = values[:5]
+    if height > 8:
+        raise ValueError("only single page source fonts are supported")
+    data = values[5:]
+    glyphs = {}
+    for c in range(first, last + 1):
+        glyphs[chr(c)] = data[(c - first) * width : (c - first + 1) * width]
+    return height, width, spacing, first, last, glyphs
+
+
+def columns_to_pixels(cols, height):
+    """Column bytes to a list of rows of 0/1."""
+    return [[(col >> y) & 1 for col in cols] for y in range(height)]
+
+
+def pixels_to_pages(pixels):
+    """Rows of 0/1 to page-ordered column bytes (page rows concatenated)."""
+    height, width = len(pixels), len(pixels[0]) if pixels else 0
+    out = bytearray()
+    for page in range((height + 7) // 8):
+        for x in range(width):
+            b = 0
+            for bit in range(8):
+                y = page * 8 + bit
+                if y < height and pixels[y][x]:
+                    b |= 1 << bit
+            out.append(b)
+    return out
+
+
+def trim(cols):
+    """Drop empty columns on both sides."""
+    lo, hi = 0, len(cols)
+    while lo < hi and cols[lo] == 0:
+        lo += 1
+    while hi > lo and cols[hi - 1] == 0:
+        hi -= 1
+    return cols[lo:hi]
+
+
+def epx(pixels):
+    """Scale a 1 bit bitmap 2x with EPX / Scale2x."""
+    h, w = len(pixels), len(pixels[0])
+
+    def at(x, y):
+        if 0 <= x < w and 0 <= y < h:
+            return pixels[y][x]
+        return 0
+
+    out = [[0] * (w * 2) for _ in range(h * 2)]
+    for y in range(h):
+        for x in range(w):
+            p = at(x, y)
+            a, b, c, d = at(x, y - 1), at(x + 1, y), at(x - 1, y), at(x, y + 1)
+            e0 = a if (c == a and c != d and a != b) else p
+            e1 = b if (a == b and a != c and b != d) else p
+            e2 = c if (d == c and d != b and c != a) else p
+            e3 = d if (b == d and b != a and d != c) else p
+            out[2 * y][2 * x], out[2 * y][2 * x + 1] = e0, e1
+            out[2 * y + 1][2 * x], out[2 * y + 1][2 * x + 1] = e2, e3
+    return out
+
+
+class Font:
+    def __init__(self, name, height, spacing, first, last):
+        self.name, self.height, self.spacing = name, height, spacing
+        self.first, self.last = first, last
+        self.data = bytearray()
+        self.offsets, self.widths = [], []
+
+    def add(self, width, pages):
+        self.offsets.append(len(self.data))
+        self.widths.append(width)
+        self.data += pages
+
+    def flash(self):
+        return len(self.data) + 2 * (len(self.offsets) + 1) + len(self.widths)
+
+    def emit(self):
+        count = self.last - self.first + 1
+        text = "// %s: %d glyphs, %d bytes bitmap + %d bytes index = %d bytes flash\n" % (
+            self.name, count, len(self.data), self.flash() - len(self.data), self.flash())
+        text += c_array("uint8_t", "%s_data" % self.name, self.data, "0x%02X")
+        text += c_array("uint16_t", "%s_offset" % self.name, self.offsets + [len(self.data)], "%d")
+        text += c_array("uint8_t", "%s_width" % self.name, self.widths, "%d")
+        text += "static const ssd1306_font_t %s = {%d, %d, %d, %d, %s_offset, %s_width, %s_data};\n\n" % (
+            self.name, self.height, self.spacing, self.first, self.last, self.name, self.name, self.name)
+        return text
+
+
+def c_array(ctype, name, values, fmt):
+    lines = []
+    for i in range(0, len(values), 16):
+        lines.append("    " + ", ".join(fmt % v for v in values[i : i + 16]) + ",")
+    return "static const %s %s[] = {\n%s\n};\n" % (ctype, name, "\n".join(lines))
+
+
+def proportional(src, name):
+    height, width, spacing, first, last, glyphs = src
+    font = Font(name, 8, spacing, first, last)
+    for c in range(first, last + 1):
+        cols = trim(glyphs[chr(c)])
+        if not cols:  # space
+            cols = [0] * 3
+        font.add(len(cols), bytes(cols))
+    return font
+
+
+DIGIT_CHARS = "+-.0123456789:%"
+
+
+def digits_2x(src, name):
+    height, width, spacing, first, last, glyphs = src
+    lo, hi = ord(" "), ord(":")
+    font = Font(name, 16, 2, lo, hi)
+    for c in range(lo, hi + 1):
+        ch = chr(c)
+        if ch == " ":
+            # as wide as a digit, so right aligned numbers do not jump
+            font.add(width * 2, bytes(width * 2 * 2))
+            continue
+        if ch not in DIGIT_CHARS:
+            font.add(0, b"")
+            continue
+        cols = glyphs[ch]
+        if not ch.isdigit():  # digits keep the full cell (tabular figures)
+            cols = trim(cols)
+        pixels = epx(columns_to_pixels(cols, 8))
+        font.add(len(cols) * 2, pixels_to_pages(pixels))
+    return font
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__.strip().splitlines()[-1].strip())
+
+    src = read_font(sys.argv[1])
+    fonts = [proportional(src, "font_6x8"), digits_2x(src, "font_10x16_digits")]
+
+    text = "// generated by tools/fontgen.py from %s, do not edit\n" % os.path.basename(sys.argv[1])
+    text += "#ifndef _inc_fonts\n#define _inc_fonts\n\n#include \"ssd1306.h\"\n\n"
+    for font in fonts:
+        text += font.emit()
+    text += "#endif\n"
+
+    with open(sys.argv[2], "w") as f:
+        f.write(text)
+    for font in fonts:
+        print("%s: %d bytes flash" % (font.name, font.flash()))
+
+
+if __name__ == "__main__":
+    main()
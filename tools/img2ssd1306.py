@@ -0,0 +1,228 @@
+"""
+Convert monochrome BMP/PNG assets into SSD1306 page-ordered C arrays.
+
+The output matches the display RAM layout: one byte per column and page
+(8 rows, LSB on top), pages stored top to bottom. The firmware can then copy
+an image into the framebuffer with ssd1306_blit_native() instead of decoding
+a BMP at runtime.
+
+Usage:
+    python img2ssd1306.py [--rle] [--invert] [--threshold N] <image> <name> <out.h>
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+
+def read_bmp(data):
+    """Decode an uncompressed 1/24/32 bit BMP into rows of luminance (0-255)."""
+    if data[:2] != b"BM":
+        raise ValueError("not a BMP file")
+    off_bits = struct.unpack_from("<I", data, 10)[0]
+    width, height = struct.unpack_from("<ii", data, 18)
+    bit_count, compression = struct.unpack_from("<HI", data, 28)
+    if compression not in (0, 3):
+        raise ValueError("compressed BMP is not supported")
+
+    palette = []
+    if bit_count == 1:
+        table = 14 + struct.unpack_from("<I", data, 14)[0]
+        for i in range(2):
+            b, g, r = data[table + i * 4 : table + i * 4 + 3]
+            palette.append((r * 299 + g * 587 + b * 114) // 1000)
+    elif bit_count not in (24, 32):
+        raise ValueError("unsupported BMP bit depth %d" % bit_count)
+
+    stride = ((width * bit_count + 31) // 32) * 4
+    rows = []
+    for y in range(abs(height)):
+        line = data[off_bits + y * stride : off_bits + (y + 1) * stride]
+        if bit_count == 1:
+            row = [palette[(line[x >> 3] >> (7 - (x & 7))) & 1] for x in range(width)]
+        else:
+            step = bit_count // 8
+            row = []
+            for x in range(width):
+                b, g, r = line[x * step : x * step + 3]
+                row.append((r * 299 + g * 587 + b * 114) // 1000)
+        rows.append(row)
+
+    if height > 0:  # bottom-up
+        rows.reverse()
+    return width, abs(height), rows
+
+
+def _paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def read_png(data):
+    """Decode a non-interlaced PNG into rows of luminance (0-255), alpha over black."""
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("not a PNG file")
+
+    pos = 8
+    idat = b""
+    palette = []
+    trns = b""
+    while pos < len(data):
+        length, kind = struct.unpack_from(">I4s", data, pos)
+        chunk = data[pos + 8 : pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", chunk)
+        elif kind == b"PLTE":
+            palette = [tuple(chunk[i : i + 3]) for i in range(0, length, 3)]
+        elif kind == b"tRNS":
+            trns = chunk
+        elif kind == b"IDAT":
+            idat += chunk
+        elif kind == b"IEND":
+            break
+
+    if interlace:
+        raise ValueError("interlaced PNG is not supported")
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+    bits = channels * depth
+    bpp = max(1, bits // 8)
+    stride = (width * bits + 7) // 8
+    raw = zlib.decompress(idat)
+
+    prev = bytearray(stride)
+    rows = []
+    for y in range(height):
+        kind = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1 : (y + 1) * (stride + 1)])
+        for i in range(stride):
+            a = line[i - bpp] if i >= bpp else 0
+            c = prev[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + prev[i]) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + ((a + prev[i]) >> 1)) & 0xFF
+            elif kind == 4:
+                line[i] = (line[i] + _paeth(a, prev[i], c)) & 0xFF
+        prev = line
+
+        def sample(x, ch):
+            if depth == 16:
+                return line[(x * channels + ch) * 2]
+            if depth == 8:
+                return line[x * channels + ch]
+            bit = (x * channels + ch) * depth
+            v = (line[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1)
+            return v if color == 3 else v * 255 // ((1 << depth) - 1)
+
+        row = []
+        for x in range(width):
+            if color == 3:
+                idx = sample(x, 0)
+                r, g, b = palette[idx]
+                alpha = trns[idx] if idx < len(trns) else 255
+            elif color in (0, 4):
+                r = g = b = sample(x, 0)
+                alpha = sample(x, 1) if color == 4 else 255
+            else:
+                r, g, b = sample(x, 0), sample(x, 1), sample(x, 2)
+                alpha = sample(x, 3) if color == 6 else 255
+            row.append((r * 299 + g * 587 + b * 114) // 1000 * alpha // 255)
+        rows.append(row)
+    return width, height, rows
+
+
+def to_pages(width, height, rows, threshold, invert):
+    """Pack luminance rows into page-ordered column bytes."""
+    pages = (height + 7) // 8
+    out = bytearray(width * pages)
+    for y in range(height):
+        for x in range(width):
+            on = rows[y][x] > threshold
+            if on != invert:
+                out[(y >> 3) * width + x] |= 1 << (y & 7)
+    return out
+
+
+def rle_encode(data):
+    """
+    PackBits style encoding understood by ssd1306_blit_native():
+    n < 128: n+1 literal bytes follow, n >= 128: next byte repeats n-126 times.
+    """
+    out = bytearray()
+    i = 0
+    literal = bytearray()
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and data[i + run] == data[i] and run < 129:
+            run += 1
+        if run >= 2:
+            while literal:
+                out.append(len(literal[:128]) - 1)
+                out += literal[:128]
+                literal = literal[128:]
+            out += bytes((run + 126, data[i]))
+            i += run
+        else:
+            literal.append(data[i])
+            i += 1
+    while literal:
+        out.append(len(literal[:128]) - 1)
+        out += literal[:128]
+        literal = literal[128:]
+    return out
+
+
+def c_array(name, data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02X" % b for b in data[i : i + 16]) + ",")
+    return "static const uint8_t %s[] = {\n%s\n};\n" % (name, "\n".join(lines))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("image")
+    parser.add_argument("name")
+    parser.add_argument("output")
+    parser.add_argument("--rle", action="store_true", help="also emit <name>_rle")
+    parser.add_argument("--invert", action="store_true", help="dark pixels are lit")
+    parser.add_argument("--threshold", type=int, default=127)
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        data = f.read()
+    width, height, rows = read_png(data) if data[:4] == b"\x89PNG" else read_bmp(data)
+    if width > 255 or height > 255:
+        sys.exit("%s: %dx%d is too large for ssd1306_image_t" % (args.image, width, height))
+
+    pages = to_pages(width, height, rows, args.threshold, args.invert)
+    guard = "_inc_%s" % args.name
+
+    text = "// generated by tools/img2ssd1306.py from %s, do not edit\n" % os.path.basename(args.image)
+    text += "#ifndef %s\n#define %s\n\n#include \"ssd1306.h\"\n\n" % (guard, guard)
+    text += c_array("%s_data" % args.name, pages)
+    text += "static const ssd1306_image_t %s = {%d, %d, false, sizeof(%s_data), %s_data};\n" % (
+        args.name, width, height, args.name, args.name)
+    if args.rle:
+        packed = rle_encode(pages)
+        text += "\n// %d bytes raw, %d bytes rle\n" % (len(pages), len(packed))
+        text += c_array("%s_rle_data" % args.name, packed)
+        text += "static const ssd1306_image_t %s_rle = {%d, %d, true, sizeof(%s_rle_data), %s_rle_data};\n" % (
+            args.name, width, height, args.name, args.name)
+    text += "\n#endif\n"
+
+    with open(args.output, "w") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,77 @@
+/**
+* @file udp_tx.c
+*
+* sequence-numbered telemetry datagrams over lwip sockets
+*/
+
+#include <string.h>
+
+#include "lwip/sockets.h"
+
+#include "udp_tx.h"
+
+bool udp_tx_init(udp_tx_t *u, const char *host, uint16_t port, uint16_t session) {
+    struct sockaddr_in addr;
+
+    memset(u, 0, sizeof(*u));
+    u->session=session;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family=AF_INET;
+    addr.sin_port=htons(port);
+    inet_aton(host, &addr.sin_addr);
+
+    if((u->sock=socket(AF_INET, SOCK_DGRAM, 0))<0)
+        return false;
+    // fixes the peer, so send() suffices and only its datagrams are received
+    if(connect(u->sock, (struct sockaddr *) &addr, sizeof(addr))<0) {
+        udp_tx_close(u);
+        return false;
+    }
+    return true;
+}
+
+static void udp_tx_put32(uint8_t *p, uint32_t v) {
+    p[0]=v;
+    p[1]=v>>8;
+    p[2]=v>>16;
+    p[3]=v>>24;
+}
+
+bool udp_tx_send(udp_tx_t *u, const void *frames, size_t len, uint8_t samples, uint32_t now_ms) {
+    if(u->sock<0 || len>UDP_TX_PAYLOAD)
+        return false;
+
+    uint8_t *h=u->buf;
+    h[0]=UDP_TX_VERSION;
+    h[1]=samples;
+    h[2]=u->session;
+    h[3]=u->session>>8;
+    udp_tx_put32(h+4, u->seq++);
+    udp_tx_put32(h+8, now_ms);
+    memcpy(h+UDP_TX_HEADER_SIZE, frames, len);
+
+    if(send(u->sock, u->buf, UDP_TX_HEADER_SIZE+len, 0)<0) {
+        ++u->errors;
+        return false;
+    }
+    ++u->datagrams;
+    u->samples+=samples;
+    u->bytes+=UDP_TX_HEADER_SIZE+len;
+    return true;
+}
+
+int udp_tx_recv(udp_tx_t *u, char *buf, size_t size) {
+    if(u->sock<0 || size==0)
+        return -1;
+    int got=recv(u->sock, buf, size-1, MSG_DONTWAIT);
+    if(got<0)
+        return -1;
+    buf[got]='\0';
+    return got;
+}
+
+void udp_tx_close(udp_tx_t *u) {
+    if(u->sock>=0)
+        lwip_close(u->sock);
+    u->sock=-1;
+}
@@ -0,0 +1,93 @@
+/**
+* @file udp_tx.h
+*
+* datagram telemetry: samples already encoded as frames (frame.h) are sent
+* over UDP behind a small header with a session id, a sequence number and a
+* timestamp, so the receiver can count losses and reordering. Nothing is
+* acknowledged or sent again
+*/
+
+#ifndef _inc_udp_tx
+#define _inc_udp_tx
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+*	@brief datagram header layout version
+*/
+#define UDP_TX_VERSION 1
+
+/**
+*	@brief header bytes: version, samples, session, sequence, time
+*/
+#define UDP_TX_HEADER_SIZE 12
+
+/**
+*	@brief most frame bytes per datagram, so header and IP/UDP headers stay
+*	within a 1500 byte MTU without fragmenting
+*/
+#define UDP_TX_PAYLOAD 1400
+
+/**
+*	@brief sender state and statistics
+*/
+typedef struct {
+    int sock;			/**< connected datagram socket, -1 when closed */
+    uint16_t session;	/**< changes every boot, tells the receiver the sequence restarted */
+    uint32_t seq;		/**< sequence number of the next datagram */
+    uint8_t buf[UDP_TX_HEADER_SIZE+UDP_TX_PAYLOAD];
+    uint32_t datagrams;	/**< datagrams handed to the stack */
+    uint32_t samples;	/**< samples in them */
+    uint32_t bytes;		/**< datagram bytes, headers included */
+    uint32_t errors;	/**< sends that failed, their sequence numbers are skipped */
+} udp_tx_t;
+
+/**
+*	@brief open the socket
+*
+*	@param[in] u : sender
+*	@param[in] host : receiver ipv4 address
+*	@param[in] port : receiver port
+*	@param[in] session : id of this boot, preferably random
+*
+*	@return bool.
+*	@retval true for Success
+*/
+bool udp_tx_init(udp_tx_t *u, const char *host, uint16_t port, uint16_t session);
+
+/**
+*	@brief send frames as the next datagram
+*
+*	The sequence number advances even when the send fails, so the receiver
+*	sees the datagram as lost.
+*
+*	@param[in] u : sender
+*	@param[in] frames : frames back to back, at most UDP_TX_PAYLOAD bytes
+*	@param[in] len : bytes in frames
+*	@param[in] samples : frames in frames
+*	@param[in] now_ms : send time, written in the header
+*
+*	@return bool.
+*	@retval true if the stack took the datagram
+*/
+bool udp_tx_send(udp_tx_t *u, const void *frames, size_t len, uint8_t samples, uint32_t now_ms);
+
+/**
+*	@brief read a datagram from the receiver without waiting
+*
+*	@param[in] u : sender
+*	@param[out] buf : datagram, NUL terminated
+*	@param[in] size : size of buf
+*
+*	@return bytes read, or -1 if none is waiting
+*/
+int udp_tx_recv(udp_tx_t *u, char *buf, size_t size);
+
+/**
+*	@brief close the socket
+*/
+void udp_tx_close(udp_tx_t *u);
+
+#endif